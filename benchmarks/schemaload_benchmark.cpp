@@ -0,0 +1,148 @@
+#include "../src/common/datatable.h"
+#include "../src/common/schemasnapshot.h"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/format.h>
+#include <regex>
+#include <sqlite3/sqlite3.h>
+#include <string>
+#include <vector>
+
+// Compares loading the schema with one query (LoadTables) to the way it was loaded before:
+// a query for the table names, one PRAGMA table_info per table and a regex per table name.
+// It also times loading the same tables from a schema snapshot.
+// Usage: asr_schema_benchmark [TABLES...] (default 10 100 1000 10000)
+
+namespace
+{
+    sqlite3 *CreateSchema(
+        int tableCount)
+    {
+        sqlite3 *db = nullptr;
+        sqlite3_open(":memory:", &db);
+
+        std::string sql = "BEGIN;";
+        for (int i = 0; i < tableCount; i++)
+        {
+            sql += fmt::format(
+                "CREATE TABLE Table{0}_v{1} (Id INTEGER PRIMARY KEY, Name TEXT, Description NVARCHAR(200), Amount REAL, "
+                "Quantity INTEGER, Created NUMERIC, Data Blob, Notes TEXT);",
+                i, 1 + i % 3);
+        }
+        sql += "COMMIT;";
+
+        sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+
+        return db;
+    }
+
+    size_t LoadTablesPerTable(
+        sqlite3 *db)
+    {
+        std::vector<DataTable> tables;
+
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2(db, "SELECT name FROM sqlite_master WHERE type='table';", -1, &stmt, NULL);
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            auto name = std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+
+            std::smatch matches;
+            std::regex_search(name, matches, std::regex(R"(([\w]+)_v([0-9]+))"));
+
+            tables.push_back(DataTable(name));
+        }
+
+        sqlite3_finalize(stmt);
+
+        for (auto &table : tables)
+        {
+            sqlite3_prepare_v2(db, fmt::format("PRAGMA table_info({0});", table.RawName()).c_str(), -1, &stmt, NULL);
+
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                auto name = (const char *)sqlite3_column_text(stmt, 1);
+                auto type = (const char *)sqlite3_column_text(stmt, 2);
+
+                if (sqlite3_column_int(stmt, 5) != 0)
+                {
+                    table.PrimaryKey(name);
+                }
+
+                table.AddColumn(name, type);
+            }
+
+            sqlite3_finalize(stmt);
+        }
+
+        return tables.size();
+    }
+
+    template <typename Function>
+    double BestOf(
+        int runs,
+        Function function)
+    {
+        double best = 0;
+
+        for (int i = 0; i < runs; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            if (i == 0 || elapsed < best)
+            {
+                best = elapsed;
+            }
+        }
+
+        return best;
+    }
+} // namespace
+
+int main(
+    int argc,
+    char *argv[])
+{
+    std::vector<int> sizes;
+
+    for (int i = 1; i < argc; i++)
+    {
+        sizes.push_back(std::atoi(argv[i]));
+    }
+
+    if (sizes.empty())
+    {
+        sizes = {10, 100, 1000, 10000};
+    }
+
+    auto snapshotPath = (std::filesystem::temp_directory_path() / "asr_schema_benchmark.bin").string();
+
+    fmt::print("{:>8} {:>14} {:>14} {:>8} {:>14}\n", "tables", "per table ms", "one query ms", "speedup", "snapshot ms");
+
+    for (auto size : sizes)
+    {
+        auto db = CreateSchema(size);
+
+        auto perTable = BestOf(3, [db]() { LoadTablesPerTable(db); });
+        auto oneQuery = BestOf(3, [db]() { LoadTables(db); });
+
+        SchemaSnapshot::Save(snapshotPath, 1, LoadTables(db));
+
+        auto snapshot = BestOf(3, [&snapshotPath]() {
+            std::vector<DataTable> tables;
+            SchemaSnapshot::Load(snapshotPath, 1, tables);
+        });
+
+        fmt::print("{:>8} {:>14.2f} {:>14.2f} {:>7.1f}x {:>14.2f}\n", size, perTable, oneQuery, perTable / oneQuery, snapshot);
+
+        sqlite3_close(db);
+    }
+
+    std::filesystem::remove(snapshotPath);
+
+    return 0;
+}
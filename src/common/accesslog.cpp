@@ -0,0 +1,199 @@
+#include "accesslog.h"
+#include "jsonwriter.h"
+#include "metrics.h"
+#include "ringbuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fmt/format.h>
+#include <iterator>
+#include <memory>
+#include <thread>
+
+namespace
+{
+    void copyTruncated(
+        char *destination,
+        size_t size,
+        std::string_view value)
+    {
+        auto length = value.size() < size - 1 ? value.size() : size - 1;
+        value.copy(destination, length);
+        destination[length] = '\0';
+    }
+
+    struct Log
+    {
+        std::unique_ptr<RingBuffer<AccessLogRecord>> buffer;
+        std::FILE *file = nullptr;
+        std::thread writer;
+        std::atomic<bool> open = {false};
+        std::atomic<bool> running = {false};
+        std::atomic<uint64_t> dropped = {0};
+    };
+
+    Log &log()
+    {
+        static Log instance;
+
+        return instance;
+    }
+
+    void format(
+        AccessLogRecord const &record,
+        std::pmr::string &output)
+    {
+        auto seconds = std::time_t(record.timestampMicros / 1000000);
+        auto time = *std::gmtime(&seconds);
+
+        JsonWriter writer(output);
+
+        writer.BeginObject();
+        writer.Key("ts");
+        writer.String(fmt::format("{:04}-{:02}-{:02}T{:02}:{:02}:{:02}.{:06}Z",
+                                  time.tm_year + 1900, time.tm_mon + 1, time.tm_mday,
+                                  time.tm_hour, time.tm_min, time.tm_sec,
+                                  record.timestampMicros % 1000000));
+        writer.Key("method");
+        writer.String(record.method);
+        writer.Key("path");
+        writer.String(record.path);
+        writer.Key("status");
+        writer.Integer(record.statusCode);
+        writer.Key("bytes_in");
+        writer.Integer(static_cast<long long>(record.bytesIn));
+        writer.Key("bytes_out");
+        writer.Integer(static_cast<long long>(record.bytesOut));
+        writer.Key("latency_us");
+        writer.Integer(record.latencyMicros);
+        writer.Key("rows");
+        writer.Integer(static_cast<long long>(record.rows));
+        writer.EndObject();
+
+        output += '\n';
+    }
+
+    // Drains the ring buffer into one batch and writes it with a single call
+    bool flush(
+        Log &l,
+        std::pmr::string &batch)
+    {
+        AccessLogRecord record;
+
+        batch.clear();
+        while (batch.size() < 64 * 1024 && l.buffer->TryPop(record))
+        {
+            format(record, batch);
+        }
+
+        if (batch.empty())
+        {
+            return false;
+        }
+
+        std::fwrite(batch.data(), 1, batch.size(), l.file);
+        std::fflush(l.file);
+
+        return true;
+    }
+
+    void run()
+    {
+        auto &l = log();
+        std::pmr::string batch;
+
+        while (l.running.load())
+        {
+            if (!flush(l, batch))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+
+        while (flush(l, batch))
+        {
+        }
+    }
+} // namespace
+
+void AccessLogRecord::SetMethod(
+    std::string_view value)
+{
+    copyTruncated(method, sizeof(method), value);
+}
+
+void AccessLogRecord::SetPath(
+    std::string_view value)
+{
+    copyTruncated(path, sizeof(path), value);
+}
+
+bool AccessLog::Open(
+    std::string const &path,
+    size_t capacity)
+{
+    auto &l = log();
+
+    if (l.open.load())
+    {
+        return false;
+    }
+
+    l.file = std::fopen(path.c_str(), "ab");
+    if (l.file == nullptr)
+    {
+        return false;
+    }
+
+    l.buffer = std::make_unique<RingBuffer<AccessLogRecord>>(capacity);
+    l.running.store(true);
+    l.writer = std::thread(run);
+    l.open.store(true);
+
+    return true;
+}
+
+void AccessLog::Close()
+{
+    auto &l = log();
+
+    if (!l.open.exchange(false))
+    {
+        return;
+    }
+
+    l.running.store(false);
+    l.writer.join();
+
+    std::fclose(l.file);
+    l.file = nullptr;
+}
+
+bool AccessLog::IsOpen()
+{
+    return log().open.load(std::memory_order_relaxed);
+}
+
+void AccessLog::Write(
+    AccessLogRecord const &record)
+{
+    auto &l = log();
+
+    if (!l.open.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    if (!l.buffer->TryPush(record))
+    {
+        l.dropped.fetch_add(1, std::memory_order_relaxed);
+        Metrics::Add(Metrics::AccessLogDropped, 1);
+    }
+}
+
+uint64_t AccessLog::Dropped()
+{
+    return log().dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,47 @@
+#ifndef ACCESSLOG_H
+#define ACCESSLOG_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// A fixed size record, so logging a request never allocates on the request thread.
+struct AccessLogRecord
+{
+    int64_t timestampMicros;
+    char method[8];
+    char path[112];
+    int statusCode;
+    uint32_t latencyMicros;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t rows;
+
+    void SetMethod(
+        std::string_view value);
+
+    void SetPath(
+        std::string_view value);
+};
+
+// Request threads push records into a lock-free ring buffer, a background thread writes them
+// to the log file as json lines in batches. When the buffer is full the record is dropped and counted.
+class AccessLog
+{
+public:
+    static bool Open(
+        std::string const &path,
+        size_t capacity = 16 * 1024);
+
+    // Writes what is still buffered and stops the background thread.
+    static void Close();
+
+    static bool IsOpen();
+
+    static void Write(
+        AccessLogRecord const &record);
+
+    static uint64_t Dropped();
+};
+
+#endif // ACCESSLOG_H
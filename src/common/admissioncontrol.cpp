@@ -0,0 +1,143 @@
+#include "admissioncontrol.h"
+
+#include "metrics.h"
+
+#include <algorithm>
+
+AdmissionControl::AdmissionControl(
+    size_t workers,
+    size_t maxQueued)
+    : _maxQueued(maxQueued),
+      _inFlight(0),
+      _stopping(false)
+{
+    workers = std::max<size_t>(workers, 1);
+
+    for (size_t i = 0; i < workers; i++)
+    {
+        _workers.push_back(std::thread(&AdmissionControl::run, this));
+    }
+}
+
+AdmissionControl::~AdmissionControl()
+{
+    Stop();
+}
+
+bool AdmissionControl::Admit(
+    Priorities priority,
+    Work work)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_stopping)
+        {
+            return false;
+        }
+
+        auto queued = _high.size() + _normal.size();
+
+        // Normal work leaves the last quarter of the queue to high priority work
+        auto limit = priority == Priorities::High ? _maxQueued : _maxQueued - _maxQueued / 4;
+
+        // An idle worker takes the work right away, so it never counts as queued
+        if (queued >= limit && _inFlight + queued >= _workers.size())
+        {
+            return false;
+        }
+
+        (priority == Priorities::High ? _high : _normal).push_back(std::move(work));
+    }
+
+    _available.notify_one();
+
+    return true;
+}
+
+size_t AdmissionControl::Queued() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _high.size() + _normal.size();
+}
+
+size_t AdmissionControl::InFlight() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _inFlight;
+}
+
+bool AdmissionControl::Drain(
+    std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _stopping = true;
+    _available.notify_all();
+
+    return _idle.wait_until(lock, deadline, [this]() {
+        return _inFlight == 0 && _high.empty() && _normal.empty();
+    });
+}
+
+void AdmissionControl::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+
+    _available.notify_all();
+
+    for (auto &worker : _workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+void AdmissionControl::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _available.wait(lock, [this]() {
+            return _stopping || !_high.empty() || !_normal.empty();
+        });
+
+        if (_high.empty() && _normal.empty())
+        {
+            return;
+        }
+
+        auto &queue = !_high.empty() ? _high : _normal;
+        auto work = std::move(queue.front());
+        queue.pop_front();
+
+        _inFlight++;
+        lock.unlock();
+
+        // The work answers its own failures, what still escapes would end the process with the worker
+        try
+        {
+            work();
+        }
+        catch (...)
+        {
+            Metrics::Add(Metrics::HandlerErrors, 1);
+        }
+
+        lock.lock();
+        _inFlight--;
+
+        if (_inFlight == 0 && _high.empty() && _normal.empty())
+        {
+            _idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef ADMISSIONCONTROL_H
+#define ADMISSIONCONTROL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs requests on a fixed pool of workers, one request per worker at a time, behind a bounded queue.
+// What does not fit in the queue is refused right away, so under a spike the requests that get in keep
+// their latency and the others hear 503 fast. A quarter of the queue is kept for high priority work,
+// like point lookups, which also goes before the normal work waiting in the queue.
+class AdmissionControl
+{
+public:
+    enum class Priorities
+    {
+        High,
+        Normal,
+    };
+
+    typedef std::function<void()> Work;
+
+    AdmissionControl(
+        size_t workers,
+        size_t maxQueued);
+
+    ~AdmissionControl();
+
+    AdmissionControl(AdmissionControl const &) = delete;
+    AdmissionControl &operator=(AdmissionControl const &) = delete;
+
+    // Queues the work for the next free worker, returns false when the queue is full for its priority.
+    bool Admit(
+        Priorities priority,
+        Work work);
+
+    // The work waiting for a worker.
+    size_t Queued() const;
+
+    // The work the workers are running now.
+    size_t InFlight() const;
+
+    // Refuses new work and waits until the workers are done with what is queued and running, or the
+    // deadline passes. Returns false when work was left at the deadline.
+    bool Drain(
+        std::chrono::steady_clock::time_point deadline);
+
+    // Refuses new work, lets the workers finish what is queued and ends them.
+    void Stop();
+
+private:
+    void run();
+
+    size_t _maxQueued;
+    mutable std::mutex _mutex;
+    std::condition_variable _available;
+    std::condition_variable _idle;
+    std::deque<Work> _high;
+    std::deque<Work> _normal;
+    size_t _inFlight;
+    bool _stopping;
+    std::vector<std::thread> _workers;
+};
+
+#endif // ADMISSIONCONTROL_H
@@ -0,0 +1,376 @@
+#include "applyquery.h"
+#include "sqlquote.h"
+
+#include <cctype>
+#include <fmt/format.h>
+#include <vector>
+
+namespace
+{
+    struct Aggregate
+    {
+        std::string expression;
+        std::string alias;
+    };
+
+    // A recursive descent over the $apply text, every method returns false after setting the error
+    class Parser
+    {
+        DataTable const &_table;
+        std::string_view _text;
+        std::string &_error;
+
+    public:
+        std::vector<std::string> groupBy;
+        std::vector<Aggregate> aggregates;
+        bool hasGroupBy = false;
+        bool hasAggregate = false;
+
+        Parser(
+            DataTable const &table,
+            std::string_view text,
+            std::string &error)
+            : _table(table), _text(text), _error(error)
+        {}
+
+        bool Parse()
+        {
+            do
+            {
+                if (!transformation())
+                {
+                    return false;
+                }
+            } while (accept("/"));
+
+            skipSpaces();
+            if (!_text.empty())
+            {
+                return fail(fmt::format("unexpected '{0}' in $apply", _text));
+            }
+
+            return true;
+        }
+
+    private:
+        bool fail(
+            std::string message)
+        {
+            _error = std::move(message);
+            return false;
+        }
+
+        void skipSpaces()
+        {
+            while (!_text.empty() && _text.front() == ' ')
+            {
+                _text.remove_prefix(1);
+            }
+        }
+
+        bool next(
+            std::string_view token)
+        {
+            skipSpaces();
+            return _text.substr(0, token.size()) == token;
+        }
+
+        bool accept(
+            std::string_view token)
+        {
+            if (!next(token))
+            {
+                return false;
+            }
+
+            _text.remove_prefix(token.size());
+            return true;
+        }
+
+        bool expect(
+            std::string_view token)
+        {
+            if (!accept(token))
+            {
+                return fail(fmt::format("expected '{0}' in $apply", token));
+            }
+
+            return true;
+        }
+
+        // The text up to the next space or punctuation
+        std::string_view peekWord()
+        {
+            skipSpaces();
+
+            size_t length = 0;
+            while (length < _text.size() && _text[length] != ' ' && _text[length] != '(' && _text[length] != ')' && _text[length] != ',' && _text[length] != '/')
+            {
+                length++;
+            }
+
+            return _text.substr(0, length);
+        }
+
+        std::string_view word()
+        {
+            auto result = peekWord();
+            _text.remove_prefix(result.size());
+
+            return result;
+        }
+
+        bool acceptWord(
+            std::string_view keyword)
+        {
+            if (peekWord() != keyword)
+            {
+                return false;
+            }
+
+            _text.remove_prefix(keyword.size());
+            return true;
+        }
+
+        bool column(
+            std::string &name)
+        {
+            auto found = word();
+            if (found.empty())
+            {
+                return fail("expected a column in $apply");
+            }
+
+            if (_table.Columns().find(std::string(found)) == _table.Columns().end())
+            {
+                return fail(fmt::format("unknown column '{0}' in $apply", found));
+            }
+
+            name = std::string(found);
+            return true;
+        }
+
+        bool alias(
+            std::string &name)
+        {
+            auto found = word();
+            if (found.empty() || std::isdigit(static_cast<unsigned char>(found.front())))
+            {
+                return fail("expected an alias after 'as' in $apply");
+            }
+
+            for (auto c : found)
+            {
+                if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+                {
+                    return fail(fmt::format("alias '{0}' in $apply can only have letters, digits and _", found));
+                }
+            }
+
+            name = std::string(found);
+            return true;
+        }
+
+        bool transformation()
+        {
+            if (accept("groupby("))
+            {
+                return groupby();
+            }
+
+            if (accept("aggregate("))
+            {
+                return aggregate();
+            }
+
+            return fail("expected groupby or aggregate in $apply");
+        }
+
+        bool groupby()
+        {
+            if (hasGroupBy)
+            {
+                return fail("$apply can only group once");
+            }
+
+            // aggregate(...) leaves one row, grouping it after would be answered as if the groups came first
+            if (hasAggregate)
+            {
+                return fail("groupby can not follow aggregate in $apply");
+            }
+
+            hasGroupBy = true;
+
+            auto parenthesized = accept("(");
+
+            do
+            {
+                std::string name;
+                if (!column(name))
+                {
+                    return false;
+                }
+
+                groupBy.push_back(name);
+
+                // groupby(Category,aggregate(...)) ends the columns at the aggregate
+                if (!parenthesized && next(","))
+                {
+                    auto rest = _text.substr(1);
+                    while (!rest.empty() && rest.front() == ' ')
+                    {
+                        rest.remove_prefix(1);
+                    }
+
+                    if (rest.substr(0, 10) == "aggregate(")
+                    {
+                        break;
+                    }
+                }
+            } while (accept(","));
+
+            if (parenthesized && !expect(")"))
+            {
+                return false;
+            }
+
+            if (accept(","))
+            {
+                if (!expect("aggregate(") || !aggregate())
+                {
+                    return false;
+                }
+            }
+
+            return expect(")");
+        }
+
+        bool aggregate()
+        {
+            if (hasAggregate)
+            {
+                return fail("$apply can only aggregate once");
+            }
+
+            hasAggregate = true;
+
+            do
+            {
+                Aggregate result;
+
+                if (acceptWord("$count"))
+                {
+                    result.expression = "count(*)";
+                    result.alias = "$count";
+
+                    if (!acceptWord("as"))
+                    {
+                        return fail("expected 'as' after $count in $apply");
+                    }
+
+                    if (!alias(result.alias))
+                    {
+                        return false;
+                    }
+                }
+                else
+                {
+                    std::string name;
+                    if (!column(name))
+                    {
+                        return false;
+                    }
+
+                    if (!acceptWord("with"))
+                    {
+                        return fail(fmt::format("expected 'with' after '{0}' in $apply", name));
+                    }
+
+                    auto method = word();
+                    if (method == "sum" || method == "min" || method == "max")
+                    {
+                        result.expression = fmt::format("{0}({1})", method, SqlQuote(name));
+                    }
+                    else if (method == "average")
+                    {
+                        result.expression = fmt::format("avg({0})", SqlQuote(name));
+                    }
+                    else if (method == "countdistinct")
+                    {
+                        result.expression = fmt::format("count(distinct {0})", SqlQuote(name));
+                    }
+                    else
+                    {
+                        return fail(fmt::format("unknown aggregate method '{0}' in $apply", method));
+                    }
+
+                    result.alias = fmt::format("{0}_{1}", name, method);
+
+                    if (acceptWord("as") && !alias(result.alias))
+                    {
+                        return false;
+                    }
+                }
+
+                aggregates.push_back(result);
+            } while (accept(","));
+
+            return expect(")");
+        }
+    };
+} // namespace
+
+bool ApplyQuery::Compile(
+    DataTable const &table,
+    std::string_view apply,
+    std::string &sql,
+    std::string &error)
+{
+    Parser parser(table, apply, error);
+
+    if (!parser.Parse())
+    {
+        return false;
+    }
+
+    std::vector<std::string> names;
+    std::string columns;
+
+    for (auto &name : parser.groupBy)
+    {
+        names.push_back(name);
+        columns += (columns.empty() ? "" : ",") + SqlQuote(name);
+    }
+
+    auto groupBy = columns;
+
+    for (auto &aggregate : parser.aggregates)
+    {
+        for (auto &name : names)
+        {
+            if (name == aggregate.alias)
+            {
+                error = fmt::format("'{0}' is in the $apply result twice", name);
+                return false;
+            }
+        }
+
+        names.push_back(aggregate.alias);
+        columns += (columns.empty() ? "" : ",") + aggregate.expression + " as " + SqlQuote(aggregate.alias);
+    }
+
+    sql = fmt::format("select {0} from {1}", columns, SqlQuote(table.RawName()));
+    if (!groupBy.empty())
+    {
+        sql += " group by " + groupBy;
+    }
+    sql += ";";
+
+    return true;
+}
+
+std::string ApplyQuery::Count(
+    DataTable const &table)
+{
+    return fmt::format("select count(*) from {0};", SqlQuote(table.RawName()));
+}
@@ -0,0 +1,32 @@
+#ifndef APPLYQUERY_H
+#define APPLYQUERY_H
+
+#include "datatable.h"
+
+#include <string>
+#include <string_view>
+
+// Compiles the OData $apply transformations groupby and aggregate into one select over a table, so sqlite
+// groups and aggregates the rows instead of the client. Both of these work and mean the same:
+//
+//   groupby((Category),aggregate(Price with sum as Total,$count as Count))
+//   groupby(Category)/aggregate(Price with sum as Total,$count as Count)
+//
+// The methods are sum, average, min, max and countdistinct. Only known columns and plain aliases get into
+// the sql, there are no values to bind.
+class ApplyQuery
+{
+public:
+    // Returns false with a message in error when the text does not compile.
+    static bool Compile(
+        DataTable const &table,
+        std::string_view apply,
+        std::string &sql,
+        std::string &error);
+
+    // The select for /api/{table}/$count.
+    static std::string Count(
+        DataTable const &table);
+};
+
+#endif // APPLYQUERY_H
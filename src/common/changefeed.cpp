@@ -0,0 +1,383 @@
+#include "changefeed.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fmt/format.h>
+#include <sqlite3/sqlite3.h>
+
+ChangeSink::~ChangeSink() = default;
+
+constexpr std::chrono::seconds ChangeFeed::HeartbeatInterval;
+
+namespace
+{
+    char const *operationName(
+        ChangeFeed::Operations operation)
+    {
+        switch (operation)
+        {
+            case ChangeFeed::Operations::Insert:
+                return "insert";
+            case ChangeFeed::Operations::Update:
+                return "update";
+            case ChangeFeed::Operations::Delete:
+                return "delete";
+        }
+
+        return "";
+    }
+
+    // sqlite compares table names without case
+    std::string lower(
+        std::string value)
+    {
+        for (auto &c : value)
+        {
+            c = char(std::tolower(static_cast<unsigned char>(c)));
+        }
+
+        return value;
+    }
+} // namespace
+
+ChangeFeed::ChangeFeed()
+    : _stopping(false),
+      // Ids start at the time in microseconds, so they keep going up after a restart and an id from
+      // before the restart is never taken for a recent one
+      _firstEventId(uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count())),
+      _lastEventId(_firstEventId)
+{}
+
+ChangeFeed::~ChangeFeed()
+{
+    Stop();
+}
+
+void ChangeFeed::Attach(
+    sqlite3 *db)
+{
+    sqlite3_update_hook(
+        db,
+        [](void *feed, int operation, char const *database, char const *table, sqlite3_int64 rowid) {
+            if (std::strcmp(database, "main") != 0)
+            {
+                return;
+            }
+
+            auto self = static_cast<ChangeFeed *>(feed);
+            auto type = operation == SQLITE_INSERT   ? Operations::Insert
+                        : operation == SQLITE_UPDATE ? Operations::Update
+                                                     : Operations::Delete;
+
+            std::lock_guard<std::mutex> lock(self->_mutex);
+
+            self->_pending.push_back(TableChange{table, Change{0, type, rowid}});
+        },
+        this);
+
+    // Returning 0 lets the commit go on
+    sqlite3_commit_hook(
+        db,
+        [](void *feed) {
+            auto self = static_cast<ChangeFeed *>(feed);
+
+            std::vector<TableChange> changes;
+            {
+                std::lock_guard<std::mutex> lock(self->_mutex);
+                changes.swap(self->_pending);
+            }
+
+            if (!changes.empty())
+            {
+                self->publish(changes);
+            }
+
+            return 0;
+        },
+        this);
+
+    sqlite3_rollback_hook(
+        db,
+        [](void *feed) {
+            auto self = static_cast<ChangeFeed *>(feed);
+
+            std::lock_guard<std::mutex> lock(self->_mutex);
+
+            self->_pending.clear();
+        },
+        this);
+}
+
+void ChangeFeed::publish(
+    std::vector<TableChange> &changes)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (auto &tableChange : changes)
+    {
+        tableChange.change.id = ++_lastEventId;
+        _tableVersions[lower(tableChange.table)] = tableChange.change.id;
+
+        for (auto &subscriber : _subscribers)
+        {
+            if (sqlite3_stricmp(subscriber->table.c_str(), tableChange.table.c_str()) == 0)
+            {
+                enqueue(*subscriber, tableChange.change);
+            }
+        }
+
+        _history.push_back(std::move(tableChange));
+        if (_history.size() > HistorySize)
+        {
+            _history.pop_front();
+        }
+    }
+
+    _changed.notify_one();
+
+    auto listener = _publishListener;
+
+    lock.unlock();
+
+    if (listener)
+    {
+        listener();
+    }
+}
+
+void ChangeFeed::enqueue(
+    Subscriber &subscriber,
+    Change const &change)
+{
+    auto merged = change;
+
+    auto found = subscriber.queuedRows.find(change.rowid);
+    if (found != subscriber.queuedRows.end())
+    {
+        // A row the client has not heard of yet is still new to it after an update
+        if (found->second->operation == Operations::Insert && change.operation == Operations::Update)
+        {
+            merged.operation = Operations::Insert;
+        }
+
+        // The merged change moves to the end, so the ids in the queue keep going up
+        subscriber.queue.erase(found->second);
+    }
+    else if (subscriber.queuedRows.size() >= MaxQueuedRows)
+    {
+        // Too far behind, the client reloads the table instead
+        subscriber.queue.clear();
+        subscriber.queuedRows.clear();
+        subscriber.resetId = change.id;
+        return;
+    }
+
+    subscriber.queue.push_back(merged);
+    subscriber.queuedRows[change.rowid] = std::prev(subscriber.queue.end());
+}
+
+void ChangeFeed::Subscribe(
+    std::string const &table,
+    std::unique_ptr<ChangeSink> sink,
+    uint64_t lastEventId)
+{
+    auto subscriber = std::make_unique<Subscriber>();
+    subscriber->table = table;
+    subscriber->sink = std::move(sink);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_stopping)
+    {
+        return;
+    }
+
+    if (lastEventId != 0 && lastEventId != _lastEventId)
+    {
+        // Resuming works when the history still has the change right after the last one the client saw
+        auto known = lastEventId < _lastEventId && !_history.empty() && _history.front().change.id <= lastEventId + 1;
+
+        if (!known)
+        {
+            subscriber->resetId = _lastEventId;
+        }
+        else
+        {
+            for (auto &tableChange : _history)
+            {
+                if (tableChange.change.id > lastEventId && sqlite3_stricmp(table.c_str(), tableChange.table.c_str()) == 0)
+                {
+                    enqueue(*subscriber, tableChange.change);
+                }
+            }
+        }
+    }
+
+    _subscribers.push_back(std::move(subscriber));
+
+    if (!_thread.joinable())
+    {
+        _thread = std::thread(&ChangeFeed::run, this);
+    }
+
+    _changed.notify_one();
+}
+
+uint64_t ChangeFeed::LastEventId() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _lastEventId;
+}
+
+uint64_t ChangeFeed::TableVersion(
+    std::string const &table) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = _tableVersions.find(lower(table));
+
+    return found != _tableVersions.end() ? found->second : _firstEventId;
+}
+
+void ChangeFeed::OnPublish(
+    std::function<void()> listener)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _publishListener = std::move(listener);
+}
+
+size_t ChangeFeed::SubscriberCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _subscribers.size();
+}
+
+void ChangeFeed::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+
+    _changed.notify_one();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _subscribers.clear();
+}
+
+std::string ChangeFeed::FormatEvent(
+    Change const &change)
+{
+    return fmt::format(
+        "id: {0}\nevent: change\ndata: {{\"operation\":\"{1}\",\"rowid\":{2}}}\n\n",
+        change.id,
+        operationName(change.operation),
+        change.rowid);
+}
+
+void ChangeFeed::run()
+{
+    auto lastHeartbeat = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        // A stop first hands the queued events to the clients that take them without waiting
+        auto stopping = _stopping;
+
+        auto now = std::chrono::steady_clock::now();
+        auto heartbeat = !stopping && now - lastHeartbeat >= HeartbeatInterval;
+        auto waiting = false;
+
+        // The events are taken out under the lock and written without it, so the writer connection never waits on a client
+        std::vector<std::pair<Subscriber *, std::string>> writes;
+
+        for (auto &subscriber : _subscribers)
+        {
+            auto queued = subscriber->resetId != 0 || !subscriber->queue.empty();
+            if (!queued && !heartbeat)
+            {
+                continue;
+            }
+
+            if (!subscriber->sink->Ready())
+            {
+                waiting = waiting || queued;
+                continue;
+            }
+
+            std::string events;
+
+            if (subscriber->resetId != 0)
+            {
+                events += fmt::format("id: {0}\nevent: reset\ndata: {{}}\n\n", subscriber->resetId);
+                subscriber->resetId = 0;
+            }
+
+            for (auto &change : subscriber->queue)
+            {
+                events += FormatEvent(change);
+            }
+
+            subscriber->queue.clear();
+            subscriber->queuedRows.clear();
+
+            // A comment line keeps proxies from closing an idle stream, and finds clients that left
+            if (events.empty())
+            {
+                events = ": heartbeat\n\n";
+            }
+
+            writes.push_back(std::make_pair(subscriber.get(), std::move(events)));
+        }
+
+        if (heartbeat)
+        {
+            lastHeartbeat = now;
+        }
+
+        if (stopping && writes.empty())
+        {
+            return;
+        }
+
+        if (!writes.empty())
+        {
+            // Only this thread removes subscribers, so the pointers stay valid without the lock
+            lock.unlock();
+
+            std::vector<Subscriber *> gone;
+            for (auto &write : writes)
+            {
+                if (!write.first->sink->Write(write.second))
+                {
+                    gone.push_back(write.first);
+                }
+            }
+
+            lock.lock();
+
+            _subscribers.erase(
+                std::remove_if(_subscribers.begin(), _subscribers.end(), [&gone](std::unique_ptr<Subscriber> const &subscriber) {
+                    return std::find(gone.begin(), gone.end(), subscriber.get()) != gone.end();
+                }),
+                _subscribers.end());
+
+            continue;
+        }
+
+        // Clients that were not ready are tried again soon, their queue keeps folding changes meanwhile
+        _changed.wait_for(lock, waiting ? std::chrono::milliseconds(50) : std::chrono::duration_cast<std::chrono::milliseconds>(HeartbeatInterval - (now - lastHeartbeat)));
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct sqlite3;
+
+// Where the events of one subscriber go, like the connection of a server-sent events response.
+class ChangeSink
+{
+public:
+    virtual ~ChangeSink();
+
+    // Returns true when the client takes more data without Write having to wait.
+    virtual bool Ready() = 0;
+
+    // Returns false when the client is gone.
+    virtual bool Write(
+        std::string_view events) = 0;
+};
+
+// Sends the rows a connection changes to the subscribers of their table, as server-sent events. The
+// changes come from the update hook and are only published when their transaction commits. Every
+// subscriber has its own bounded queue where more changes to one row fold into one, so a slow client
+// gets fewer events instead of using more memory. Event ids go up across restarts, so a client can
+// resume with the last id it saw, and gets a reset event when the changes since then are not known.
+class ChangeFeed
+{
+public:
+    static const size_t HistorySize = 4096;
+    static const size_t MaxQueuedRows = 1024;
+    static constexpr std::chrono::seconds HeartbeatInterval = std::chrono::seconds(15);
+
+    enum class Operations
+    {
+        Insert,
+        Update,
+        Delete,
+    };
+
+    struct Change
+    {
+        uint64_t id;
+        Operations operation;
+        int64_t rowid;
+    };
+
+    ChangeFeed();
+    ~ChangeFeed();
+
+    ChangeFeed(ChangeFeed const &) = delete;
+    ChangeFeed &operator=(ChangeFeed const &) = delete;
+
+    // Sets the update, commit and rollback hooks of the connection, only changes made through it are seen.
+    void Attach(
+        sqlite3 *db);
+
+    // Sends the changes to the table from now on, and the ones after lastEventId when it is not 0.
+    void Subscribe(
+        std::string const &table,
+        std::unique_ptr<ChangeSink> sink,
+        uint64_t lastEventId);
+
+    // The id of the last published change.
+    uint64_t LastEventId() const;
+
+    // The id of the last change to the table, or the id the feed started at when it did not change since.
+    uint64_t TableVersion(
+        std::string const &table) const;
+
+    // Calls the listener after changes are published, on the thread that committed them.
+    void OnPublish(
+        std::function<void()> listener);
+
+    size_t SubscriberCount() const;
+
+    // Sends the queued events to the subscribers that are ready for them, then ends the delivery thread
+    // and closes all subscribers.
+    void Stop();
+
+    // Formats one change as a server-sent event.
+    static std::string FormatEvent(
+        Change const &change);
+
+private:
+    struct Subscriber
+    {
+        std::string table;
+        std::unique_ptr<ChangeSink> sink;
+        std::list<Change> queue;
+        std::unordered_map<int64_t, std::list<Change>::iterator> queuedRows;
+        uint64_t resetId = 0;
+    };
+
+    struct TableChange
+    {
+        std::string table;
+        Change change;
+    };
+
+    static void enqueue(
+        Subscriber &subscriber,
+        Change const &change);
+
+    void publish(
+        std::vector<TableChange> &changes);
+
+    void run();
+
+    mutable std::mutex _mutex;
+    std::condition_variable _changed;
+    std::thread _thread;
+    bool _stopping;
+    uint64_t _firstEventId;
+    uint64_t _lastEventId;
+    std::unordered_map<std::string, uint64_t> _tableVersions;
+    std::function<void()> _publishListener;
+    std::vector<TableChange> _pending;
+    std::deque<TableChange> _history;
+    std::vector<std::unique_ptr<Subscriber>> _subscribers;
+};
+
+#endif // CHANGEFEED_H
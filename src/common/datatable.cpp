@@ -0,0 +1,328 @@
+#include "datatable.h"
+
+#include <cctype>
+#include <sqlite3/sqlite3.h>
+#include <string_view>
+
+// Leaves out virtual tables, like full-text indexes, and the shadow tables of the fts and rtree modules
+// that keep their data. Shadow tables are named after their virtual table, like Posts_fts_data for Posts_fts.
+#define USER_TABLES                                                                                          \
+    " WHERE m.type = 'table' AND m.sql NOT LIKE 'CREATE VIRTUAL TABLE%'"                                     \
+    " AND NOT EXISTS (SELECT 1 FROM sqlite_master v"                                                         \
+    " WHERE v.type = 'table' AND v.sql LIKE 'CREATE VIRTUAL TABLE%'"                                         \
+    " AND substr(m.name, 1, length(v.name)) = v.name"                                                        \
+    " AND substr(m.name, length(v.name) + 1) IN ('_data', '_idx', '_content', '_docsize', '_config',"        \
+    " '_segments', '_segdir', '_stat', '_node', '_rowid', '_parent'))"
+
+DataTable::DataTable()
+{}
+
+DataTable::DataTable(
+    const std::string &name)
+    : _rawName(name), _name(name)
+{
+    auto pos = _rawName.rfind("_v");
+    if (pos == std::string::npos || pos == 0 || pos + 2 == _rawName.size())
+    {
+        return;
+    }
+
+    int version = 0;
+    for (auto itr = _rawName.begin() + pos + 2; itr != _rawName.end(); ++itr)
+    {
+        if (*itr < '0' || *itr > '9')
+        {
+            return;
+        }
+        version = version * 10 + (*itr - '0');
+    }
+
+    _name = _rawName.substr(0, pos);
+    _version = version;
+}
+
+DataTable::DataTable(
+    const std::string &rawName,
+    const std::string &name,
+    int version)
+    : _rawName(rawName), _name(name), _version(version)
+{}
+
+void DataTable::PrimaryKey(
+    char const *primaryKey)
+{
+    _primaryKey = primaryKey;
+}
+
+void DataTable::Latency(
+    LatencyHistogram *latency)
+{
+    _latency = latency;
+}
+
+void DataTable::Accesses(
+    std::atomic<uint64_t> *accesses)
+{
+    _accesses = accesses;
+}
+
+void DataTable::CountAccess() const
+{
+    if (_accesses != nullptr)
+    {
+        _accesses->fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void DataTable::ClearColumns()
+{
+    _columns.clear();
+}
+
+void DataTable::AddColumn(
+    char const *name,
+    char const *type)
+{
+    // Declared types keep the case they were written in, depending on the sqlite version
+    std::string upperType(type);
+    for (auto &c : upperType)
+    {
+        c = char(std::toupper(static_cast<unsigned char>(c)));
+    }
+
+    auto t = std::string_view(upperType);
+
+    if (t == "INTEGER" || t.substr(0, 7) == "NUMERIC")
+    {
+        _columns.insert(std::make_pair(name, ColumnTypes::Integer));
+    }
+    else if (t == "TEXT" || t.substr(0, 8) == "NVARCHAR")
+    {
+        _columns.insert(std::make_pair(name, ColumnTypes::Text));
+    }
+    else if (t == "BLOB")
+    {
+        _columns.insert(std::make_pair(name, ColumnTypes::Blob));
+    }
+    else if (t == "REAL")
+    {
+        _columns.insert(std::make_pair(name, ColumnTypes::Real));
+    }
+}
+
+void DataTable::AddColumn(
+    std::string const &name,
+    ColumnTypes type)
+{
+    _columns.insert(std::make_pair(name, type));
+}
+
+void DataTable::AddRelation(
+    Relation const &relation,
+    int relatedVersion)
+{
+    for (auto &existing : _relations)
+    {
+        if (existing.name != relation.name)
+        {
+            continue;
+        }
+
+        if (DataTable(existing.table).Version() < relatedVersion)
+        {
+            existing = relation;
+        }
+
+        return;
+    }
+
+    _relations.push_back(relation);
+}
+
+Relation const *DataTable::FindRelation(
+    std::string_view name) const
+{
+    for (auto &relation : _relations)
+    {
+        if (relation.name == name)
+        {
+            return &relation;
+        }
+    }
+
+    return nullptr;
+}
+
+namespace
+{
+    std::string lower(
+        std::string value)
+    {
+        for (auto &c : value)
+        {
+            c = char(std::tolower(static_cast<unsigned char>(c)));
+        }
+
+        return value;
+    }
+
+    const char *text(
+        sqlite3_stmt *stmt,
+        int column)
+    {
+        auto value = reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+
+        return value != nullptr ? value : "";
+    }
+
+    // Adds both sides of every single column foreign key, foreign keys over more columns are skipped
+    void loadRelations(
+        sqlite3 *db,
+        std::vector<DataTable> &tables)
+    {
+        static const char sql[] =
+            "SELECT m.name, f.id, f.seq, f.\"table\", f.\"from\", f.\"to\""
+            " FROM sqlite_master m, pragma_foreign_key_list(m.name) f" USER_TABLES ";";
+
+        struct ForeignKey
+        {
+            std::string table;
+            int id;
+            std::string relatedTable;
+            std::string column;
+            std::string relatedColumn;
+            bool composite;
+        };
+
+        std::vector<ForeignKey> foreignKeys;
+
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, sql, sizeof(sql) - 1, &stmt, nullptr) != SQLITE_OK)
+        {
+            return;
+        }
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            auto table = text(stmt, 0);
+            auto id = sqlite3_column_int(stmt, 1);
+
+            if (sqlite3_column_int(stmt, 2) > 0)
+            {
+                if (!foreignKeys.empty() && foreignKeys.back().table == table && foreignKeys.back().id == id)
+                {
+                    foreignKeys.back().composite = true;
+                }
+                continue;
+            }
+
+            foreignKeys.push_back(ForeignKey{table, id, text(stmt, 3), text(stmt, 4), text(stmt, 5), false});
+        }
+
+        sqlite3_finalize(stmt);
+
+        // sqlite compares table names without case
+        std::map<std::string, size_t> tablesByName;
+        for (size_t i = 0; i < tables.size(); i++)
+        {
+            tablesByName[lower(tables[i].RawName())] = i;
+        }
+
+        struct Link
+        {
+            size_t child;
+            size_t parent;
+            std::string column;
+            std::string relatedColumn;
+        };
+
+        std::vector<Link> links;
+
+        // How many keys of a table point to the same table, those relations can not all be named after it
+        std::map<std::pair<size_t, size_t>, int> keysPerPair;
+
+        for (auto &foreignKey : foreignKeys)
+        {
+            auto child = tablesByName.find(lower(foreignKey.table));
+            auto parent = tablesByName.find(lower(foreignKey.relatedTable));
+            if (foreignKey.composite || child == tablesByName.end() || parent == tablesByName.end())
+            {
+                continue;
+            }
+
+            // Without a column the foreign key points to the primary key
+            auto relatedColumn = foreignKey.relatedColumn.empty() ? tables[parent->second].PrimaryKey() : foreignKey.relatedColumn;
+            if (relatedColumn.empty())
+            {
+                continue;
+            }
+
+            links.push_back(Link{child->second, parent->second, foreignKey.column, relatedColumn});
+            keysPerPair[std::make_pair(child->second, parent->second)]++;
+        }
+
+        for (auto &link : links)
+        {
+            auto &childTable = tables[link.child];
+            auto &parentTable = tables[link.parent];
+
+            // With more keys to the same table, or a key to its own table which gives it both sides, the child
+            // side is named after its column, like AuthorId, and the parent side after the child and the column,
+            // like Posts_AuthorId
+            auto byColumn = link.child == link.parent || keysPerPair[std::make_pair(link.child, link.parent)] > 1;
+
+            auto parentName = byColumn ? link.column : parentTable.Name();
+            auto childName = byColumn ? childTable.Name() + "_" + link.column : childTable.Name();
+
+            childTable.AddRelation(Relation{parentName, parentTable.RawName(), link.column, link.relatedColumn, false}, parentTable.Version());
+            parentTable.AddRelation(Relation{childName, childTable.RawName(), link.relatedColumn, link.column, true}, childTable.Version());
+        }
+    }
+} // namespace
+
+std::vector<DataTable> LoadTables(
+    sqlite3 *db)
+{
+    // pragma_table_info takes the name from the outer loop over sqlite_master, so the
+    // columns of one table come out together and in column order
+    static const char sql[] =
+        "SELECT m.name, p.name, p.type, p.pk"
+        " FROM sqlite_master m, pragma_table_info(m.name) p" USER_TABLES ";";
+
+    std::vector<DataTable> tables;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, sizeof(sql) - 1, &stmt, nullptr) != SQLITE_OK)
+    {
+        return tables;
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        auto tableName = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        auto tableNameLength = size_t(sqlite3_column_bytes(stmt, 0));
+        auto name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+        auto type = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+        auto pk = sqlite3_column_int(stmt, 3);
+
+        if (tables.empty() || tables.back().RawName() != std::string_view(tableName, tableNameLength))
+        {
+            tables.push_back(DataTable(std::string(tableName, tableNameLength)));
+        }
+
+        auto &table = tables.back();
+
+        if (pk != 0)
+        {
+            table.PrimaryKey(name);
+        }
+
+        table.AddColumn(name, type != nullptr ? type : "");
+    }
+
+    sqlite3_finalize(stmt);
+
+    loadRelations(db, tables);
+
+    return tables;
+}
@@ -0,0 +1,99 @@
+#ifndef DATATABLE_H
+#define DATATABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class LatencyHistogram;
+struct sqlite3;
+
+enum class ColumnTypes
+{
+    Integer,
+    Real,
+    Text,
+    Blob,
+};
+
+// A foreign key seen from one of its two tables, used by $expand.
+struct Relation
+{
+    std::string name;          // the name used in $expand, the Name() of the related table, or when a table has more
+                               // keys to the same table the key column (to one) or Name()_column (to many)
+    std::string table;         // the raw name of the related table
+    std::string column;        // the column in this table
+    std::string relatedColumn; // the column in the related table
+    bool many;                 // true when the related table points to this one, so there can be more related rows
+};
+
+// A table exposed by the api. A raw name like "Posts_v2" is served as "Posts" with version 2,
+// a raw name without a version suffix is served as is with version 1.
+class DataTable
+{
+    std::string _rawName;
+    std::string _name = "";
+    int _version = 1;
+    std::string _primaryKey;
+    std::map<std::string, ColumnTypes> _columns;
+    std::vector<Relation> _relations;
+    LatencyHistogram *_latency = nullptr;
+    std::atomic<uint64_t> *_accesses = nullptr;
+
+public:
+    DataTable();
+    explicit DataTable(
+        const std::string &name);
+    DataTable(
+        const std::string &rawName,
+        const std::string &name,
+        int version);
+
+    inline std::string const &RawName() const { return _rawName; }
+    inline std::string const &Name() const { return _name; }
+    inline int Version() const { return _version; }
+    inline std::string const &PrimaryKey() const { return _primaryKey; }
+    inline std::map<std::string, ColumnTypes> const &Columns() const { return _columns; }
+    inline std::vector<Relation> const &Relations() const { return _relations; }
+    inline LatencyHistogram *Latency() const { return _latency; }
+
+    void PrimaryKey(
+        char const *primaryKey);
+
+    void Latency(
+        LatencyHistogram *latency);
+
+    // Sets the counter CountAccess adds to, it outlives the table so the count survives schema reloads.
+    void Accesses(
+        std::atomic<uint64_t> *accesses);
+
+    void CountAccess() const;
+
+    void ClearColumns();
+
+    void AddColumn(
+        char const *name,
+        char const *type);
+
+    void AddColumn(
+        std::string const &name,
+        ColumnTypes type);
+
+    // Adds a relation, when there already is one with the same name the one to the higher table version is kept.
+    void AddRelation(
+        Relation const &relation,
+        int relatedVersion);
+
+    Relation const *FindRelation(
+        std::string_view name) const;
+};
+
+// Loads all tables with their columns in one query over sqlite_master and pragma_table_info,
+// and their relations in one query over sqlite_master and pragma_foreign_key_list.
+std::vector<DataTable> LoadTables(
+    sqlite3 *db);
+
+#endif // DATATABLE_H
@@ -0,0 +1,266 @@
+#include "fulltextsearch.h"
+#include "sqlquote.h"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <sqlite3/sqlite3.h>
+
+namespace
+{
+    std::string trim(
+        std::string_view text)
+    {
+        while (!text.empty() && text.front() == ' ') text.remove_prefix(1);
+        while (!text.empty() && text.back() == ' ') text.remove_suffix(1);
+
+        return std::string(text);
+    }
+
+    // Runs a query with one text parameter and returns the first column of every row
+    std::vector<std::string> column(
+        sqlite3 *db,
+        char const *sql,
+        std::string const &parameter)
+    {
+        std::vector<std::string> result;
+
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+        {
+            return result;
+        }
+
+        sqlite3_bind_text(stmt, 1, parameter.c_str(), int(parameter.length()), SQLITE_STATIC);
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            auto text = sqlite3_column_text(stmt, 0);
+            result.push_back(text != nullptr ? reinterpret_cast<const char *>(text) : "");
+        }
+
+        sqlite3_finalize(stmt);
+
+        return result;
+    }
+
+    bool exec(
+        sqlite3 *db,
+        std::string const &sql,
+        std::string &error)
+    {
+        char *message = nullptr;
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &message) != SQLITE_OK)
+        {
+            error = message != nullptr ? message : sqlite3_errmsg(db);
+            sqlite3_free(message);
+            return false;
+        }
+
+        return true;
+    }
+} // namespace
+
+std::string FullTextIndex::Name() const
+{
+    return table + "_fts";
+}
+
+bool FullTextSearch::Parse(
+    std::string_view option,
+    FullTextIndex &index)
+{
+    auto open = option.find('(');
+    if (open == std::string_view::npos || open == 0 || option.back() != ')')
+    {
+        return false;
+    }
+
+    index.table = trim(option.substr(0, open));
+    index.columns.clear();
+
+    auto list = option.substr(open + 1, option.size() - open - 2);
+    while (true)
+    {
+        auto comma = list.find(',');
+        auto column = trim(list.substr(0, comma));
+
+        if (column.empty())
+        {
+            return false;
+        }
+
+        index.columns.push_back(column);
+
+        if (comma == std::string_view::npos)
+        {
+            break;
+        }
+
+        list = list.substr(comma + 1);
+    }
+
+    return !index.table.empty();
+}
+
+bool FullTextSearch::Install(
+    sqlite3 *db,
+    FullTextIndex &index,
+    std::string &error)
+{
+    auto tables = column(db, "SELECT name FROM sqlite_master WHERE type = 'table' AND name = ? COLLATE NOCASE;", index.table);
+    if (tables.empty())
+    {
+        error = fmt::format("there is no table {0}", index.table);
+        return false;
+    }
+
+    index.table = tables.front();
+
+    auto columns = column(db, "SELECT name FROM pragma_table_info(?);", index.table);
+    for (auto &wanted : index.columns)
+    {
+        auto found = std::find_if(columns.begin(), columns.end(), [&wanted](std::string const &name) {
+            return sqlite3_stricmp(name.c_str(), wanted.c_str()) == 0;
+        });
+
+        if (found == columns.end())
+        {
+            error = fmt::format("there is no column {0} in {1}", wanted, index.table);
+            return false;
+        }
+
+        wanted = *found;
+    }
+
+    // The index points back to the rows by their rowid
+    sqlite3_stmt *stmt = nullptr;
+    auto hasRowid = sqlite3_prepare_v2(db, fmt::format("SELECT rowid FROM {0};", SqlQuote(index.table)).c_str(), -1, &stmt, nullptr) == SQLITE_OK;
+    sqlite3_finalize(stmt);
+
+    if (!hasRowid)
+    {
+        error = fmt::format("{0} is a WITHOUT ROWID table", index.table);
+        return false;
+    }
+
+    std::string names, newValues, oldValues;
+    for (auto &name : index.columns)
+    {
+        names += ", " + SqlQuote(name);
+        newValues += ", new." + SqlQuote(name);
+        oldValues += ", old." + SqlQuote(name);
+    }
+
+    auto fts = SqlQuote(index.Name());
+    auto table = SqlQuote(index.table);
+
+    // sqlite keeps the create statement as it is written, so an index with other columns shows up as other sql
+    auto create = fmt::format("CREATE VIRTUAL TABLE {0} USING fts5({1}, content={2})", fts, names.substr(2), SqlQuote(index.table, '\''));
+
+    auto existing = column(db, "SELECT sql FROM sqlite_master WHERE name = ?;", index.Name());
+    auto rebuild = existing.empty() || existing.front() != create;
+
+    std::string sql = "BEGIN;";
+
+    if (rebuild)
+    {
+        sql += fmt::format(
+            "DROP TABLE IF EXISTS {0};"
+            "DROP TRIGGER IF EXISTS {1};"
+            "DROP TRIGGER IF EXISTS {2};"
+            "DROP TRIGGER IF EXISTS {3};"
+            "{4};",
+            fts,
+            SqlQuote(index.Name() + "_insert"),
+            SqlQuote(index.Name() + "_delete"),
+            SqlQuote(index.Name() + "_update"),
+            create);
+    }
+
+    // An external-content index is told what a row looked like before, to take its words out
+    sql += fmt::format(
+        "CREATE TRIGGER IF NOT EXISTS {0} AFTER INSERT ON {3} BEGIN"
+        " INSERT INTO {4}(rowid{5}) VALUES (new.rowid{6}); END;"
+        "CREATE TRIGGER IF NOT EXISTS {1} AFTER DELETE ON {3} BEGIN"
+        " INSERT INTO {4}({4}, rowid{5}) VALUES ('delete', old.rowid{7}); END;"
+        "CREATE TRIGGER IF NOT EXISTS {2} AFTER UPDATE ON {3} BEGIN"
+        " INSERT INTO {4}({4}, rowid{5}) VALUES ('delete', old.rowid{7});"
+        " INSERT INTO {4}(rowid{5}) VALUES (new.rowid{6}); END;",
+        SqlQuote(index.Name() + "_insert"),
+        SqlQuote(index.Name() + "_delete"),
+        SqlQuote(index.Name() + "_update"),
+        table,
+        fts,
+        names,
+        newValues,
+        oldValues);
+
+    if (rebuild)
+    {
+        sql += fmt::format("INSERT INTO {0}({0}) VALUES ('rebuild');", fts);
+    }
+
+    sql += "COMMIT;";
+
+    if (!exec(db, sql, error))
+    {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    return true;
+}
+
+std::string FullTextSearch::MatchExpression(
+    std::string_view search)
+{
+    std::string expression;
+
+    while (!search.empty())
+    {
+        auto end = search.find_first_of(" \t\r\n");
+        auto word = search.substr(0, end);
+        search = end == std::string_view::npos ? std::string_view() : search.substr(end + 1);
+
+        auto prefix = false;
+        while (!word.empty() && word.back() == '*')
+        {
+            word.remove_suffix(1);
+            prefix = true;
+        }
+
+        if (word.empty())
+        {
+            continue;
+        }
+
+        if (!expression.empty())
+        {
+            expression += ' ';
+        }
+
+        expression += SqlQuote(word);
+
+        if (prefix)
+        {
+            expression += '*';
+        }
+    }
+
+    return expression;
+}
+
+std::string FullTextSearch::Sql(
+    FullTextIndex const &index,
+    std::string const &columns)
+{
+    auto table = SqlQuote(index.table);
+    auto fts = SqlQuote(index.Name());
+
+    return fmt::format(
+        "select {0} from {1}, (select rowid as \"$rowid\", rank as \"$rank\" from {2} where {2} match ? order by rank limit ? offset ?) as s"
+        " where {1}.rowid = s.\"$rowid\" order by s.\"$rank\";",
+        columns == "*" ? table + ".*" : columns,
+        table,
+        fts);
+}
@@ -0,0 +1,50 @@
+#ifndef FULLTEXTSEARCH_H
+#define FULLTEXTSEARCH_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct sqlite3;
+
+// An fts5 index over some text columns of a table, asked for with --fts table(column,...). The index
+// is an external-content table, so the text is not stored twice, and triggers on the table keep it in
+// sync with every write, also the ones from other programs.
+struct FullTextIndex
+{
+    std::string table;
+    std::vector<std::string> columns;
+
+    // The name of the fts5 table, like Posts_v1_fts.
+    std::string Name() const;
+};
+
+class FullTextSearch
+{
+public:
+    // Parses "table(column,column)".
+    static bool Parse(
+        std::string_view option,
+        FullTextIndex &index);
+
+    // Creates the fts5 table with its triggers and fills it, unless it already exists with the same columns.
+    // The table and column names are corrected to the case used in the database. Returns false with a
+    // message in error when the table or a column does not exist, or sqlite has no fts5.
+    static bool Install(
+        sqlite3 *db,
+        FullTextIndex &index,
+        std::string &error);
+
+    // Turns the words of a $search into an fts5 query that matches rows with all words. A word ending
+    // in * matches as a prefix, everything else is taken as text, so no $search is a syntax error.
+    static std::string MatchExpression(
+        std::string_view search);
+
+    // The select for one page of matches, best match first by bm25. Binds the match expression, the
+    // limit and the offset. Columns is the column list like DataCollection::get takes it.
+    static std::string Sql(
+        FullTextIndex const &index,
+        std::string const &columns);
+};
+
+#endif // FULLTEXTSEARCH_H
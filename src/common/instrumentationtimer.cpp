@@ -1,14 +1,47 @@
 #include "instrumentationtimer.h"
-#include <iostream>
+#include "accesslog.h"
+#include "latencyhistogram.h"
+#include "metrics.h"
+#include "tracing.h"
 
-using FloatingPointMicroseconds = std::chrono::duration<double, std::micro>;
+#include <cassert>
+
+namespace
+{
+    thread_local InstrumentationTimer *currentTimer = nullptr;
+}
 
 InstrumentationTimer::InstrumentationTimer(
-    const char *name)
+    std::string_view name)
     : m_Name(name),
       m_StartTimepoint(std::chrono::steady_clock::now()),
-      m_Stopped(false)
-{}
+      m_Stopped(false),
+      m_Parent(currentTimer),
+      m_Route(-1),
+      m_StatusCode(0),
+      m_BytesIn(0),
+      m_BytesOut(0),
+      m_Rows(0),
+      m_Histogram(nullptr)
+{
+    currentTimer = this;
+}
+
+InstrumentationTimer::InstrumentationTimer(
+    std::string_view name,
+    LatencyHistogram *histogram)
+    : InstrumentationTimer(name)
+{
+    m_Histogram = histogram;
+}
+
+InstrumentationTimer::InstrumentationTimer(
+    std::string_view name,
+    std::chrono::steady_clock::time_point start)
+    : InstrumentationTimer(name)
+{
+    m_StartTimepoint = start;
+}
 
 InstrumentationTimer::~InstrumentationTimer()
 {
@@ -16,12 +49,90 @@ InstrumentationTimer::~InstrumentationTimer()
         Stop();
 }
 
+void InstrumentationTimer::SetRoute(
+    int route)
+{
+    m_Route = route;
+}
+
+void InstrumentationTimer::SetMethod(
+    std::string_view method)
+{
+    m_Method = method;
+}
+
+void InstrumentationTimer::SetStatusCode(
+    int statusCode)
+{
+    m_StatusCode = statusCode;
+}
+
+void InstrumentationTimer::SetBytes(
+    size_t bytesIn,
+    size_t bytesOut)
+{
+    m_BytesIn = bytesIn;
+    m_BytesOut = bytesOut;
+}
+
+void InstrumentationTimer::AddRows(
+    uint64_t rows)
+{
+    m_Rows += rows;
+}
+
+void InstrumentationTimer::SetHistogram(
+    LatencyHistogram *histogram)
+{
+    m_Histogram = histogram;
+}
+
 void InstrumentationTimer::Stop()
 {
     auto endTimepoint = std::chrono::steady_clock::now();
-    auto elapsedTime = std::chrono::time_point_cast<std::chrono::microseconds>(endTimepoint).time_since_epoch() - std::chrono::time_point_cast<std::chrono::microseconds>(m_StartTimepoint).time_since_epoch();
+    auto elapsedTime = std::chrono::duration_cast<std::chrono::microseconds>(endTimepoint - m_StartTimepoint);
+
+    if (m_Route >= 0)
+    {
+        Metrics::RecordRequest(m_Route, m_StatusCode, elapsedTime, m_BytesIn, m_BytesOut);
+    }
+
+    if (m_Route >= 0 && AccessLog::IsOpen())
+    {
+        AccessLogRecord record;
+
+        auto startTime = std::chrono::system_clock::now() - elapsedTime;
+
+        record.timestampMicros = std::chrono::duration_cast<std::chrono::microseconds>(startTime.time_since_epoch()).count();
+        record.SetMethod(m_Method);
+        record.SetPath(m_Name);
+        record.statusCode = m_StatusCode;
+        record.latencyMicros = uint32_t(elapsedTime.count());
+        record.bytesIn = m_BytesIn;
+        record.bytesOut = m_BytesOut;
+        record.rows = m_Rows;
+
+        AccessLog::Write(record);
+    }
+
+    if (m_Histogram != nullptr)
+    {
+        m_Histogram->Record(elapsedTime);
+    }
+
+    if (Tracing::IsEnabled())
+    {
+        Tracing::AddSpan(m_Name, m_StartTimepoint, endTimepoint);
+    }
+
+    if (m_Parent != nullptr)
+    {
+        m_Parent->AddRows(m_Rows);
+    }
 
-    std::cout << "Rendered " << m_Name << " in " << elapsedTime.count() / 1000.f << "ms" << std::endl;
+    // Timers nest like scopes, a parent that stopped first would leave this pointing at a destroyed timer
+    assert(currentTimer == this);
+    currentTimer = m_Parent;
 
     m_Stopped = true;
 }
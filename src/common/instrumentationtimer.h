@@ -2,21 +2,68 @@
 #define INSTRUMENTATIONTIMER_H
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
 
+class LatencyHistogram;
+
+// Times a scope as a span. Spans nest per thread, what is counted in a nested span (like rows) is added to its parent
+// when it stops, and every span is added to the trace when tracing is enabled. A timer with a route set is the
+// request timer, it records the request in the metrics and the access log.
 class InstrumentationTimer
 {
 public:
     explicit InstrumentationTimer(
-        const char *name);
+        std::string_view name);
+
+    InstrumentationTimer(
+        std::string_view name,
+        LatencyHistogram *histogram);
+
+    // Times from start on, for a request that started earlier, like one answered after it waited in a long poll.
+    InstrumentationTimer(
+        std::string_view name,
+        std::chrono::steady_clock::time_point start);
 
     ~InstrumentationTimer();
 
+    // Sets the route the request is recorded under in the metrics, without a route nothing is recorded.
+    void SetRoute(
+        int route);
+
+    void SetMethod(
+        std::string_view method);
+
+    void SetStatusCode(
+        int statusCode);
+
+    void SetBytes(
+        size_t bytesIn,
+        size_t bytesOut);
+
+    void AddRows(
+        uint64_t rows);
+
+    // Sets the histogram the elapsed time is recorded in when the timer stops.
+    void SetHistogram(
+        LatencyHistogram *histogram);
+
+    // Timers on a thread stop in the reverse order they started, the destructor stops a timer that was not stopped.
     void Stop();
 
 private:
-    const char *m_Name;
+    std::string_view m_Name;
     std::chrono::time_point<std::chrono::steady_clock> m_StartTimepoint;
     bool m_Stopped;
+    InstrumentationTimer *m_Parent;
+    int m_Route;
+    std::string_view m_Method;
+    int m_StatusCode;
+    size_t m_BytesIn;
+    size_t m_BytesOut;
+    uint64_t m_Rows;
+    LatencyHistogram *m_Histogram;
 };
 
 #endif // INSTRUMENTATIONTIMER_H
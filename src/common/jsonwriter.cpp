@@ -0,0 +1,168 @@
+#include "jsonwriter.h"
+
+#include <charconv>
+#include <cmath>
+#include <fmt/format.h>
+#include <iterator>
+
+JsonWriter::JsonWriter(
+    std::pmr::string &output)
+    : _output(output),
+      _hasElements(0),
+      _depth(0),
+      _afterKey(false)
+{}
+
+void JsonWriter::BeginArray()
+{
+    Separator();
+    _output += '[';
+    _depth++;
+    _hasElements &= ~(uint64_t(1) << (_depth % 64));
+}
+
+void JsonWriter::EndArray()
+{
+    _depth--;
+    _output += ']';
+}
+
+void JsonWriter::BeginObject()
+{
+    Separator();
+    _output += '{';
+    _depth++;
+    _hasElements &= ~(uint64_t(1) << (_depth % 64));
+}
+
+void JsonWriter::EndObject()
+{
+    _depth--;
+    _output += '}';
+}
+
+void JsonWriter::Key(
+    std::string_view key)
+{
+    Separator();
+    Escaped(key);
+    _output += ':';
+    _afterKey = true;
+}
+
+void JsonWriter::String(
+    std::string_view value)
+{
+    Separator();
+    Escaped(value);
+}
+
+void JsonWriter::Integer(
+    long long value)
+{
+    Separator();
+
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    _output.append(buffer, result.ptr);
+}
+
+void JsonWriter::Real(
+    double value)
+{
+    Separator();
+
+    if (!std::isfinite(value))
+    {
+        _output += "null";
+        return;
+    }
+
+    fmt::format_to(std::back_inserter(_output), "{}", value);
+}
+
+void JsonWriter::Boolean(
+    bool value)
+{
+    Separator();
+    _output += value ? "true" : "false";
+}
+
+void JsonWriter::Null()
+{
+    Separator();
+    _output += "null";
+}
+
+void JsonWriter::Separator()
+{
+    if (_afterKey)
+    {
+        _afterKey = false;
+        return;
+    }
+
+    auto bit = uint64_t(1) << (_depth % 64);
+
+    if (_hasElements & bit)
+    {
+        _output += ',';
+    }
+
+    _hasElements |= bit;
+}
+
+void JsonWriter::Escaped(
+    std::string_view value)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    _output += '"';
+
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        auto c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+
+        _output.append(value.data() + start, i - start);
+        start = i + 1;
+
+        switch (c)
+        {
+            case '"':
+                _output += "\\\"";
+                break;
+            case '\\':
+                _output += "\\\\";
+                break;
+            case '\b':
+                _output += "\\b";
+                break;
+            case '\f':
+                _output += "\\f";
+                break;
+            case '\n':
+                _output += "\\n";
+                break;
+            case '\r':
+                _output += "\\r";
+                break;
+            case '\t':
+                _output += "\\t";
+                break;
+            default:
+            {
+                char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                _output.append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+
+    _output.append(value.data() + start, value.size() - start);
+    _output += '"';
+}
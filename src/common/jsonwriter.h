@@ -0,0 +1,53 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+// Writes json text straight into a string, without building a json document first.
+class JsonWriter
+{
+public:
+    explicit JsonWriter(
+        std::pmr::string &output);
+
+    void BeginArray();
+
+    void EndArray();
+
+    void BeginObject();
+
+    void EndObject();
+
+    void Key(
+        std::string_view key);
+
+    void String(
+        std::string_view value);
+
+    void Integer(
+        long long value);
+
+    void Real(
+        double value);
+
+    void Boolean(
+        bool value);
+
+    void Null();
+
+private:
+    std::pmr::string &_output;
+    uint64_t _hasElements;
+    int _depth;
+    bool _afterKey;
+
+    void Separator();
+
+    void Escaped(
+        std::string_view value);
+};
+
+#endif // JSONWRITER_H
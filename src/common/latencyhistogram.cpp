@@ -0,0 +1,226 @@
+#include "latencyhistogram.h"
+#include "jsonwriter.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+LatencyHistogram::LatencyHistogram()
+    : _counts(),
+      _count(0),
+      _sum(0),
+      _max(0)
+{}
+
+int LatencyHistogram::BucketIndex(
+    uint64_t value)
+{
+    if (value >= (uint64_t(1) << MaxValueBits))
+    {
+        value = (uint64_t(1) << MaxValueBits) - 1;
+    }
+
+    int highestBit = 0;
+    for (auto v = value; v > 1; v >>= 1)
+    {
+        highestBit++;
+    }
+
+    int shift = highestBit > SubBucketBits ? highestBit - SubBucketBits : 0;
+
+    return shift * SubBucketCount + int(value >> shift);
+}
+
+uint64_t LatencyHistogram::BucketLowestValue(
+    int bucket)
+{
+    if (bucket < 2 * SubBucketCount)
+    {
+        return uint64_t(bucket);
+    }
+
+    int shift = bucket / SubBucketCount - 1;
+    uint64_t mantissa = uint64_t(bucket - shift * SubBucketCount);
+
+    return mantissa << shift;
+}
+
+void LatencyHistogram::Record(
+    std::chrono::microseconds latency)
+{
+    auto value = latency.count() < 0 ? uint64_t(0) : uint64_t(latency.count());
+
+    _counts[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+
+    auto max = _max.load(std::memory_order_relaxed);
+    while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::Reset()
+{
+    for (auto &count : _counts)
+    {
+        count.store(0, std::memory_order_relaxed);
+    }
+
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Count() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Max() const
+{
+    return _max.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::Mean() const
+{
+    auto count = Count();
+    if (count == 0)
+    {
+        return 0.0;
+    }
+
+    return double(_sum.load(std::memory_order_relaxed)) / double(count);
+}
+
+uint64_t LatencyHistogram::Percentile(
+    double fraction) const
+{
+    uint64_t total = 0;
+    for (auto &count : _counts)
+    {
+        total += count.load(std::memory_order_relaxed);
+    }
+
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    auto target = uint64_t(fraction * double(total) + 0.5);
+    if (target < 1)
+    {
+        target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; i++)
+    {
+        seen += _counts[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            // Report the highest value that falls in the bucket, but never more than what was recorded
+            auto highest = BucketLowestValue(i + 1) - 1;
+            auto max = Max();
+
+            return highest < max ? highest : max;
+        }
+    }
+
+    return Max();
+}
+
+namespace
+{
+    struct Registry
+    {
+        std::mutex mutex;
+        std::map<std::pair<std::string, std::string>, std::unique_ptr<LatencyHistogram>> histograms;
+    };
+
+    Registry &registry()
+    {
+        static Registry instance;
+
+        return instance;
+    }
+} // namespace
+
+LatencyHistogram *LatencyHistograms::Get(
+    std::string const &group,
+    std::string const &name)
+{
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    auto &histogram = r.histograms[std::make_pair(group, name)];
+    if (!histogram)
+    {
+        histogram = std::make_unique<LatencyHistogram>();
+    }
+
+    return histogram.get();
+}
+
+void LatencyHistograms::Write(
+    JsonWriter &writer)
+{
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    writer.BeginObject();
+
+    std::string group;
+    for (auto &pair : r.histograms)
+    {
+        if (pair.first.first != group)
+        {
+            if (!group.empty())
+            {
+                writer.EndObject();
+            }
+            group = pair.first.first;
+            writer.Key(group);
+            writer.BeginObject();
+        }
+
+        auto &histogram = *pair.second;
+
+        writer.Key(pair.first.second);
+        writer.BeginObject();
+        writer.Key("count");
+        writer.Integer(static_cast<long long>(histogram.Count()));
+        writer.Key("mean_us");
+        writer.Real(histogram.Mean());
+        writer.Key("max_us");
+        writer.Integer(static_cast<long long>(histogram.Max()));
+        writer.Key("p50_us");
+        writer.Integer(static_cast<long long>(histogram.Percentile(0.5)));
+        writer.Key("p90_us");
+        writer.Integer(static_cast<long long>(histogram.Percentile(0.9)));
+        writer.Key("p99_us");
+        writer.Integer(static_cast<long long>(histogram.Percentile(0.99)));
+        writer.Key("p999_us");
+        writer.Integer(static_cast<long long>(histogram.Percentile(0.999)));
+        writer.EndObject();
+    }
+
+    if (!group.empty())
+    {
+        writer.EndObject();
+    }
+
+    writer.EndObject();
+}
+
+void LatencyHistograms::Reset()
+{
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    for (auto &pair : r.histograms)
+    {
+        pair.second->Reset();
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+class JsonWriter;
+
+// Log-linear (HDR style) histogram of latencies in microseconds, with fixed memory and lock-free recording.
+// Every power of two is split in 32 linear sub buckets, so values are kept with a precision of about 3%.
+class LatencyHistogram
+{
+public:
+    static const int SubBucketBits = 5;
+    static const int SubBucketCount = 1 << SubBucketBits;
+    static const int MaxValueBits = 32;
+    static const int BucketCount = (MaxValueBits - SubBucketBits) * SubBucketCount + SubBucketCount;
+
+    LatencyHistogram();
+
+    void Record(
+        std::chrono::microseconds latency);
+
+    // Clears the histogram, records that happen while resetting may be lost.
+    void Reset();
+
+    uint64_t Count() const;
+
+    uint64_t Max() const;
+
+    double Mean() const;
+
+    // Gets the latency in microseconds below which the given fraction (0.0 - 1.0) of the recorded latencies fall.
+    uint64_t Percentile(
+        double fraction) const;
+
+    static int BucketIndex(
+        uint64_t value);
+
+    static uint64_t BucketLowestValue(
+        int bucket);
+
+private:
+    std::atomic<uint64_t> _counts[BucketCount];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _max;
+};
+
+// Named latency histograms by group (like "routes" and "tables"), they are created once and never freed.
+class LatencyHistograms
+{
+public:
+    static LatencyHistogram *Get(
+        std::string const &group,
+        std::string const &name);
+
+    // Writes count, mean, max, p50, p90, p99 and p999 of every histogram as json.
+    static void Write(
+        JsonWriter &writer);
+
+    static void Reset();
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,220 @@
+#include "longpoll.h"
+
+#include "changefeed.h"
+
+#include <algorithm>
+#include <charconv>
+
+constexpr std::chrono::seconds LongPoll::MaxWait;
+
+LongPoll::LongPoll(
+    ChangeFeed &feed)
+    : _feed(feed),
+      _stopping(false),
+      _published(false)
+{
+    _feed.OnPublish([this]() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _published = true;
+        _changed.notify_one();
+    });
+}
+
+LongPoll::~LongPoll()
+{
+    _feed.OnPublish(nullptr);
+
+    Stop();
+}
+
+void LongPoll::Park(
+    std::string const &table,
+    uint64_t since,
+    std::chrono::milliseconds wait,
+    Completion complete)
+{
+    auto parked = std::make_unique<Parked>();
+    parked->table = table;
+    parked->since = since;
+    parked->deadline = std::chrono::steady_clock::now() + std::min<std::chrono::milliseconds>(wait, MaxWait);
+    parked->complete = std::move(complete);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _parking[std::this_thread::get_id()] = std::move(parked);
+}
+
+bool LongPoll::Parking() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _parking.find(std::this_thread::get_id()) != _parking.end();
+}
+
+bool LongPoll::Adopt(
+    std::shared_ptr<void> owner,
+    Dispatch dispatch)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = _parking.find(std::this_thread::get_id());
+    if (found == _parking.end())
+    {
+        return false;
+    }
+
+    auto parked = std::move(found->second);
+    _parking.erase(found);
+
+    parked->owner = std::move(owner);
+    parked->dispatch = std::move(dispatch);
+
+    if (_stopping)
+    {
+        // Dropping the owner closes the request without an answer, like any request after stop
+        return true;
+    }
+
+    _parked.push_back(std::move(parked));
+
+    if (!_thread.joinable())
+    {
+        _thread = std::thread(&LongPoll::run, this);
+    }
+
+    // The table may have changed between the check of the handler and now, so the new request is checked right away
+    _published = true;
+    _changed.notify_one();
+
+    return true;
+}
+
+size_t LongPoll::Count() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _parked.size();
+}
+
+void LongPoll::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+        _parking.clear();
+    }
+
+    _changed.notify_one();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+bool LongPoll::ParseWait(
+    std::string_view text,
+    std::chrono::milliseconds &wait)
+{
+    long long amount = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), amount);
+    if (result.ec != std::errc() || result.ptr == text.data() || amount < 0)
+    {
+        return false;
+    }
+
+    auto unit = text.substr(result.ptr - text.data());
+    if (unit.empty() || unit == "s")
+    {
+        wait = std::chrono::seconds(std::min<long long>(amount, MaxWait.count()));
+    }
+    else if (unit == "ms")
+    {
+        wait = std::chrono::milliseconds(std::min<long long>(amount, std::chrono::milliseconds(MaxWait).count()));
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void LongPoll::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        auto stopping = _stopping;
+        auto now = std::chrono::steady_clock::now();
+
+        // The requests are answered without the lock, an answer can run a query and write to a slow client
+        std::vector<std::pair<std::unique_ptr<Parked>, Results>> done;
+
+        for (auto &parked : _parked)
+        {
+            if (stopping)
+            {
+                done.push_back(std::make_pair(std::move(parked), Results::Stopped));
+            }
+            else if (_published && _feed.TableVersion(parked->table) != parked->since)
+            {
+                done.push_back(std::make_pair(std::move(parked), Results::Changed));
+            }
+            else if (parked->deadline <= now)
+            {
+                done.push_back(std::make_pair(std::move(parked), Results::TimedOut));
+            }
+        }
+
+        _published = false;
+
+        _parked.erase(
+            std::remove(_parked.begin(), _parked.end(), nullptr),
+            _parked.end());
+
+        if (!done.empty())
+        {
+            lock.unlock();
+
+            // Releasing the owner after the answer closes the connection
+            for (auto &answer : done)
+            {
+                std::shared_ptr<Parked> parked(std::move(answer.first));
+                auto result = answer.second;
+
+                if (parked->dispatch)
+                {
+                    auto dispatch = parked->dispatch;
+                    dispatch(result, [parked, result]() {
+                        parked->complete(result);
+                    });
+                }
+                else
+                {
+                    parked->complete(result);
+                }
+            }
+
+            lock.lock();
+
+            continue;
+        }
+
+        if (stopping)
+        {
+            break;
+        }
+
+        auto deadline = now + MaxWait;
+        for (auto &parked : _parked)
+        {
+            deadline = std::min(deadline, parked->deadline);
+        }
+
+        _changed.wait_until(lock, deadline, [this]() {
+            return _stopping || _published;
+        });
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef LONGPOLL_H
+#define LONGPOLL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class ChangeFeed;
+
+// Holds the requests that wait for a table to change, like GET /api/Posts?since=N&wait=30s. A parked
+// request costs an entry in a list instead of a thread: one thread wakes when the feed publishes or a
+// deadline passes, and hands out the answers of the requests whose table version moved on or whose
+// wait is over. The versions come from the feed, so only writes made through this process wake a
+// request, a change made by another program is seen when the wait is over.
+class LongPoll
+{
+public:
+    static constexpr std::chrono::seconds MaxWait = std::chrono::seconds(120);
+
+    enum class Results
+    {
+        Changed,
+        TimedOut,
+        Stopped,
+    };
+
+    // Answers a parked request.
+    typedef std::function<void(Results result)> Completion;
+
+    // The completion of a parked request together with what keeps the request alive.
+    typedef std::function<void()> Answer;
+
+    // Runs the answer somewhere else than the thread of the long poll, like on the workers of the server.
+    // Dropping the answer without running it closes the request.
+    typedef std::function<void(Results result, Answer answer)> Dispatch;
+
+    explicit LongPoll(
+        ChangeFeed &feed);
+
+    ~LongPoll();
+
+    LongPoll(LongPoll const &) = delete;
+    LongPoll &operator=(LongPoll const &) = delete;
+
+    // Parks the request handled on this thread until the version of the table is no longer since, or the
+    // wait is over. It is only answered after Adopt hands over what keeps the request alive.
+    void Park(
+        std::string const &table,
+        uint64_t since,
+        std::chrono::milliseconds wait,
+        Completion complete);
+
+    // Whether the request handled on this thread was parked and waits for Adopt.
+    bool Parking() const;
+
+    // Gives the request parked by the last Park on this thread its owner, returns false when nothing was parked.
+    // Without a dispatch the answer runs on the thread of the long poll.
+    bool Adopt(
+        std::shared_ptr<void> owner,
+        Dispatch dispatch = nullptr);
+
+    size_t Count() const;
+
+    // Answers all parked requests with Stopped and ends the thread.
+    void Stop();
+
+    // Parses a wait like 30s, 500ms or 30 (seconds), up to MaxWait.
+    static bool ParseWait(
+        std::string_view text,
+        std::chrono::milliseconds &wait);
+
+private:
+    struct Parked
+    {
+        std::string table;
+        uint64_t since;
+        std::chrono::steady_clock::time_point deadline;
+        Completion complete;
+        Dispatch dispatch;
+        std::shared_ptr<void> owner;
+    };
+
+    void run();
+
+    ChangeFeed &_feed;
+    mutable std::mutex _mutex;
+    std::condition_variable _changed;
+    std::thread _thread;
+    bool _stopping;
+    bool _published;
+    std::unordered_map<std::thread::id, std::unique_ptr<Parked>> _parking;
+    std::vector<std::unique_ptr<Parked>> _parked;
+};
+
+#endif // LONGPOLL_H
@@ -0,0 +1,132 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : _data(nullptr), _size(0)
+#ifdef _WIN32
+      ,
+      _file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+#endif
+{}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(
+    std::string const &path)
+{
+    Close();
+
+    _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    _data = static_cast<const char *>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (_data == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    _size = size_t(size.QuadPart);
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data != nullptr)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(_file);
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _mapping = nullptr;
+    _file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(
+    std::string const &path)
+{
+    Close();
+
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    auto data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping stays valid after the file is closed
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    _data = static_cast<const char *>(data);
+    _size = size_t(info.st_size);
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data != nullptr)
+    {
+        munmap(const_cast<char *>(_data), _size);
+    }
+
+    _data = nullptr;
+    _size = 0;
+}
+
+#endif
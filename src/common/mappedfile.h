@@ -0,0 +1,35 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Maps a whole file read-only into memory.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile &operator=(MappedFile const &) = delete;
+
+    // Returns false when the file does not exist, is empty or could not be mapped.
+    bool Open(
+        std::string const &path);
+
+    void Close();
+
+    inline const char *Data() const { return _data; }
+    inline size_t Size() const { return _size; }
+
+private:
+    const char *_data;
+    size_t _size;
+#ifdef _WIN32
+    void *_file;
+    void *_mapping;
+#endif
+};
+
+#endif // MAPPEDFILE_H
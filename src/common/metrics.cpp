@@ -0,0 +1,312 @@
+#include "metrics.h"
+
+#include <atomic>
+#include <cstdint>
+#include <fmt/format.h>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    const int statusCodes[] = {200, 204, 302, 304, 400, 404, 405, 408, 413, 429, 500, 503};
+    const int StatusCodeCount = sizeof(statusCodes) / sizeof(statusCodes[0]) + 1; // the last one counts all other codes
+
+    const double latencyBuckets[] = {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+    const int LatencyBucketCount = sizeof(latencyBuckets) / sizeof(latencyBuckets[0]) + 1; // the last one is +Inf
+
+    // Only the owning thread writes to a shard, so a relaxed load and store is enough and cheaper than an atomic add
+    void addRelaxed(
+        std::atomic<uint64_t> &counter,
+        uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    struct RouteShard
+    {
+        std::atomic<uint64_t> requests[StatusCodeCount] = {};
+        std::atomic<uint64_t> latency[LatencyBucketCount] = {};
+        std::atomic<uint64_t> latencySumMicros = {0};
+        std::atomic<uint64_t> bytesIn = {0};
+        std::atomic<uint64_t> bytesOut = {0};
+    };
+
+    struct Shard
+    {
+        RouteShard routes[Metrics::MaxRoutes];
+        std::atomic<uint64_t> counters[Metrics::CounterCount] = {};
+    };
+
+    struct CounterInfo
+    {
+        const char *name;
+        const char *help;
+    };
+
+    const CounterInfo counterInfos[Metrics::CounterCount] = {
+        {"asr_sqlite_steps_total", "Calls to sqlite3_step."},
+        {"asr_access_log_dropped_total", "Access log records dropped because the log buffer was full."},
+        {"asr_sqlite_fullscan_steps_total", "Steps forward in a full table scan, from sqlite3_stmt_status."},
+        {"asr_sqlite_sorts_total", "Sort operations, from sqlite3_stmt_status."},
+        {"asr_sqlite_autoindexes_total", "Rows inserted into automatic indexes, from sqlite3_stmt_status."},
+        {"asr_slow_queries_total", "Statements that ran longer than the slow query threshold."},
+        {"asr_query_timeouts_total", "Requests whose queries were stopped at the query timeout."},
+        {"asr_query_disconnects_total", "Requests whose queries were stopped because the client disconnected."},
+        {"asr_admission_rejected_total", "Requests refused with 503 because all workers were busy and the queue was full."},
+        {"asr_rate_limited_total", "Requests refused with 429 because their client ran out of rate limit tokens."},
+        {"asr_handler_errors_total", "Requests whose handler failed with an exception, answered with 400 or 500."},
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::string routeNames[Metrics::MaxRoutes];
+        std::atomic<int> routeCount = {0};
+    };
+
+    Registry &registry()
+    {
+        static Registry instance;
+
+        return instance;
+    }
+
+    // Shards are never freed, so counters of threads that finished stay in the totals
+    Shard &threadShard()
+    {
+        thread_local Shard *shard = nullptr;
+
+        if (shard == nullptr)
+        {
+            auto &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+
+            r.shards.push_back(std::make_unique<Shard>());
+            shard = r.shards.back().get();
+        }
+
+        return *shard;
+    }
+
+    int statusCodeIndex(
+        int statusCode)
+    {
+        for (int i = 0; i < StatusCodeCount - 1; i++)
+        {
+            if (statusCodes[i] == statusCode)
+            {
+                return i;
+            }
+        }
+
+        return StatusCodeCount - 1;
+    }
+
+    int latencyBucketIndex(
+        std::chrono::microseconds latency)
+    {
+        auto seconds = latency.count() / 1000000.0;
+
+        for (int i = 0; i < LatencyBucketCount - 1; i++)
+        {
+            if (seconds <= latencyBuckets[i])
+            {
+                return i;
+            }
+        }
+
+        return LatencyBucketCount - 1;
+    }
+
+    std::string labelValue(
+        std::string const &value)
+    {
+        std::string result;
+
+        for (auto c : value)
+        {
+            if (c == '\\' || c == '"')
+            {
+                result += '\\';
+            }
+            else if (c == '\n')
+            {
+                result += "\\n";
+                continue;
+            }
+            result += c;
+        }
+
+        return result;
+    }
+} // namespace
+
+int Metrics::RegisterRoute(
+    std::string const &name)
+{
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    auto count = r.routeCount.load();
+    for (int i = 0; i < count; i++)
+    {
+        if (r.routeNames[i] == name)
+        {
+            return i;
+        }
+    }
+
+    if (count == MaxRoutes)
+    {
+        return -1;
+    }
+
+    r.routeNames[count] = name;
+    r.routeCount.store(count + 1);
+
+    return count;
+}
+
+void Metrics::RecordRequest(
+    int route,
+    int statusCode,
+    std::chrono::microseconds latency,
+    size_t bytesIn,
+    size_t bytesOut)
+{
+    if (route < 0 || route >= MaxRoutes)
+    {
+        return;
+    }
+
+    auto &shard = threadShard().routes[route];
+
+    addRelaxed(shard.requests[statusCodeIndex(statusCode)], 1);
+    addRelaxed(shard.latency[latencyBucketIndex(latency)], 1);
+    addRelaxed(shard.latencySumMicros, uint64_t(latency.count()));
+    addRelaxed(shard.bytesIn, bytesIn);
+    addRelaxed(shard.bytesOut, bytesOut);
+}
+
+void Metrics::Add(
+    Counter counter,
+    size_t value)
+{
+    addRelaxed(threadShard().counters[counter], value);
+}
+
+void Metrics::Scrape(
+    std::pmr::string &output)
+{
+    auto &r = registry();
+
+    RouteShard totals[MaxRoutes];
+    uint64_t counters[CounterCount] = {};
+    int routeCount = 0;
+    std::vector<std::string> routes;
+
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+
+        routeCount = r.routeCount.load();
+        for (int i = 0; i < routeCount; i++)
+        {
+            routes.push_back(labelValue(r.routeNames[i]));
+        }
+
+        for (auto &shard : r.shards)
+        {
+            for (int i = 0; i < routeCount; i++)
+            {
+                auto &from = shard->routes[i];
+                auto &to = totals[i];
+
+                for (int s = 0; s < StatusCodeCount; s++)
+                {
+                    addRelaxed(to.requests[s], from.requests[s].load(std::memory_order_relaxed));
+                }
+                for (int b = 0; b < LatencyBucketCount; b++)
+                {
+                    addRelaxed(to.latency[b], from.latency[b].load(std::memory_order_relaxed));
+                }
+                addRelaxed(to.latencySumMicros, from.latencySumMicros.load(std::memory_order_relaxed));
+                addRelaxed(to.bytesIn, from.bytesIn.load(std::memory_order_relaxed));
+                addRelaxed(to.bytesOut, from.bytesOut.load(std::memory_order_relaxed));
+            }
+            for (int c = 0; c < CounterCount; c++)
+            {
+                counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    auto out = std::back_inserter(output);
+
+    output += "# HELP asr_http_requests_total Requests handled, by route and status code.\n"
+              "# TYPE asr_http_requests_total counter\n";
+    for (int i = 0; i < routeCount; i++)
+    {
+        for (int s = 0; s < StatusCodeCount; s++)
+        {
+            auto count = totals[i].requests[s].load();
+            if (count == 0)
+            {
+                continue;
+            }
+
+            if (s < StatusCodeCount - 1)
+            {
+                fmt::format_to(out, "asr_http_requests_total{{route=\"{0}\",code=\"{1}\"}} {2}\n", routes[i], statusCodes[s], count);
+            }
+            else
+            {
+                fmt::format_to(out, "asr_http_requests_total{{route=\"{0}\",code=\"other\"}} {1}\n", routes[i], count);
+            }
+        }
+    }
+
+    output += "# HELP asr_http_request_duration_seconds Time from routing a request until its response is sent.\n"
+              "# TYPE asr_http_request_duration_seconds histogram\n";
+    for (int i = 0; i < routeCount; i++)
+    {
+        uint64_t cumulative = 0;
+        for (int b = 0; b < LatencyBucketCount; b++)
+        {
+            cumulative += totals[i].latency[b].load();
+            if (b < LatencyBucketCount - 1)
+            {
+                fmt::format_to(out, "asr_http_request_duration_seconds_bucket{{route=\"{0}\",le=\"{1}\"}} {2}\n", routes[i], latencyBuckets[b], cumulative);
+            }
+            else
+            {
+                fmt::format_to(out, "asr_http_request_duration_seconds_bucket{{route=\"{0}\",le=\"+Inf\"}} {1}\n", routes[i], cumulative);
+            }
+        }
+        fmt::format_to(out, "asr_http_request_duration_seconds_sum{{route=\"{0}\"}} {1}\n", routes[i], totals[i].latencySumMicros.load() / 1000000.0);
+        fmt::format_to(out, "asr_http_request_duration_seconds_count{{route=\"{0}\"}} {1}\n", routes[i], cumulative);
+    }
+
+    output += "# HELP asr_http_request_bytes_total Bytes received in request payloads.\n"
+              "# TYPE asr_http_request_bytes_total counter\n";
+    for (int i = 0; i < routeCount; i++)
+    {
+        fmt::format_to(out, "asr_http_request_bytes_total{{route=\"{0}\"}} {1}\n", routes[i], totals[i].bytesIn.load());
+    }
+
+    output += "# HELP asr_http_response_bytes_total Bytes sent in response bodies.\n"
+              "# TYPE asr_http_response_bytes_total counter\n";
+    for (int i = 0; i < routeCount; i++)
+    {
+        fmt::format_to(out, "asr_http_response_bytes_total{{route=\"{0}\"}} {1}\n", routes[i], totals[i].bytesOut.load());
+    }
+
+    for (int c = 0; c < CounterCount; c++)
+    {
+        fmt::format_to(out, "# HELP {0} {1}\n", counterInfos[c].name, counterInfos[c].help);
+        fmt::format_to(out, "# TYPE {0} counter\n", counterInfos[c].name);
+        fmt::format_to(out, "{0} {1}\n", counterInfos[c].name, counters[c]);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+
+// Request metrics, recorded without locks into a shard per thread and merged when they are scraped.
+class Metrics
+{
+public:
+    static const int MaxRoutes = 64;
+
+    enum Counter
+    {
+        SqliteSteps,
+        AccessLogDropped,
+        SqliteFullscanSteps,
+        SqliteSorts,
+        SqliteAutoindexes,
+        SlowQueries,
+        QueryTimeouts,
+        QueryDisconnects,
+        AdmissionRejected,
+        RateLimited,
+        HandlerErrors,
+        CounterCount,
+    };
+
+    // Registers a route label and returns its id, routes must be registered before requests are recorded.
+    static int RegisterRoute(
+        std::string const &name);
+
+    static void RecordRequest(
+        int route,
+        int statusCode,
+        std::chrono::microseconds latency,
+        size_t bytesIn,
+        size_t bytesOut);
+
+    static void Add(
+        Counter counter,
+        size_t value);
+
+    // Writes all metrics in the Prometheus text exposition format.
+    static void Scrape(
+        std::pmr::string &output);
+};
+
+#endif // METRICS_H
@@ -0,0 +1,100 @@
+#include "querybudget.h"
+
+#include "metrics.h"
+
+#include <atomic>
+#include <sqlite3/sqlite3.h>
+
+constexpr std::chrono::milliseconds QueryBudget::ClientCheckInterval;
+
+namespace
+{
+    thread_local QueryBudget *currentBudget = nullptr;
+    std::atomic<bool> shuttingDown(false);
+}
+
+QueryBudget::QueryBudget(
+    std::chrono::milliseconds timeout,
+    std::function<bool()> clientConnected)
+    : _timeout(timeout),
+      _deadline(std::chrono::steady_clock::now() + timeout),
+      _nextClientCheck(std::chrono::steady_clock::now() + ClientCheckInterval),
+      _clientConnected(std::move(clientConnected)),
+      _reason(Reasons::None),
+      _previous(currentBudget)
+{
+    currentBudget = this;
+}
+
+QueryBudget::~QueryBudget()
+{
+    currentBudget = _previous;
+}
+
+void QueryBudget::Install(
+    sqlite3 *db)
+{
+    sqlite3_progress_handler(
+        db,
+        ProgressInstructions,
+        [](void *) {
+            auto budget = currentBudget;
+
+            // Returning non-zero stops the statement that is stepped on this thread
+            return budget != nullptr && budget->Exhausted() ? 1 : 0;
+        },
+        nullptr);
+}
+
+void QueryBudget::SetShuttingDown(
+    bool value)
+{
+    shuttingDown = value;
+}
+
+QueryBudget *QueryBudget::Current()
+{
+    return currentBudget;
+}
+
+QueryBudget::Reasons QueryBudget::Reason() const
+{
+    return _reason;
+}
+
+std::chrono::milliseconds QueryBudget::Timeout() const
+{
+    return _timeout;
+}
+
+bool QueryBudget::Exhausted()
+{
+    if (_reason != Reasons::None)
+    {
+        return true;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (shuttingDown.load(std::memory_order_relaxed))
+    {
+        _reason = Reasons::ShuttingDown;
+    }
+    else if (_timeout.count() > 0 && now >= _deadline)
+    {
+        _reason = Reasons::TimedOut;
+        Metrics::Add(Metrics::QueryTimeouts, 1);
+    }
+    else if (_clientConnected && now >= _nextClientCheck)
+    {
+        _nextClientCheck = now + ClientCheckInterval;
+
+        if (!_clientConnected())
+        {
+            _reason = Reasons::Disconnected;
+            Metrics::Add(Metrics::QueryDisconnects, 1);
+        }
+    }
+
+    return _reason != Reasons::None;
+}
@@ -0,0 +1,68 @@
+#ifndef QUERYBUDGET_H
+#define QUERYBUDGET_H
+
+#include <chrono>
+#include <functional>
+
+struct sqlite3;
+
+// The time the queries of one request may take, and whether the client still waits for them. A budget
+// is current on the thread that created it until it is destroyed, and the progress handler stops the
+// statements stepped on that thread when it runs out, they return SQLITE_INTERRUPT. Unlike
+// sqlite3_interrupt this leaves other threads using the same connection alone.
+class QueryBudget
+{
+public:
+    // Virtual machine instructions between two checks of the progress handler.
+    static const int ProgressInstructions = 1000;
+
+    // Asking the socket costs a system call, so the client is checked at most this often.
+    static constexpr std::chrono::milliseconds ClientCheckInterval = std::chrono::milliseconds(50);
+
+    enum class Reasons
+    {
+        None,
+        TimedOut,
+        Disconnected,
+        ShuttingDown,
+    };
+
+    // A timeout of 0 has no time limit, without clientConnected the client is not checked.
+    QueryBudget(
+        std::chrono::milliseconds timeout,
+        std::function<bool()> clientConnected);
+
+    ~QueryBudget();
+
+    QueryBudget(QueryBudget const &) = delete;
+    QueryBudget &operator=(QueryBudget const &) = delete;
+
+    // Sets the progress handler of the connection.
+    static void Install(
+        sqlite3 *db);
+
+    // Stops the queries of every budget, for a shutdown that can not wait for them any longer.
+    static void SetShuttingDown(
+        bool shuttingDown);
+
+    // The budget of the request handled on this thread, or nullptr.
+    static QueryBudget *Current();
+
+    // Why the queries were stopped, None while they may go on.
+    Reasons Reason() const;
+
+    std::chrono::milliseconds Timeout() const;
+
+    // Checks the deadline and the client, and returns true when the queries have to stop.
+    bool Exhausted();
+
+private:
+    std::chrono::milliseconds _timeout;
+    std::chrono::steady_clock::time_point _deadline;
+    std::chrono::steady_clock::time_point _nextClientCheck;
+    std::function<bool()> _clientConnected;
+    Reasons _reason;
+    QueryBudget *_previous;
+};
+
+#endif // QUERYBUDGET_H
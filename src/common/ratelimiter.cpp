@@ -0,0 +1,133 @@
+#include "ratelimiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+RateLimiter::RateLimiter(
+    double tokensPerSecond,
+    double burst)
+    : _tokensPerSecond(tokensPerSecond),
+      _burst(std::max(burst, 1.0))
+{}
+
+void RateLimiter::refill(
+    Bucket &bucket,
+    std::chrono::steady_clock::time_point now) const
+{
+    auto elapsed = std::chrono::duration<double>(now - bucket.updated).count();
+    if (elapsed > 0)
+    {
+        bucket.tokens = std::min(_burst, bucket.tokens + elapsed * _tokensPerSecond);
+        bucket.updated = now;
+    }
+}
+
+void RateLimiter::evict(
+    Shard &shard,
+    std::chrono::steady_clock::time_point now) const
+{
+    // A full bucket is the same as a new one, so dropping it forgets nothing
+    for (auto client = shard.clients.begin(); client != shard.clients.end();)
+    {
+        auto full = true;
+        for (auto &bucket : client->second.buckets)
+        {
+            refill(bucket, now);
+            full = full && bucket.tokens >= _burst;
+        }
+
+        client = full ? shard.clients.erase(client) : std::next(client);
+    }
+
+    if (shard.clients.size() < MaxClientsPerShard)
+    {
+        return;
+    }
+
+    // Every client still owes tokens, so the ones seen longest ago are forgotten. Going a quarter below the
+    // limit keeps the next new clients from scanning the shard again.
+    std::vector<std::pair<std::chrono::steady_clock::time_point, std::unordered_map<std::string, Client>::iterator>> byAge;
+    byAge.reserve(shard.clients.size());
+
+    for (auto client = shard.clients.begin(); client != shard.clients.end(); ++client)
+    {
+        byAge.push_back(std::make_pair(client->second.seen, client));
+    }
+
+    auto drop = shard.clients.size() - (MaxClientsPerShard - MaxClientsPerShard / 4);
+
+    std::nth_element(byAge.begin(), byAge.begin() + long(drop), byAge.end(), [](auto const &a, auto const &b) {
+        return a.first < b.first;
+    });
+
+    for (size_t i = 0; i < drop; i++)
+    {
+        shard.clients.erase(byAge[i].second);
+    }
+}
+
+bool RateLimiter::Take(
+    std::string_view client,
+    size_t routeClass,
+    double cost,
+    std::chrono::seconds &retryAfter,
+    std::chrono::steady_clock::time_point now)
+{
+    routeClass = std::min(routeClass, RouteClassCount - 1);
+
+    // A request costing more than a bucket holds would never get in, it waits for a full bucket instead
+    cost = std::min(cost, _burst);
+
+    auto &shard = _shards[std::hash<std::string_view>()(client) % ShardCount];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.clients.find(std::string(client));
+    if (found == shard.clients.end())
+    {
+        if (shard.clients.size() >= MaxClientsPerShard)
+        {
+            evict(shard, now);
+        }
+
+        Client fresh;
+        for (auto &bucket : fresh.buckets)
+        {
+            bucket = Bucket{_burst, now};
+        }
+
+        found = shard.clients.emplace(std::string(client), fresh).first;
+    }
+
+    found->second.seen = now;
+
+    auto &bucket = found->second.buckets[routeClass];
+
+    refill(bucket, now);
+
+    if (bucket.tokens < cost)
+    {
+        auto seconds = _tokensPerSecond > 0 ? std::ceil((cost - bucket.tokens) / _tokensPerSecond) : 60.0;
+        retryAfter = std::chrono::seconds(std::max<long long>(1, (long long)seconds));
+        return false;
+    }
+
+    bucket.tokens -= cost;
+
+    return true;
+}
+
+size_t RateLimiter::ClientCount() const
+{
+    size_t count = 0;
+
+    for (auto &shard : _shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        count += shard.clients.size();
+    }
+
+    return count;
+}
@@ -0,0 +1,77 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Token buckets per client and route class, so one client can not take the server for itself. A
+// request takes tokens by its estimated cost, a full scan more than a point lookup, and every class
+// has its own bucket, so a client's scans do not starve its lookups. The clients are spread over
+// shards by a hash of their address, each with its own lock that is held for a lookup and some
+// arithmetic only.
+class RateLimiter
+{
+public:
+    static const size_t ShardCount = 16;
+    static const size_t RouteClassCount = 2;
+
+    // A shard drops the buckets that filled up again when it holds more clients than this, and when that is not
+    // enough the clients it saw longest ago, until it is a quarter below.
+    static const size_t MaxClientsPerShard = 4096;
+
+    // Tokens per second for every client and route class, burst is how many a bucket holds.
+    RateLimiter(
+        double tokensPerSecond,
+        double burst);
+
+    RateLimiter(RateLimiter const &) = delete;
+    RateLimiter &operator=(RateLimiter const &) = delete;
+
+    // Takes cost tokens from the bucket of the client for the route class. When the bucket has not
+    // enough it takes nothing, returns false and sets retryAfter to when it will have them.
+    bool Take(
+        std::string_view client,
+        size_t routeClass,
+        double cost,
+        std::chrono::seconds &retryAfter,
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    size_t ClientCount() const;
+
+private:
+    struct Bucket
+    {
+        double tokens;
+        std::chrono::steady_clock::time_point updated;
+    };
+
+    struct Client
+    {
+        Bucket buckets[RouteClassCount];
+        std::chrono::steady_clock::time_point seen;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Client> clients;
+    };
+
+    void refill(
+        Bucket &bucket,
+        std::chrono::steady_clock::time_point now) const;
+
+    void evict(
+        Shard &shard,
+        std::chrono::steady_clock::time_point now) const;
+
+    double _tokensPerSecond;
+    double _burst;
+    Shard _shards[ShardCount];
+};
+
+#endif // RATELIMITER_H
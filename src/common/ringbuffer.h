@@ -0,0 +1,120 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free queue for many producers and consumers. Every cell has a sequence number
+// that tells whether it is free for the producer or filled for the consumer at a given position.
+template <class T>
+class RingBuffer
+{
+public:
+    // The capacity is rounded up to a power of two.
+    explicit RingBuffer(
+        size_t capacity)
+        : _enqueuePosition(0),
+          _dequeuePosition(0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+
+        _cells = std::make_unique<Cell[]>(size);
+        _mask = size - 1;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t Capacity() const
+    {
+        return _mask + 1;
+    }
+
+    // Adds a copy of the item, returns false without waiting when the buffer is full.
+    bool TryPush(
+        T const &item)
+    {
+        auto position = _enqueuePosition.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            auto &cell = _cells[position & _mask];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = intptr_t(sequence) - intptr_t(position);
+
+            if (difference == 0)
+            {
+                if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.item = item;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = _enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Takes the oldest item, returns false without waiting when the buffer is empty.
+    bool TryPop(
+        T &item)
+    {
+        auto position = _dequeuePosition.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            auto &cell = _cells[position & _mask];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = intptr_t(sequence) - intptr_t(position + 1);
+
+            if (difference == 0)
+            {
+                if (_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    item = cell.item;
+                    cell.sequence.store(position + _mask + 1, std::memory_order_release);
+
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = _dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask;
+    alignas(64) std::atomic<size_t> _enqueuePosition;
+    alignas(64) std::atomic<size_t> _dequeuePosition;
+};
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,45 @@
+#include "schema.h"
+
+#include <algorithm>
+
+Schema::Schema(
+    std::vector<DataTable> tables,
+    int version)
+    : _tables(std::move(tables)), _version(version)
+{
+    for (size_t i = 0; i < _tables.size(); i++)
+    {
+        _index[_tables[i].Name()].push_back(std::make_pair(_tables[i].Version(), i));
+    }
+
+    for (auto &pair : _index)
+    {
+        std::stable_sort(pair.second.begin(), pair.second.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+    }
+}
+
+DataTable const *Schema::Find(
+    std::string_view name,
+    int version) const
+{
+    auto found = _index.find(name);
+    if (found == _index.end())
+    {
+        return nullptr;
+    }
+
+    auto &versions = found->second;
+
+    if (version == 0)
+    {
+        return &_tables[versions.back().second];
+    }
+
+    auto itr = std::lower_bound(versions.begin(), versions.end(), version, [](auto const &a, int v) { return a.first < v; });
+    if (itr == versions.end() || itr->first != version)
+    {
+        return nullptr;
+    }
+
+    return &_tables[itr->second];
+}
@@ -0,0 +1,45 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include "datatable.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// An immutable set of tables. A request holds on to the schema it started with, so a reload can publish
+// a new one without waiting for requests, and the old one is freed when the last request lets go of it.
+class Schema
+{
+    // The versions of one table name, sorted by version, the last one is the latest
+    typedef std::vector<std::pair<int, size_t>> TableVersions;
+
+    std::vector<DataTable> _tables;
+    std::map<std::string, TableVersions, std::less<>> _index;
+    int _version;
+
+public:
+    Schema(
+        std::vector<DataTable> tables,
+        int version);
+
+    Schema(Schema const &) = delete;
+    Schema &operator=(Schema const &) = delete;
+
+    inline std::vector<DataTable> const &Tables() const { return _tables; }
+
+    // Finds a table by its name and version, version 0 finds the latest version. Returns nullptr when there is no such table.
+    DataTable const *Find(
+        std::string_view name,
+        int version = 0) const;
+
+    // The schema_version of the database the tables were loaded from.
+    inline int Version() const { return _version; }
+};
+
+typedef std::shared_ptr<const Schema> SchemaPtr;
+
+#endif // SCHEMA_H
@@ -0,0 +1,319 @@
+#include "schemasnapshot.h"
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sqlite3/sqlite3.h>
+
+namespace
+{
+    const char Magic[8] = {'A', 'S', 'R', 'S', 'C', 'H', 'M', 'A'};
+    const uint32_t FormatVersion = 3;
+
+    // The snapshot is a cache for this machine, so numbers are stored in native byte order
+    struct Header
+    {
+        char magic[8];
+        uint32_t formatVersion;
+        int32_t schemaVersion;
+        uint32_t tableCount;
+        uint64_t schemaHash;
+        uint32_t bodySize;
+        uint64_t checksum;
+    };
+
+    uint64_t fnv1a(
+        const char *data,
+        size_t size)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }
+
+    class Writer
+    {
+        std::string &_output;
+
+    public:
+        explicit Writer(std::string &output)
+            : _output(output)
+        {}
+
+        template <typename T>
+        void Number(T value)
+        {
+            _output.append(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        void String(std::string const &value)
+        {
+            Number(uint32_t(value.size()));
+            _output.append(value);
+        }
+    };
+
+    // Reads from the mapped snapshot, every read checks it stays inside the file
+    class Reader
+    {
+        const char *_data;
+        size_t _size;
+        size_t _offset = 0;
+
+    public:
+        Reader(const char *data, size_t size)
+            : _data(data), _size(size)
+        {}
+
+        template <typename T>
+        bool Number(T &value)
+        {
+            if (_size - _offset < sizeof(T))
+            {
+                return false;
+            }
+
+            std::memcpy(&value, _data + _offset, sizeof(T));
+            _offset += sizeof(T);
+
+            return true;
+        }
+
+        bool String(std::string &value)
+        {
+            uint32_t length = 0;
+            if (!Number(length) || _size - _offset < length)
+            {
+                return false;
+            }
+
+            value.assign(_data + _offset, length);
+            _offset += length;
+
+            return true;
+        }
+
+        inline bool AtEnd() const { return _offset == _size; }
+    };
+} // namespace
+
+int SchemaSnapshot::SchemaVersion(
+    sqlite3 *db)
+{
+    int version = -1;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA schema_version;", -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        return version;
+    }
+
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        version = sqlite3_column_int(stmt, 0);
+    }
+
+    sqlite3_finalize(stmt);
+
+    return version;
+}
+
+uint64_t SchemaSnapshot::SchemaHash(
+    sqlite3 *db)
+{
+    std::string schema;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT type, name, tbl_name, sql FROM sqlite_master ORDER BY type, name;", -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        return 0;
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            auto text = reinterpret_cast<const char *>(sqlite3_column_text(stmt, i));
+
+            // The separator keeps ("ab", "c") and ("a", "bc") apart
+            schema += text != nullptr ? text : "";
+            schema += '\0';
+        }
+    }
+
+    sqlite3_finalize(stmt);
+
+    return fnv1a(schema.data(), schema.size());
+}
+
+bool SchemaSnapshot::Save(
+    std::string const &path,
+    int schemaVersion,
+    uint64_t schemaHash,
+    std::vector<DataTable> const &tables)
+{
+    std::string body;
+    Writer writer(body);
+
+    for (auto &table : tables)
+    {
+        writer.String(table.RawName());
+        writer.String(table.Name());
+        writer.Number(int32_t(table.Version()));
+        writer.String(table.PrimaryKey());
+        writer.Number(uint32_t(table.Columns().size()));
+
+        for (auto &column : table.Columns())
+        {
+            writer.String(column.first);
+            writer.Number(uint8_t(column.second));
+        }
+
+        writer.Number(uint32_t(table.Relations().size()));
+
+        for (auto &relation : table.Relations())
+        {
+            writer.String(relation.name);
+            writer.String(relation.table);
+            writer.String(relation.column);
+            writer.String(relation.relatedColumn);
+            writer.Number(uint8_t(relation.many ? 1 : 0));
+        }
+    }
+
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.formatVersion = FormatVersion;
+    header.schemaVersion = schemaVersion;
+    header.tableCount = uint32_t(tables.size());
+    header.schemaHash = schemaHash;
+    header.bodySize = uint32_t(body.size());
+    header.checksum = fnv1a(body.data(), body.size());
+
+    auto temporaryPath = path + ".tmp";
+
+    auto file = std::fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    auto written = std::fwrite(&header, sizeof(header), 1, file) == 1 && std::fwrite(body.data(), 1, body.size(), file) == body.size();
+
+    if (std::fclose(file) != 0 || !written)
+    {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporaryPath, path, ec);
+
+    return !ec;
+}
+
+bool SchemaSnapshot::Load(
+    std::string const &path,
+    int schemaVersion,
+    uint64_t schemaHash,
+    std::vector<DataTable> &tables)
+{
+    MappedFile file;
+    if (!file.Open(path) || file.Size() < sizeof(Header))
+    {
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+        header.formatVersion != FormatVersion ||
+        header.schemaVersion != schemaVersion ||
+        header.schemaHash != schemaHash ||
+        header.bodySize != file.Size() - sizeof(Header))
+    {
+        return false;
+    }
+
+    auto body = file.Data() + sizeof(Header);
+
+    if (fnv1a(body, header.bodySize) != header.checksum)
+    {
+        return false;
+    }
+
+    Reader reader(body, header.bodySize);
+    std::vector<DataTable> result;
+    result.reserve(header.tableCount);
+
+    for (uint32_t i = 0; i < header.tableCount; i++)
+    {
+        std::string rawName, name, primaryKey;
+        int32_t version = 0;
+        uint32_t columnCount = 0;
+
+        if (!reader.String(rawName) || !reader.String(name) || !reader.Number(version) || !reader.String(primaryKey) || !reader.Number(columnCount))
+        {
+            return false;
+        }
+
+        DataTable table(rawName, name, version);
+        if (!primaryKey.empty())
+        {
+            table.PrimaryKey(primaryKey.c_str());
+        }
+
+        for (uint32_t c = 0; c < columnCount; c++)
+        {
+            std::string column;
+            uint8_t type = 0;
+
+            if (!reader.String(column) || !reader.Number(type) || type > uint8_t(ColumnTypes::Blob))
+            {
+                return false;
+            }
+
+            table.AddColumn(column, ColumnTypes(type));
+        }
+
+        uint32_t relationCount = 0;
+        if (!reader.Number(relationCount))
+        {
+            return false;
+        }
+
+        for (uint32_t r = 0; r < relationCount; r++)
+        {
+            Relation relation;
+            uint8_t many = 0;
+
+            if (!reader.String(relation.name) || !reader.String(relation.table) || !reader.String(relation.column) || !reader.String(relation.relatedColumn) || !reader.Number(many))
+            {
+                return false;
+            }
+
+            relation.many = many != 0;
+            table.AddRelation(relation, 0);
+        }
+
+        result.push_back(std::move(table));
+    }
+
+    if (!reader.AtEnd())
+    {
+        return false;
+    }
+
+    tables = std::move(result);
+
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef SCHEMASNAPSHOT_H
+#define SCHEMASNAPSHOT_H
+
+#include "datatable.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+
+// A binary copy of the loaded tables, tagged with the schema_version and a hash of the schema of the
+// database it was loaded from, so a restart can skip introspection as long as the schema did not change.
+// The version alone can match by chance when the snapshot is pointed at another database.
+class SchemaSnapshot
+{
+public:
+    static int SchemaVersion(
+        sqlite3 *db);
+
+    // Hashes the sql of everything in sqlite_master, which is one read and far less than loading the tables.
+    static uint64_t SchemaHash(
+        sqlite3 *db);
+
+    // Writes to a temporary file first and moves it in place, so readers never see half a snapshot.
+    static bool Save(
+        std::string const &path,
+        int schemaVersion,
+        uint64_t schemaHash,
+        std::vector<DataTable> const &tables);
+
+    // Returns false when the snapshot is missing, damaged or for another schema version or schema.
+    static bool Load(
+        std::string const &path,
+        int schemaVersion,
+        uint64_t schemaHash,
+        std::vector<DataTable> &tables);
+};
+
+#endif // SCHEMASNAPSHOT_H
@@ -0,0 +1,82 @@
+#include "schemawatcher.h"
+#include "schemasnapshot.h"
+#include "sqliteconnection.h"
+#include "sqlitestats.h"
+
+#include <sqlite3/sqlite3.h>
+
+SchemaWatcher::SchemaWatcher()
+    : _stopping(false)
+{}
+
+SchemaWatcher::~SchemaWatcher()
+{
+    Stop();
+}
+
+bool SchemaWatcher::Start(
+    std::string const &path,
+    SqliteSettings const &settings,
+    int schemaVersion,
+    std::chrono::milliseconds interval,
+    ChangedHandler handler)
+{
+    if (_thread.joinable())
+    {
+        return false;
+    }
+
+    auto db = OpenConnection(path, settings);
+    if (db == nullptr)
+    {
+        return false;
+    }
+
+    SqliteStats::Register("schema watcher", db);
+
+    _stopping = false;
+    _handler = std::move(handler);
+    _thread = std::thread(&SchemaWatcher::run, this, db, schemaVersion, interval);
+
+    return true;
+}
+
+void SchemaWatcher::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+
+    _stop.notify_all();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+void SchemaWatcher::run(
+    sqlite3 *db,
+    int schemaVersion,
+    std::chrono::milliseconds interval)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (!_stop.wait_for(lock, interval, [this]() { return _stopping; }))
+    {
+        lock.unlock();
+
+        auto version = SchemaSnapshot::SchemaVersion(db);
+        if (version >= 0 && version != schemaVersion)
+        {
+            schemaVersion = version;
+            _handler(db, version);
+        }
+
+        lock.lock();
+    }
+
+    SqliteStats::Unregister(db);
+    sqlite3_close(db);
+}
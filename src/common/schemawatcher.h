@@ -0,0 +1,46 @@
+#ifndef SCHEMAWATCHER_H
+#define SCHEMAWATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct SqliteSettings;
+struct sqlite3;
+
+// Polls PRAGMA schema_version on its own connection and calls the handler on the watcher thread
+// when the version changed, with that connection so the handler can load the new schema.
+class SchemaWatcher
+{
+public:
+    typedef std::function<void(sqlite3 *db, int schemaVersion)> ChangedHandler;
+
+    SchemaWatcher();
+    ~SchemaWatcher();
+
+    bool Start(
+        std::string const &path,
+        SqliteSettings const &settings,
+        int schemaVersion,
+        std::chrono::milliseconds interval,
+        ChangedHandler handler);
+
+    void Stop();
+
+private:
+    void run(
+        sqlite3 *db,
+        int schemaVersion,
+        std::chrono::milliseconds interval);
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _stop;
+    bool _stopping;
+    ChangedHandler _handler;
+};
+
+#endif // SCHEMAWATCHER_H
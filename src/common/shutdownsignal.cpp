@@ -0,0 +1,70 @@
+#include "shutdownsignal.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace
+{
+    std::atomic<ShutdownSignal::Handler> installedHandler(nullptr);
+    std::atomic<bool> requested(false);
+    std::atomic<bool> finished(false);
+
+    void requestShutdown()
+    {
+        auto handler = installedHandler.load();
+        if (handler != nullptr && !requested.exchange(true))
+        {
+            handler();
+        }
+    }
+
+    void onSignal(
+        int)
+    {
+        requestShutdown();
+    }
+
+#ifdef _WIN32
+    BOOL WINAPI onConsoleControl(
+        DWORD type)
+    {
+        requestShutdown();
+
+        // Windows ends the process when the handler returns for these, so it waits for the drain, but only
+        // until windows gives up on the handler and ends the process anyway
+        if (type == CTRL_CLOSE_EVENT || type == CTRL_LOGOFF_EVENT || type == CTRL_SHUTDOWN_EVENT)
+        {
+            while (!finished.load())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+        }
+
+        return TRUE;
+    }
+#endif
+} // namespace
+
+void ShutdownSignal::Install(
+    Handler handler)
+{
+    installedHandler = handler;
+
+#ifdef _WIN32
+    SetConsoleCtrlHandler(onConsoleControl, TRUE);
+#else
+    std::signal(SIGTERM, onSignal);
+    std::signal(SIGINT, onSignal);
+#endif
+}
+
+void ShutdownSignal::Finished()
+{
+    finished = true;
+}
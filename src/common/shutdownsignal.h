@@ -0,0 +1,21 @@
+#ifndef SHUTDOWNSIGNAL_H
+#define SHUTDOWNSIGNAL_H
+
+// Calls a handler once when the process is asked to stop: SIGTERM or SIGINT, and on windows also
+// ctrl-c, closing the console, logoff and system shutdown. On posix the handler runs inside a signal
+// handler, so it may only touch lock-free atomics and make async-signal-safe calls, like closing a socket.
+class ShutdownSignal
+{
+public:
+    typedef void (*Handler)();
+
+    static void Install(
+        Handler handler);
+
+    // Tells a windows console handler that waits for the process to finish that it may return. Windows only
+    // waits so long for the handler of a closed console, a logoff or a system shutdown, about 5 seconds and
+    // up to 20 on shutdown, and then ends the process whether it finished or not. A longer drain is cut short.
+    static void Finished();
+};
+
+#endif // SHUTDOWNSIGNAL_H
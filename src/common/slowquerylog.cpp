@@ -0,0 +1,171 @@
+#include "slowquerylog.h"
+#include "jsonwriter.h"
+#include "metrics.h"
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <sqlite3/sqlite3.h>
+
+namespace
+{
+    struct Log
+    {
+        std::mutex mutex;
+        std::FILE *file = nullptr;
+        std::atomic<bool> open = {false};
+        std::chrono::microseconds threshold;
+    };
+
+    Log &log()
+    {
+        static Log instance;
+
+        return instance;
+    }
+
+    // Runs EXPLAIN QUERY PLAN on the sql of the statement, parameters are left unbound which does not change the plan
+    void writePlan(
+        sqlite3_stmt *stmt,
+        JsonWriter &writer)
+    {
+        std::string sql = "EXPLAIN QUERY PLAN ";
+        sql += sqlite3_sql(stmt);
+
+        sqlite3_stmt *plan = nullptr;
+        if (sqlite3_prepare_v2(sqlite3_db_handle(stmt), sql.c_str(), int(sql.length()), &plan, nullptr) != SQLITE_OK)
+        {
+            writer.Null();
+            return;
+        }
+
+        writer.BeginArray();
+
+        while (sqlite3_step(plan) == SQLITE_ROW)
+        {
+            auto detail = reinterpret_cast<const char *>(sqlite3_column_text(plan, 3));
+
+            writer.String(detail != nullptr ? detail : "");
+        }
+
+        writer.EndArray();
+
+        sqlite3_finalize(plan);
+    }
+} // namespace
+
+bool SlowQueryLog::Open(
+    std::string const &path,
+    std::chrono::microseconds threshold)
+{
+    auto &l = log();
+    std::lock_guard<std::mutex> lock(l.mutex);
+
+    if (l.open)
+    {
+        return false;
+    }
+
+    l.file = path.empty() ? stderr : std::fopen(path.c_str(), "ab");
+    if (l.file == nullptr)
+    {
+        return false;
+    }
+
+    l.threshold = threshold;
+    l.open = true;
+
+    return true;
+}
+
+void SlowQueryLog::Close()
+{
+    auto &l = log();
+    std::lock_guard<std::mutex> lock(l.mutex);
+
+    if (!l.open)
+    {
+        return;
+    }
+
+    l.open = false;
+
+    if (l.file != stderr)
+    {
+        std::fclose(l.file);
+    }
+    l.file = nullptr;
+}
+
+bool SlowQueryLog::IsOpen()
+{
+    return log().open.load(std::memory_order_relaxed);
+}
+
+void SlowQueryLog::Finish(
+    sqlite3_stmt *stmt,
+    std::chrono::microseconds elapsed,
+    size_t rows)
+{
+    // The counters add up over every run of a statement until they are reset, so reading resets them and a
+    // cached statement reports what this run did
+    auto fullscanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    auto sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+    auto autoindexes = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+
+    Metrics::Add(Metrics::SqliteFullscanSteps, size_t(fullscanSteps));
+    Metrics::Add(Metrics::SqliteSorts, size_t(sorts));
+    Metrics::Add(Metrics::SqliteAutoindexes, size_t(autoindexes));
+
+    auto &l = log();
+
+    if (!IsOpen() || elapsed < l.threshold)
+    {
+        return;
+    }
+
+    Metrics::Add(Metrics::SlowQueries, 1);
+
+    std::pmr::string output;
+    JsonWriter writer(output);
+
+    auto expandedSql = sqlite3_expanded_sql(stmt);
+
+    writer.BeginObject();
+    writer.Key("duration_us");
+    writer.Integer(elapsed.count());
+    writer.Key("rows");
+    writer.Integer(static_cast<long long>(rows));
+    writer.Key("sql");
+    writer.String(sqlite3_sql(stmt));
+    writer.Key("expanded_sql");
+    if (expandedSql != nullptr)
+    {
+        writer.String(expandedSql);
+    }
+    else
+    {
+        writer.Null();
+    }
+    writer.Key("fullscan_steps");
+    writer.Integer(fullscanSteps);
+    writer.Key("sorts");
+    writer.Integer(sorts);
+    writer.Key("autoindexes");
+    writer.Integer(autoindexes);
+    writer.Key("plan");
+    writePlan(stmt, writer);
+    writer.EndObject();
+
+    output += '\n';
+
+    sqlite3_free(expandedSql);
+
+    std::lock_guard<std::mutex> lock(l.mutex);
+
+    if (l.file != nullptr)
+    {
+        std::fwrite(output.data(), 1, output.size(), l.file);
+        std::fflush(l.file);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef SLOWQUERYLOG_H
+#define SLOWQUERYLOG_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+struct sqlite3_stmt;
+
+// Logs statements that ran longer than a threshold as json lines, with the sql, the bound
+// parameters, the row count, the statement counters and the output of EXPLAIN QUERY PLAN.
+// Slow statements are rare, so they are written synchronously on the thread that ran them.
+class SlowQueryLog
+{
+public:
+    // Opens the log, an empty path logs to stderr.
+    static bool Open(
+        std::string const &path,
+        std::chrono::microseconds threshold);
+
+    static void Close();
+
+    static bool IsOpen();
+
+    // Records the statement counters in the metrics, and logs the statement when it took at least the threshold.
+    // Call this once per run, when stepping is done and before the statement is reset or finalized, it resets
+    // the counters for the next run.
+    static void Finish(
+        sqlite3_stmt *stmt,
+        std::chrono::microseconds elapsed,
+        size_t rows);
+};
+
+#endif // SLOWQUERYLOG_H
@@ -0,0 +1,218 @@
+#include "sqliteconnection.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fmt/format.h>
+#include <initializer_list>
+#include <sqlite3/sqlite3.h>
+
+namespace
+{
+    std::string upper(
+        std::string value)
+    {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return char(std::toupper(c)); });
+
+        return value;
+    }
+
+    // Only accepts one of the given values, these end up in a PRAGMA statement
+    std::optional<std::string> oneOf(
+        std::string const &value,
+        std::initializer_list<const char *> allowed)
+    {
+        auto v = upper(value);
+
+        for (auto a : allowed)
+        {
+            if (v == a)
+            {
+                return v;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    template <typename T>
+    std::optional<T> number(
+        std::string const &value)
+    {
+        T result = 0;
+
+        auto end = value.data() + value.size();
+        auto parsed = std::from_chars(value.data(), end, result);
+        if (parsed.ec != std::errc() || parsed.ptr != end)
+        {
+            return std::nullopt;
+        }
+
+        return result;
+    }
+
+    std::string pragmaValue(
+        sqlite3 *db,
+        const char *name)
+    {
+        std::string result;
+        std::string sql = fmt::format("PRAGMA {0};", name);
+
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), int(sql.length()), &stmt, nullptr) != SQLITE_OK)
+        {
+            return result;
+        }
+
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+        {
+            result = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        }
+
+        sqlite3_finalize(stmt);
+
+        return result;
+    }
+} // namespace
+
+bool SqliteSettings::Profile(
+    std::string const &name)
+{
+    if (name == "read-heavy")
+    {
+        journalMode = "WAL";
+        synchronous = "NORMAL";
+        cacheSize = -64 * 1024;          // 64MB
+        mmapSize = 1024LL * 1024 * 1024; // 1GB
+        tempStore = "MEMORY";
+        busyTimeout = 5000;
+
+        return true;
+    }
+
+    if (name == "write-heavy")
+    {
+        journalMode = "WAL";
+        synchronous = "NORMAL";
+        cacheSize = -16 * 1024; // 16MB
+        mmapSize = 0;
+        tempStore = "MEMORY";
+        busyTimeout = 10000;
+
+        return true;
+    }
+
+    return name == "custom";
+}
+
+bool SqliteSettings::Set(
+    std::string const &name,
+    std::string const &value)
+{
+    if (name == "journal-mode")
+    {
+        journalMode = oneOf(value, {"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"});
+        return journalMode.has_value();
+    }
+
+    if (name == "synchronous")
+    {
+        synchronous = oneOf(value, {"OFF", "NORMAL", "FULL", "EXTRA", "0", "1", "2", "3"});
+        return synchronous.has_value();
+    }
+
+    if (name == "cache-size")
+    {
+        cacheSize = number<long long>(value);
+        return cacheSize.has_value();
+    }
+
+    if (name == "mmap-size")
+    {
+        mmapSize = number<long long>(value);
+        return mmapSize.has_value();
+    }
+
+    if (name == "temp-store")
+    {
+        tempStore = oneOf(value, {"DEFAULT", "FILE", "MEMORY", "0", "1", "2"});
+        return tempStore.has_value();
+    }
+
+    if (name == "busy-timeout")
+    {
+        busyTimeout = number<int>(value);
+        return busyTimeout.has_value();
+    }
+
+    return false;
+}
+
+sqlite3 *OpenConnection(
+    std::string const &path,
+    SqliteSettings const &settings)
+{
+    sqlite3 *db = nullptr;
+
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        return nullptr;
+    }
+
+    // The journal mode goes first, it cannot be changed while other settings hold a transaction open
+    std::string sql;
+
+    if (settings.journalMode)
+    {
+        sql += fmt::format("PRAGMA journal_mode={0};", *settings.journalMode);
+    }
+    if (settings.synchronous)
+    {
+        sql += fmt::format("PRAGMA synchronous={0};", *settings.synchronous);
+    }
+    if (settings.cacheSize)
+    {
+        sql += fmt::format("PRAGMA cache_size={0};", *settings.cacheSize);
+    }
+    if (settings.mmapSize)
+    {
+        sql += fmt::format("PRAGMA mmap_size={0};", *settings.mmapSize);
+    }
+    if (settings.tempStore)
+    {
+        sql += fmt::format("PRAGMA temp_store={0};", *settings.tempStore);
+    }
+
+    if (!sql.empty())
+    {
+        sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    }
+
+    if (settings.busyTimeout)
+    {
+        sqlite3_busy_timeout(db, *settings.busyTimeout);
+    }
+
+    return db;
+}
+
+std::string DescribeConnection(
+    sqlite3 *db)
+{
+    std::string result;
+
+    for (auto name : {"journal_mode", "synchronous", "cache_size", "mmap_size", "temp_store", "busy_timeout"})
+    {
+        if (!result.empty())
+        {
+            result += ' ';
+        }
+
+        result += name;
+        result += '=';
+        result += pragmaValue(db, name);
+    }
+
+    return result;
+}
@@ -0,0 +1,38 @@
+#ifndef SQLITECONNECTION_H
+#define SQLITECONNECTION_H
+
+#include <optional>
+#include <string>
+
+struct sqlite3;
+
+// The PRAGMA settings applied to every connection asr opens, settings that are not set keep the SQLite default.
+struct SqliteSettings
+{
+    std::optional<std::string> journalMode;
+    std::optional<std::string> synchronous;
+    std::optional<long long> cacheSize;
+    std::optional<long long> mmapSize;
+    std::optional<std::string> tempStore;
+    std::optional<int> busyTimeout;
+
+    // Applies a profile: "read-heavy", "write-heavy" or "custom" (which sets nothing).
+    bool Profile(
+        std::string const &name);
+
+    // Sets one setting by its command line name (like "journal-mode"), returns false for unknown names or invalid values.
+    bool Set(
+        std::string const &name,
+        std::string const &value);
+};
+
+// Opens a connection and applies the settings, returns nullptr when the database could not be opened.
+sqlite3 *OpenConnection(
+    std::string const &path,
+    SqliteSettings const &settings);
+
+// Reads back the settings in effect on a connection, formatted as "name=value" pairs on one line.
+std::string DescribeConnection(
+    sqlite3 *db);
+
+#endif // SQLITECONNECTION_H
@@ -0,0 +1,171 @@
+#include "sqlitestats.h"
+#include "jsonwriter.h"
+
+#include <chrono>
+#include <iterator>
+#include <mutex>
+#include <sqlite3/sqlite3.h>
+#include <vector>
+
+namespace
+{
+    struct StatusInfo
+    {
+        int op;
+        const char *name;
+        bool countInHighwater = false; // the lookaside hit and miss counts are only reported as highwater
+    };
+
+    const StatusInfo connectionInfos[] = {
+        {SQLITE_DBSTATUS_LOOKASIDE_USED, "lookaside_used"},
+        {SQLITE_DBSTATUS_LOOKASIDE_HIT, "lookaside_hit", true},
+        {SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, "lookaside_miss_size", true},
+        {SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, "lookaside_miss_full", true},
+        {SQLITE_DBSTATUS_CACHE_USED, "cache_used_bytes"},
+        {SQLITE_DBSTATUS_CACHE_USED_SHARED, "cache_used_shared_bytes"},
+        {SQLITE_DBSTATUS_CACHE_HIT, "cache_hit"},
+        {SQLITE_DBSTATUS_CACHE_MISS, "cache_miss"},
+        {SQLITE_DBSTATUS_CACHE_WRITE, "cache_write"},
+        {SQLITE_DBSTATUS_SCHEMA_USED, "schema_used_bytes"},
+        {SQLITE_DBSTATUS_STMT_USED, "stmt_used_bytes"},
+        {SQLITE_DBSTATUS_DEFERRED_FKS, "deferred_fks"},
+    };
+
+    const StatusInfo globalInfos[] = {
+        {SQLITE_STATUS_MEMORY_USED, "memory_used_bytes"},
+        {SQLITE_STATUS_MALLOC_SIZE, "malloc_size_bytes"},
+        {SQLITE_STATUS_MALLOC_COUNT, "malloc_count"},
+        {SQLITE_STATUS_PAGECACHE_USED, "pagecache_used"},
+        {SQLITE_STATUS_PAGECACHE_OVERFLOW, "pagecache_overflow_bytes"},
+        {SQLITE_STATUS_PAGECACHE_SIZE, "pagecache_size_bytes"},
+        {SQLITE_STATUS_PARSER_STACK, "parser_stack"},
+    };
+
+    const size_t ConnectionInfoCount = std::size(connectionInfos);
+    const size_t GlobalInfoCount = std::size(globalInfos);
+
+    struct Connection
+    {
+        std::string name;
+        sqlite3 *db;
+        long long previous[ConnectionInfoCount] = {};
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<Connection> connections;
+        long long previousGlobal[GlobalInfoCount] = {};
+        std::chrono::steady_clock::time_point previousWrite = std::chrono::steady_clock::now();
+    };
+
+    Registry &registry()
+    {
+        static Registry instance;
+
+        return instance;
+    }
+
+    void writeValue(
+        JsonWriter &writer,
+        const char *name,
+        long long current,
+        long long highwater,
+        long long &previous)
+    {
+        writer.Key(name);
+        writer.BeginObject();
+        writer.Key("current");
+        writer.Integer(current);
+        writer.Key("highwater");
+        writer.Integer(highwater);
+        writer.Key("delta");
+        writer.Integer(current - previous);
+        writer.EndObject();
+
+        previous = current;
+    }
+} // namespace
+
+void SqliteStats::Register(
+    std::string const &name,
+    sqlite3 *db)
+{
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    r.connections.push_back(Connection{name, db});
+}
+
+void SqliteStats::Unregister(
+    sqlite3 *db)
+{
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    for (auto itr = r.connections.begin(); itr != r.connections.end(); ++itr)
+    {
+        if (itr->db == db)
+        {
+            r.connections.erase(itr);
+            return;
+        }
+    }
+}
+
+void SqliteStats::Write(
+    JsonWriter &writer)
+{
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    auto now = std::chrono::steady_clock::now();
+
+    writer.BeginObject();
+    writer.Key("interval_seconds");
+    writer.Real(std::chrono::duration<double>(now - r.previousWrite).count());
+    r.previousWrite = now;
+
+    writer.Key("connections");
+    writer.BeginArray();
+
+    for (auto &connection : r.connections)
+    {
+        writer.BeginObject();
+        writer.Key("name");
+        writer.String(connection.name);
+
+        for (size_t i = 0; i < ConnectionInfoCount; i++)
+        {
+            int current = 0, highwater = 0;
+
+            sqlite3_db_status(connection.db, connectionInfos[i].op, &current, &highwater, 0);
+
+            if (connectionInfos[i].countInHighwater)
+            {
+                current = highwater;
+            }
+
+            writeValue(writer, connectionInfos[i].name, current, highwater, connection.previous[i]);
+        }
+
+        writer.EndObject();
+    }
+
+    writer.EndArray();
+
+    writer.Key("global");
+    writer.BeginObject();
+
+    for (size_t i = 0; i < GlobalInfoCount; i++)
+    {
+        sqlite3_int64 current = 0, highwater = 0;
+
+        sqlite3_status64(globalInfos[i].op, &current, &highwater, 0);
+
+        writeValue(writer, globalInfos[i].name, current, highwater, r.previousGlobal[i]);
+    }
+
+    writer.EndObject();
+    writer.EndObject();
+}
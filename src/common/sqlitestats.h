@@ -0,0 +1,26 @@
+#ifndef SQLITESTATS_H
+#define SQLITESTATS_H
+
+#include <string>
+
+class JsonWriter;
+struct sqlite3;
+
+// Reports sqlite3_db_status of every registered connection and the global sqlite3_status,
+// with the change of every value since the previous report.
+class SqliteStats
+{
+public:
+    // Registers a connection under a name, connections must be unregistered before they are closed.
+    static void Register(
+        std::string const &name,
+        sqlite3 *db);
+
+    static void Unregister(
+        sqlite3 *db);
+
+    static void Write(
+        JsonWriter &writer);
+};
+
+#endif // SQLITESTATS_H
@@ -0,0 +1,19 @@
+#include "sqlquote.h"
+
+std::string SqlQuote(
+    std::string_view name,
+    char mark)
+{
+    std::string quoted(1, mark);
+    for (auto c : name)
+    {
+        quoted += c;
+        if (c == mark)
+        {
+            quoted += mark;
+        }
+    }
+    quoted += mark;
+
+    return quoted;
+}
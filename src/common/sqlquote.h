@@ -0,0 +1,12 @@
+#ifndef SQLQUOTE_H
+#define SQLQUOTE_H
+
+#include <string>
+#include <string_view>
+
+// Quotes an identifier for sql, or a string literal with mark '\'', doubling the marks inside.
+std::string SqlQuote(
+    std::string_view name,
+    char mark = '"');
+
+#endif // SQLQUOTE_H
@@ -0,0 +1,83 @@
+#include "statementcache.h"
+
+#include <sqlite3/sqlite3.h>
+
+StatementCache::StatementCache(
+    sqlite3 *db)
+    : _db(db)
+{}
+
+StatementCache::~StatementCache()
+{
+    Clear();
+}
+
+sqlite3_stmt *StatementCache::Acquire(
+    std::string const &sql)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _idle.find(sql);
+        if (found != _idle.end())
+        {
+            auto stmt = found->second;
+            _idle.erase(found);
+
+            return stmt;
+        }
+    }
+
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v3(_db, sql.c_str(), int(sql.length()), SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+    {
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+
+    return stmt;
+}
+
+void StatementCache::Release(
+    sqlite3_stmt *stmt)
+{
+    if (stmt == nullptr)
+    {
+        return;
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    // The counters add up across resets, the next user starts from zero
+    sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+    sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_idle.size() >= MaxIdleStatements)
+    {
+        lock.unlock();
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    _idle.emplace(sqlite3_sql(stmt), stmt);
+}
+
+void StatementCache::Clear()
+{
+    decltype(_idle) idle;
+
+    // Finalized without the lock, a writer holds the mutex of the connection while it takes this one
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        idle.swap(_idle);
+    }
+
+    for (auto &pair : idle)
+    {
+        sqlite3_finalize(pair.second);
+    }
+}
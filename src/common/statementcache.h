@@ -0,0 +1,43 @@
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Keeps prepared statements of one connection around by their sql. A statement is taken out of the
+// cache while it is used, so two threads never step the same statement.
+class StatementCache
+{
+public:
+    static const size_t MaxIdleStatements = 256;
+
+    explicit StatementCache(
+        sqlite3 *db);
+
+    ~StatementCache();
+
+    StatementCache(StatementCache const &) = delete;
+    StatementCache &operator=(StatementCache const &) = delete;
+
+    // Takes a statement for the sql out of the cache, or prepares a new one. Returns nullptr when the sql does not prepare.
+    sqlite3_stmt *Acquire(
+        std::string const &sql);
+
+    // Resets the statement, its bindings and the counters reported by sqlite3_stmt_status, and puts it back for
+    // the next use of the same sql.
+    void Release(
+        sqlite3_stmt *stmt);
+
+    void Clear();
+
+private:
+    sqlite3 *_db;
+    std::mutex _mutex;
+    std::multimap<std::string, sqlite3_stmt *, std::less<>> _idle;
+};
+
+#endif // STATEMENTCACHE_H
@@ -0,0 +1,165 @@
+#include "tracing.h"
+#include "jsonwriter.h"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct Span
+    {
+        char name[48];
+        long long start;
+        long long duration;
+    };
+
+    struct ThreadSpans
+    {
+        std::mutex mutex;
+        std::vector<Span> spans;
+        int threadId;
+        size_t dropped = 0;
+    };
+
+    struct Registry
+    {
+        std::atomic<bool> enabled = {false};
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadSpans>> threads;
+    };
+
+    Registry &registry()
+    {
+        static Registry instance;
+
+        return instance;
+    }
+
+    ThreadSpans &threadSpans()
+    {
+        thread_local ThreadSpans *spans = nullptr;
+
+        if (spans == nullptr)
+        {
+            auto &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+
+            r.threads.push_back(std::make_unique<ThreadSpans>());
+            spans = r.threads.back().get();
+            spans->threadId = int(r.threads.size());
+            spans->spans.reserve(1024);
+        }
+
+        return *spans;
+    }
+
+    long long microseconds(
+        std::chrono::steady_clock::time_point time)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+    }
+} // namespace
+
+void Tracing::Enable()
+{
+    registry().enabled.store(true);
+}
+
+bool Tracing::IsEnabled()
+{
+    return registry().enabled.load(std::memory_order_relaxed);
+}
+
+void Tracing::AddSpan(
+    std::string_view name,
+    std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end)
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    auto &thread = threadSpans();
+    std::lock_guard<std::mutex> lock(thread.mutex);
+
+    if (thread.spans.size() >= MaxSpansPerThread)
+    {
+        thread.dropped++;
+        return;
+    }
+
+    Span span;
+
+    auto length = name.size() < sizeof(span.name) - 1 ? name.size() : sizeof(span.name) - 1;
+    name.copy(span.name, length);
+    span.name[length] = '\0';
+    span.start = microseconds(start);
+    span.duration = microseconds(end) - span.start;
+
+    thread.spans.push_back(span);
+}
+
+bool Tracing::WriteFile(
+    std::string const &path)
+{
+    auto file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    std::pmr::string output;
+    JsonWriter writer(output);
+
+    writer.BeginObject();
+    writer.Key("displayTimeUnit");
+    writer.String("ms");
+    writer.Key("traceEvents");
+    writer.BeginArray();
+
+    auto &r = registry();
+    std::lock_guard<std::mutex> registryLock(r.mutex);
+
+    for (auto &thread : r.threads)
+    {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+
+        for (auto &span : thread->spans)
+        {
+            writer.BeginObject();
+            writer.Key("name");
+            writer.String(span.name);
+            writer.Key("cat");
+            writer.String("asr");
+            writer.Key("ph");
+            writer.String("X");
+            writer.Key("ts");
+            writer.Integer(span.start);
+            writer.Key("dur");
+            writer.Integer(span.duration);
+            writer.Key("pid");
+            writer.Integer(1);
+            writer.Key("tid");
+            writer.Integer(thread->threadId);
+            writer.EndObject();
+
+            // Keep the buffer small for traces with millions of spans
+            if (output.size() > 1024 * 1024)
+            {
+                std::fwrite(output.data(), 1, output.size(), file);
+                output.clear();
+            }
+        }
+    }
+
+    writer.EndArray();
+    writer.EndObject();
+
+    std::fwrite(output.data(), 1, output.size(), file);
+
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,29 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <chrono>
+#include <string>
+#include <string_view>
+
+// Collects spans in a buffer per thread and writes them in the Chrome trace event format,
+// which can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+class Tracing
+{
+public:
+    // Spans recorded per thread after this many are dropped, to bound memory when tracing for a long time.
+    static const size_t MaxSpansPerThread = 1 << 20;
+
+    static void Enable();
+
+    static bool IsEnabled();
+
+    static void AddSpan(
+        std::string_view name,
+        std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end);
+
+    static bool WriteFile(
+        std::string const &path);
+};
+
+#endif // TRACING_H
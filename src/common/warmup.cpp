@@ -0,0 +1,313 @@
+#include "warmup.h"
+#include "jsonwriter.h"
+#include "sqlquote.h"
+#include "sqliteconnection.h"
+#include "sqlitestats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fmt/format.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sqlite3/sqlite3.h>
+#include <thread>
+
+namespace
+{
+    struct State
+    {
+        std::thread worker;
+        std::atomic<bool> started = {false};
+        std::atomic<bool> finished = {false};
+        std::atomic<bool> stopping = {false};
+        std::chrono::steady_clock::time_point deadline;
+        std::atomic<size_t> objectsDone = {0};
+        std::atomic<size_t> objectsTotal = {0};
+        std::atomic<uint64_t> rowsRead = {0};
+    };
+
+    State &state()
+    {
+        static State instance;
+
+        return instance;
+    }
+
+    struct AccessCounters
+    {
+        std::mutex mutex;
+        std::map<std::string, std::unique_ptr<std::atomic<uint64_t>>> counters;
+    };
+
+    AccessCounters &accessCounters()
+    {
+        static AccessCounters instance;
+
+        return instance;
+    }
+
+    bool pastDeadline(
+        State &s)
+    {
+        return s.stopping || std::chrono::steady_clock::now() >= s.deadline;
+    }
+
+    // Steps through all rows, the pages are read on the way
+    void readAll(
+        sqlite3 *db,
+        std::string const &sql,
+        State &s)
+    {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), int(sql.length()), &stmt, nullptr) != SQLITE_OK)
+        {
+            return;
+        }
+
+        uint64_t rows = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            if (++rows % 4096 == 0 && pastDeadline(s))
+            {
+                break;
+            }
+        }
+
+        s.rowsRead += rows;
+
+        sqlite3_finalize(stmt);
+    }
+
+    // Returns the first column of each index on the table, a covering scan over it reads the whole index
+    std::vector<std::pair<std::string, std::string>> indexes(
+        sqlite3 *db,
+        std::string const &table)
+    {
+        std::vector<std::pair<std::string, std::string>> result;
+
+        auto sql = "SELECT il.name, ii.name FROM pragma_index_list(?) il, pragma_index_info(il.name) ii WHERE ii.seqno = 0;";
+
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+        {
+            return result;
+        }
+
+        sqlite3_bind_text(stmt, 1, table.c_str(), int(table.length()), SQLITE_STATIC);
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            auto index = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+            auto column = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+
+            // Expression indexes have no column name
+            if (index != nullptr && column != nullptr)
+            {
+                result.push_back(std::make_pair(index, column));
+            }
+        }
+
+        sqlite3_finalize(stmt);
+
+        return result;
+    }
+
+    void run(
+        sqlite3 *db,
+        std::vector<std::string> tables)
+    {
+        auto &s = state();
+
+        for (auto &table : tables)
+        {
+            if (pastDeadline(s))
+            {
+                break;
+            }
+
+            readAll(db, fmt::format("SELECT * FROM {0};", SqlQuote(table)), s);
+
+            for (auto &index : indexes(db, table))
+            {
+                if (pastDeadline(s))
+                {
+                    break;
+                }
+
+                readAll(db, fmt::format("SELECT {0} FROM {1} INDEXED BY {2};", SqlQuote(index.second), SqlQuote(table), SqlQuote(index.first)), s);
+            }
+
+            s.objectsDone++;
+        }
+
+        SqliteStats::Unregister(db);
+        sqlite3_close(db);
+
+        s.finished = true;
+    }
+} // namespace
+
+void Warmup::Start(
+    std::string const &dbPath,
+    SqliteSettings const &settings,
+    std::vector<std::string> const &tables,
+    std::chrono::milliseconds deadline)
+{
+    auto &s = state();
+
+    if (s.started)
+    {
+        return;
+    }
+
+    auto db = OpenConnection(dbPath, settings);
+    if (db == nullptr)
+    {
+        return;
+    }
+
+    SqliteStats::Register("warmup", db);
+
+    s.deadline = std::chrono::steady_clock::now() + deadline;
+    s.objectsTotal = tables.size();
+    s.started = true;
+    s.worker = std::thread(run, db, tables);
+}
+
+bool Warmup::IsReady()
+{
+    auto &s = state();
+
+    return !s.started || s.finished || std::chrono::steady_clock::now() >= s.deadline;
+}
+
+void Warmup::Write(
+    JsonWriter &writer)
+{
+    auto &s = state();
+
+    writer.BeginObject();
+    writer.Key("ready");
+    writer.Boolean(IsReady());
+    writer.Key("warmup");
+    writer.BeginObject();
+    writer.Key("started");
+    writer.Boolean(s.started);
+    writer.Key("finished");
+    writer.Boolean(s.finished);
+    writer.Key("tables_done");
+    writer.Integer(static_cast<long long>(s.objectsDone.load()));
+    writer.Key("tables_total");
+    writer.Integer(static_cast<long long>(s.objectsTotal.load()));
+    writer.Key("rows_read");
+    writer.Integer(static_cast<long long>(s.rowsRead.load()));
+    writer.EndObject();
+    writer.EndObject();
+}
+
+void Warmup::Stop()
+{
+    auto &s = state();
+
+    s.stopping = true;
+
+    if (s.worker.joinable())
+    {
+        s.worker.join();
+    }
+}
+
+std::atomic<uint64_t> *Warmup::AccessCounter(
+    std::string const &table)
+{
+    auto &a = accessCounters();
+    std::lock_guard<std::mutex> lock(a.mutex);
+
+    auto &counter = a.counters[table];
+    if (counter == nullptr)
+    {
+        counter = std::make_unique<std::atomic<uint64_t>>(0);
+    }
+
+    return counter.get();
+}
+
+std::vector<std::pair<std::string, uint64_t>> Warmup::AccessCounts()
+{
+    auto &a = accessCounters();
+    std::lock_guard<std::mutex> lock(a.mutex);
+
+    std::vector<std::pair<std::string, uint64_t>> counts;
+    for (auto &pair : a.counters)
+    {
+        counts.push_back(std::make_pair(pair.first, pair.second->load(std::memory_order_relaxed)));
+    }
+
+    return counts;
+}
+
+std::vector<std::string> Warmup::LoadAccessStats(
+    std::string const &path)
+{
+    std::vector<std::pair<uint64_t, std::string>> counts;
+
+    std::ifstream file(path);
+    uint64_t count;
+    std::string name;
+
+    while (file >> count >> name)
+    {
+        counts.push_back(std::make_pair(count, name));
+    }
+
+    std::stable_sort(counts.begin(), counts.end(), [](auto const &a, auto const &b) { return a.first > b.first; });
+
+    std::vector<std::string> tables;
+    for (auto &pair : counts)
+    {
+        tables.push_back(pair.second);
+    }
+
+    return tables;
+}
+
+bool Warmup::SaveAccessStats(
+    std::string const &path,
+    std::vector<std::pair<std::string, uint64_t>> const &counts)
+{
+    std::map<std::string, uint64_t> merged;
+
+    {
+        std::ifstream file(path);
+        uint64_t count;
+        std::string name;
+
+        while (file >> count >> name)
+        {
+            merged[name] = count / 2;
+        }
+    }
+
+    for (auto &pair : counts)
+    {
+        merged[pair.first] += pair.second;
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    for (auto &pair : merged)
+    {
+        if (pair.second > 0)
+        {
+            file << pair.second << ' ' << pair.first << '\n';
+        }
+    }
+
+    return bool(file);
+}
@@ -0,0 +1,52 @@
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+class JsonWriter;
+struct SqliteSettings;
+
+// Reads hot tables and their indexes on a background thread with its own connection, so their pages
+// are in the OS page cache before requests need them. With mmap_size covering the file every connection
+// reads from that same cache. The server is ready when the warm-up finished or its deadline passed.
+class Warmup
+{
+public:
+    static void Start(
+        std::string const &dbPath,
+        SqliteSettings const &settings,
+        std::vector<std::string> const &tables,
+        std::chrono::milliseconds deadline);
+
+    // True when no warm-up was started, it finished or its deadline passed.
+    static bool IsReady();
+
+    static void Write(
+        JsonWriter &writer);
+
+    // Stops the warm-up if it is still running and waits for its thread.
+    static void Stop();
+
+    // The counter of the uses of a table, the pointer stays valid. Unlike the latency stats it is never reset.
+    static std::atomic<uint64_t> *AccessCounter(
+        std::string const &table);
+
+    // The uses of every table counted in this run.
+    static std::vector<std::pair<std::string, uint64_t>> AccessCounts();
+
+    // Returns the table names from a previous run, most used first.
+    static std::vector<std::string> LoadAccessStats(
+        std::string const &path);
+
+    // Saves how often tables were used, added to half of what was saved before so old runs fade out.
+    static bool SaveAccessStats(
+        std::string const &path,
+        std::vector<std::pair<std::string, uint64_t>> const &counts);
+};
+
+#endif // WARMUP_H
@@ -1,5 +1,31 @@
+#include "common/accesslog.h"
+#include "common/admissioncontrol.h"
+#include "common/applyquery.h"
+#include "common/changefeed.h"
+#include "common/datatable.h"
+#include "common/fulltextsearch.h"
 #include "common/instrumentationtimer.h"
+#include "common/jsonwriter.h"
+#include "common/latencyhistogram.h"
+#include "common/longpoll.h"
+#include "common/metrics.h"
+#include "common/querybudget.h"
+#include "common/ratelimiter.h"
+#include "common/schema.h"
+#include "common/schemasnapshot.h"
+#include "common/schemawatcher.h"
+#include "common/slowquerylog.h"
+#include "common/shutdownsignal.h"
+#include "common/sqliteconnection.h"
+#include "common/sqlquote.h"
+#include "common/sqlitestats.h"
+#include "common/statementcache.h"
 #include "common/templateutils.h"
+#include "common/tracing.h"
+#include "common/warmup.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <config.h>
 #include <filesystem>
 #include <fmt/format.h>
@@ -8,7 +34,9 @@
 #include <http/httplistenerexception.h>
 #include <http/httplistenerresponse.h>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <memory_resource>
 #include <nlohmann/json.hpp>
 #include <regex>
 #include <sqlite3/sqlite3.h>
@@ -18,6 +46,14 @@
 
 std::string exe;
 
+struct SqliteValueDeleter
+{
+    void operator()(sqlite3_value *value) const { sqlite3_value_free(value); }
+};
+
+// The values of one row copied out of a statement, so they outlive the next step.
+typedef std::vector<std::unique_ptr<sqlite3_value, SqliteValueDeleter>> BufferedRow;
+
 class DataQuery
 {
 public:
@@ -49,111 +85,95 @@ public:
     //        std::string const &direction);
 };
 
-enum class ColumnTypes
-{
-    Integer,
-    Real,
-    Text,
-    Blob,
-};
-
-class DataTable
-{
-    std::string _rawName;
-    std::string _name = "";
-    int _version = 1;
-    std::string _primaryKey;
-    std::map<std::string, ColumnTypes> _columns;
-
-public:
-    DataTable();
-    explicit DataTable(
-        const std::string &name);
-
-    inline std::string const &RawName() const { return _rawName; }
-    inline std::string const &Name() const { return _name; }
-    inline std::string const &PrimaryKey() const { return _primaryKey; }
-    inline std::map<std::string, ColumnTypes> const &Columns() const { return _columns; }
-
-    void PrimaryKey(
-        char const *primaryKey);
-
-    void ClearColumns();
-
-    void AddColumn(
-        char const *name,
-        char const *type);
-};
-
-DataTable::DataTable()
-{}
-
-DataTable::DataTable(
-    const std::string &name)
-    : _rawName(name)
-{
-    auto versionRegex = std::regex(R"(([\w]+)_v([0-9]+))");
-
-    std::smatch matches;
-
-    if (std::regex_search(_rawName, matches, versionRegex))
-    {
-        _name = matches[1];
-        _version = std::atoi(matches[2].str().c_str());
-    }
-}
-
-void DataTable::PrimaryKey(
-    char const *primaryKey)
-{
-    _primaryKey = primaryKey;
-}
-
-void DataTable::ClearColumns()
-{
-    _columns.clear();
-}
-
-void DataTable::AddColumn(
-    char const *name,
-    char const *type)
-{
-    if (std::string_view(type) == "INTEGER" || std::string_view(type).substr(0, 7) == "NUMERIC")
-    {
-        _columns.insert(std::make_pair(name, ColumnTypes::Integer));
-    }
-    else if (std::string_view(type) == "TEXT" || std::string_view(type).substr(0, 8) == "NVARCHAR")
-    {
-        _columns.insert(std::make_pair(name, ColumnTypes::Text));
-    }
-    else if (std::string_view(type) == "Blob")
-    {
-        _columns.insert(std::make_pair(name, ColumnTypes::Blob));
-    }
-    else if (std::string_view(type) == "REAL")
-    {
-        _columns.insert(std::make_pair(name, ColumnTypes::Real));
-    }
-}
-
 class DataCollection : public DataQuery
 {
     sqlite3 *_db;
-    std::vector<DataTable> _tables;
+    std::unique_ptr<StatementCache> _statements;
+    std::string _schemaSnapshot;
+    SchemaPtr _schema;
+    SchemaWatcher _schemaWatcher;
+    std::map<std::string, FullTextIndex, std::less<>> _fullTextIndexes;
+    std::unique_ptr<ChangeFeed> _changes;
+
+    std::vector<DataTable> loadTables(
+        sqlite3 *db,
+        int &schemaVersion);
+
+    void publish(
+        std::vector<DataTable> tables,
+        int schemaVersion);
+
+    // Writes the rows of the statement as an array, with the related rows nested in when expand has relations.
+    size_t writeRows(
+        sqlite3_stmt *stmt,
+        std::vector<Relation const *> const &expand,
+        JsonWriter &writer) const;
+
+    // Loads the related rows for a page of rows with one query per relation, and writes the rows with them nested in.
+    void writeExpandedRows(
+        std::vector<std::string> const &names,
+        std::vector<BufferedRow> const &rows,
+        size_t firstIndex,
+        std::vector<Relation const *> const &expand,
+        JsonWriter &writer) const;
 
 public:
-    explicit DataCollection(
-        std::string const &db);
+    // Rows are expanded in pages of this size, it keeps the IN (...) of the related rows under the 999 variables sqlite allows.
+    static const size_t ExpandPageSize = 500;
+
+    DataCollection(
+        std::string const &db,
+        SqliteSettings const &settings,
+        std::string const &schemaSnapshot,
+        std::vector<FullTextIndex> fullTextIndexes);
     ~DataCollection();
 
-    inline std::vector<DataTable> const &Tables() const { return _tables; }
+    // The rows changed through this collection, for /api/{table}/changes.
+    inline ChangeFeed &Changes() const { return *_changes; }
 
-    nlohmann::json get(
-        const DataTable &table) const;
+    // Returns the current schema, hold on to it for the whole request so all lookups see the same tables.
+    inline SchemaPtr CurrentSchema() const { return std::atomic_load(&_schema); }
+
+    // Reloads the schema in the background when PRAGMA schema_version changes.
+    bool WatchSchema(
+        std::string const &db,
+        SqliteSettings const &settings,
+        std::chrono::milliseconds interval);
+
+    // Columns is the column list for the select, like "*" or "\"Id\",\"Title\"". Expand holds the relations
+    // to nest in every row, their columns have to be in the column list.
+    size_t get(
+        const DataTable &table,
+        const std::string &columns,
+        const std::vector<Relation const *> &expand,
+        JsonWriter &writer) const;
+
+    bool get(
+        const DataTable &table,
+        const std::string &columns,
+        const std::string &key,
+        const std::vector<Relation const *> &expand,
+        JsonWriter &writer) const;
 
-    nlohmann::json get(
+    // Writes one page of the rows matching the search, best match first. Returns false when the table has no full-text index.
+    bool search(
         const DataTable &table,
-        const std::string &key) const;
+        const std::string &columns,
+        const std::vector<Relation const *> &expand,
+        std::string_view search,
+        long long top,
+        long long skip,
+        JsonWriter &writer,
+        size_t &count) const;
+
+    // Runs a select compiled by ApplyQuery and writes its rows.
+    size_t apply(
+        const std::string &sql,
+        JsonWriter &writer) const;
+
+    // Returns -1 when the table can not be counted.
+    long long count(
+        const DataTable &table) const;
 
     nlohmann::json post(
         const DataTable &table,
@@ -172,769 +192,2587 @@ public:
         nlohmann::json const &obj);
 };
 
-std::vector<DataTable> ListTables(
-    sqlite3 *db)
+DataCollection::DataCollection(
+    std::string const &db,
+    SqliteSettings const &settings,
+    std::string const &schemaSnapshot,
+    std::vector<FullTextIndex> fullTextIndexes)
+    : _db(nullptr), _schemaSnapshot(schemaSnapshot), _schema(std::make_shared<Schema>(std::vector<DataTable>(), -1)), _changes(std::make_unique<ChangeFeed>())
 {
-    std::vector<DataTable> tables;
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(db, "SELECT name FROM sqlite_master WHERE type='table';", -1, &stmt, NULL);
+    _db = OpenConnection(db, settings);
 
-    while (sqlite3_step(stmt) == SQLITE_ROW)
+    if (_db == nullptr)
     {
-        int i;
-        int num_cols = sqlite3_column_count(stmt);
+        std::cout << db << " does not exist." << std::endl;
+        return;
+    }
 
-        for (i = 0; i < num_cols; i++)
-        {
-            switch (sqlite3_column_type(stmt, i))
-            {
-                case (SQLITE3_TEXT):
-                {
-                    auto table = std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, i)));
+    std::cout << "SQLite settings: " << DescribeConnection(_db) << std::endl;
 
-                    tables.push_back(DataTable(table));
-                    break;
-                }
-            }
-        }
-    }
+    SqliteStats::Register("main", _db);
 
-    sqlite3_finalize(stmt);
+    _statements = std::make_unique<StatementCache>(_db);
 
-    return tables;
-}
+    _changes->Attach(_db);
 
-void UpdateTableWithColumns(
-    sqlite3 *db,
-    DataTable &table)
-{
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(db, fmt::format("PRAGMA table_info({0});", table.RawName()).c_str(), -1, &stmt, NULL);
+    QueryBudget::Install(_db);
 
-    int num_cols = sqlite3_column_count(stmt);
-    if (num_cols < 6)
+    // Before the schema loads, so a new index does not outdate the snapshot right away
+    for (auto &index : fullTextIndexes)
     {
-        return;
+        std::string error;
+        if (!FullTextSearch::Install(_db, index, error))
+        {
+            std::cout << "Could not create full-text index for " << index.table << ": " << error << std::endl;
+            continue;
+        }
+
+        _fullTextIndexes[index.table] = index;
     }
 
-    while (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-        auto name = (const char *)sqlite3_column_text(stmt, 1);
-        auto type = (const char *)sqlite3_column_text(stmt, 2);
-        auto pk = sqlite3_column_int(stmt, 5);
+    auto start = std::chrono::steady_clock::now();
+    auto schemaVersion = SchemaSnapshot::SchemaVersion(_db);
+    std::vector<DataTable> tables;
 
-        if (pk != 0)
-        {
-            table.PrimaryKey(name);
-        }
+    if (!_schemaSnapshot.empty() && SchemaSnapshot::Load(_schemaSnapshot, schemaVersion, SchemaSnapshot::SchemaHash(_db), tables))
+    {
+        std::cout << "Loaded " << tables.size() << " tables from schema snapshot in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << "ms" << std::endl;
+    }
+    else
+    {
+        tables = loadTables(_db, schemaVersion);
 
-        table.AddColumn(name, type);
+        std::cout << "Loaded " << tables.size() << " tables from the database in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << "ms" << std::endl;
     }
 
-    sqlite3_finalize(stmt);
+    publish(std::move(tables), schemaVersion);
 }
 
-DataCollection::DataCollection(
-    std::string const &db)
-    : _db(nullptr)
+std::vector<DataTable> DataCollection::loadTables(
+    sqlite3 *db,
+    int &schemaVersion)
 {
-    sqlite3_open(db.c_str(), &_db);
+    // One read transaction, so the version matches the tables even when a migration runs in between
+    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
 
-    if (_db == nullptr)
+    schemaVersion = SchemaSnapshot::SchemaVersion(db);
+    auto schemaHash = _schemaSnapshot.empty() ? 0 : SchemaSnapshot::SchemaHash(db);
+    auto tables = LoadTables(db);
+
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+
+    if (!_schemaSnapshot.empty() && !SchemaSnapshot::Save(_schemaSnapshot, schemaVersion, schemaHash, tables))
     {
-        std::cout << db << " does not exist." << std::endl;
-        return;
+        std::cout << "Could not write schema snapshot " << _schemaSnapshot << std::endl;
     }
 
-    _tables = ListTables(_db);
+    return tables;
+}
 
-    for (auto &table : _tables)
+void DataCollection::publish(
+    std::vector<DataTable> tables,
+    int schemaVersion)
+{
+    for (auto &table : tables)
     {
-        UpdateTableWithColumns(_db, table);
+        table.Latency(LatencyHistograms::Get("tables", table.RawName()));
+        table.Accesses(Warmup::AccessCounter(table.RawName()));
     }
+
+    std::atomic_store(&_schema, SchemaPtr(std::make_shared<Schema>(std::move(tables), schemaVersion)));
 }
 
-DataCollection::~DataCollection()
+bool DataCollection::WatchSchema(
+    std::string const &db,
+    SqliteSettings const &settings,
+    std::chrono::milliseconds interval)
 {
-    sqlite3_close(_db);
+    return _schemaWatcher.Start(
+        db,
+        settings,
+        CurrentSchema()->Version(),
+        interval,
+        [this](
+            sqlite3 *watcherDb,
+            int schemaVersion) {
+            auto tables = loadTables(watcherDb, schemaVersion);
+
+            std::cout << "Reloaded " << tables.size() << " tables for schema version " << schemaVersion << std::endl;
+
+            publish(std::move(tables), schemaVersion);
+        });
 }
 
-nlohmann::json getData(
-    sqlite3_stmt *stmt)
+DataCollection::~DataCollection()
 {
-    auto result = nlohmann::json::array();
+    _schemaWatcher.Stop();
+    _changes->Stop();
+    _statements.reset();
 
-    while (sqlite3_step(stmt) == SQLITE_ROW)
+    // Closing checkpoints too, but not while another process has the database open, the next start
+    // would have to replay the whole log
+    if (sqlite3_wal_checkpoint_v2(_db, nullptr, SQLITE_CHECKPOINT_TRUNCATE, nullptr, nullptr) != SQLITE_OK)
     {
-        nlohmann::json row;
+        std::cout << "Could not checkpoint the write-ahead log: " << sqlite3_errmsg(_db) << std::endl;
+    }
 
-        row["index"] = result.size();
+    SqliteStats::Unregister(_db);
+    sqlite3_close(_db);
+}
 
-        for (int i = 0; i < sqlite3_column_count(stmt); i++)
-        {
-            auto type = sqlite3_column_type(stmt, i);
-            auto name = sqlite3_column_name(stmt, i);
+std::chrono::microseconds elapsedSince(
+    std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+}
 
-            nlohmann::json cell;
+void WriteRow(
+    sqlite3_stmt *stmt,
+    size_t index,
+    JsonWriter &writer)
+{
+    writer.BeginObject();
 
-            if (type == 3)
-            {
-                auto size = sqlite3_column_bytes(stmt, i);
-                auto text = sqlite3_column_text(stmt, i);
+    writer.Key("index");
+    writer.Integer(static_cast<long long>(index));
 
-                auto str = std::string(reinterpret_cast<const char *>(text), size);
+    for (int i = 0; i < sqlite3_column_count(stmt); i++)
+    {
+        auto type = sqlite3_column_type(stmt, i);
+        auto name = sqlite3_column_name(stmt, i);
 
-                row[name] = str;
-            }
-            else if (type == 1)
-            {
-                auto value = sqlite3_column_int(stmt, i);
+        if (type == SQLITE_TEXT)
+        {
+            auto size = sqlite3_column_bytes(stmt, i);
+            auto text = sqlite3_column_text(stmt, i);
 
-                row[name] = value;
-            }
+            writer.Key(name);
+            writer.String(std::string_view(reinterpret_cast<const char *>(text), size_t(size)));
+        }
+        else if (type == SQLITE_INTEGER)
+        {
+            writer.Key(name);
+            writer.Integer(sqlite3_column_int64(stmt, i));
+        }
+        else if (type == SQLITE_FLOAT)
+        {
+            writer.Key(name);
+            writer.Real(sqlite3_column_double(stmt, i));
+        }
+        else if (type == SQLITE_NULL)
+        {
+            writer.Key(name);
+            writer.Null();
         }
-        result.push_back(row);
     }
 
-    return result;
+    writer.EndObject();
 }
 
-nlohmann::json DataCollection::get(
-    const DataTable &table,
-    const std::string &key) const
+void WriteValue(
+    sqlite3_value *value,
+    JsonWriter &writer)
 {
-    std::stringstream ss;
+    switch (sqlite3_value_type(value))
+    {
+        case SQLITE_TEXT:
+        {
+            auto size = sqlite3_value_bytes(value);
+            auto text = sqlite3_value_text(value);
+
+            writer.String(std::string_view(reinterpret_cast<const char *>(text), size_t(size)));
+            break;
+        }
+        case SQLITE_INTEGER:
+        {
+            writer.Integer(sqlite3_value_int64(value));
+            break;
+        }
+        case SQLITE_FLOAT:
+        {
+            writer.Real(sqlite3_value_double(value));
+            break;
+        }
+        default:
+        {
+            writer.Null();
+            break;
+        }
+    }
+}
 
-    ss << "select * from " << table.RawName() << " where " << table.PrimaryKey() << " = ?";
+std::vector<std::string> ColumnNames(
+    sqlite3_stmt *stmt)
+{
+    std::vector<std::string> names;
 
-    auto sql = ss.str();
+    for (int i = 0; i < sqlite3_column_count(stmt); i++)
+    {
+        names.push_back(sqlite3_column_name(stmt, i));
+    }
 
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(_db, sql.c_str(), int(sql.length()), &stmt, nullptr);
-    sqlite3_bind_text(stmt, 1, key.c_str(), int(key.length()), SQLITE_STATIC);
+    return names;
+}
 
-    auto result = getData(stmt);
+BufferedRow BufferRow(
+    sqlite3_stmt *stmt)
+{
+    BufferedRow row;
+
+    for (int i = 0; i < sqlite3_column_count(stmt); i++)
+    {
+        row.emplace_back(sqlite3_value_dup(sqlite3_column_value(stmt, i)));
+    }
+
+    return row;
+}
 
-    sqlite3_finalize(stmt);
+// Writes the index and the columns of a buffered row, the caller begins and ends the object.
+void WriteBufferedColumns(
+    std::vector<std::string> const &names,
+    BufferedRow const &row,
+    size_t index,
+    JsonWriter &writer)
+{
+    writer.Key("index");
+    writer.Integer(static_cast<long long>(index));
 
-    if (result.empty())
+    for (size_t i = 0; i < row.size(); i++)
     {
-        return nlohmann::json();
+        // Blobs are left out, like WriteRow does
+        if (sqlite3_value_type(row[i].get()) == SQLITE_BLOB)
+        {
+            continue;
+        }
+
+        writer.Key(names[i]);
+        WriteValue(row[i].get(), writer);
     }
+}
+
+// The text of a key value, used to match related rows to their row.
+std::string_view KeyText(
+    sqlite3_value *value)
+{
+    auto text = sqlite3_value_text(value);
 
-    return result[0];
+    return std::string_view(reinterpret_cast<const char *>(text), size_t(sqlite3_value_bytes(value)));
 }
 
-nlohmann::json DataCollection::get(
-    const DataTable &table) const
+size_t WriteRows(
+    sqlite3_stmt *stmt,
+    JsonWriter &writer)
 {
-    std::stringstream ss;
+    size_t count = 0;
 
-    ss << "select * from " << table.RawName() << ";";
+    writer.BeginArray();
 
-    auto sql = ss.str();
+    {
+        // Rows are written while stepping, so this span holds the serialization as well
+        InstrumentationTimer span("sqlite3_step");
 
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(_db, sql.c_str(), int(sql.length()), &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            WriteRow(stmt, count++, writer);
+        }
+    }
 
-    auto result = getData(stmt);
+    writer.EndArray();
 
-    sqlite3_finalize(stmt);
+    Metrics::Add(Metrics::SqliteSteps, count + 1);
 
-    return result;
+    return count;
 }
 
-nlohmann::json DataCollection::post(
-    const DataTable &table,
-    const nlohmann::json &obj) const
+void DataCollection::writeExpandedRows(
+    std::vector<std::string> const &names,
+    std::vector<BufferedRow> const &rows,
+    size_t firstIndex,
+    std::vector<Relation const *> const &expand,
+    JsonWriter &writer) const
 {
-    (void)table;
-    (void)obj;
+    struct RelatedRows
+    {
+        std::vector<std::string> names;
+        std::map<std::string, std::vector<BufferedRow>, std::less<>> byKey;
+        int column = -1;
+    };
 
-    std::vector<std::string> keys;
-    std::vector<nlohmann::json> values;
+    std::vector<RelatedRows> related(expand.size());
 
-    for (auto &val : obj.items())
+    for (size_t r = 0; r < expand.size(); r++)
     {
-        if (table.Columns().find(val.key()) == table.Columns().end())
+        auto relation = expand[r];
+
+        related[r].column = int(std::find(names.begin(), names.end(), relation->column) - names.begin());
+        if (related[r].column == int(names.size()))
         {
             continue;
         }
 
-        if (val.key() == table.PrimaryKey())
+        // Every distinct key once, rows without a key have no related rows
+        std::map<std::string_view, sqlite3_value *> keys;
+        for (auto &row : rows)
+        {
+            auto value = row[size_t(related[r].column)].get();
+            if (sqlite3_value_type(value) != SQLITE_NULL)
+            {
+                keys.emplace(KeyText(value), value);
+            }
+        }
+
+        if (keys.empty())
         {
             continue;
         }
 
-        keys.push_back(val.key());
-        values.push_back(val.value());
-    }
+        // The list is padded to a power of two, or the page size, so a relation has a few statements in the cache
+        // instead of one for every count of keys, the padding is bound to NULL which matches nothing
+        size_t slots = 1;
+        while (slots < keys.size())
+        {
+            slots *= 2;
+        }
+        slots = std::min(slots, std::max(keys.size(), size_t(ExpandPageSize)));
 
-    if (keys.empty())
-    {
-        nlohmann::json error = {
-            {"error", "object has no known properties"},
-        };
+        std::string sql = fmt::format("select * from {0} where {1} in (?", SqlQuote(relation->table), SqlQuote(relation->relatedColumn));
+        for (size_t i = 1; i < slots; i++)
+        {
+            sql += ",?";
+        }
+        sql += ");";
 
-        return error;
-    }
+        auto start = std::chrono::steady_clock::now();
 
-    std::stringstream ss;
+        auto stmt = _statements->Acquire(sql);
+        if (stmt == nullptr)
+        {
+            continue;
+        }
 
-    ss << "insert into " << table.RawName() << " (";
-    for (size_t i = 0; i < keys.size(); i++)
-    {
-        if (i > 0) ss << ",  ";
-        ss << keys[i];
-    }
-    ss << ") VALUES (";
-    for (size_t i = 0; i < values.size(); i++)
-    {
-        if (i > 0)
-            ss << ", ?";
-        else
-            ss << "?";
-    }
-    ss << ");";
+        int parameter = 1;
+        for (auto &key : keys)
+        {
+            sqlite3_bind_value(stmt, parameter++, key.second);
+        }
+        while (parameter <= int(slots))
+        {
+            sqlite3_bind_null(stmt, parameter++);
+        }
 
-    auto sql = ss.str();
+        related[r].names = ColumnNames(stmt);
 
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(_db, sql.c_str(), int(sql.length()), &stmt, nullptr);
+        auto keyColumn = size_t(std::find(related[r].names.begin(), related[r].names.end(), relation->relatedColumn) - related[r].names.begin());
 
-    for (size_t i = 0; i < values.size(); i++)
-    {
-        if (values[i].is_string())
-        {
-            auto var = values[i].get<std::string>();
-            sqlite3_bind_text(stmt, 1 + int(i), var.c_str(), int(var.length()), SQLITE_TRANSIENT);
-        }
-        else if (values[i].is_number_integer())
+        size_t count = 0;
         {
-            auto var = values[i].get<int>();
-            sqlite3_bind_int(stmt, 1 + int(i), var);
+            InstrumentationTimer span("sqlite3_step");
+
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                auto row = BufferRow(stmt);
+                if (keyColumn < row.size())
+                {
+                    auto key = std::string(KeyText(row[keyColumn].get()));
+                    related[r].byKey[key].push_back(std::move(row));
+                }
+                count++;
+            }
         }
-    }
 
-    auto stepResult = sqlite3_step(stmt);
-    if (stepResult == SQLITE_DONE)
-    {
-        nlohmann::json v = {
-            {table.PrimaryKey(), sqlite3_last_insert_rowid(this->_db)},
-        };
+        Metrics::Add(Metrics::SqliteSteps, count + 1);
 
-        return v;
+        SlowQueryLog::Finish(stmt, elapsedSince(start), count);
+        _statements->Release(stmt);
     }
-    else if (stepResult == SQLITE_CONSTRAINT)
-    {
-        nlohmann::json error = {
-            {"error", "Abort due to constraint violation"},
-        };
 
-        return error;
-    }
-    else if (stepResult == SQLITE_ERROR || stepResult == SQLITE_MISUSE)
+    for (size_t i = 0; i < rows.size(); i++)
     {
-        nlohmann::json error = {
-            {"error", sqlite3_errmsg(this->_db)},
-        };
+        auto &row = rows[i];
 
-        return error;
-    }
+        writer.BeginObject();
 
-    sqlite3_finalize(stmt);
+        WriteBufferedColumns(names, row, firstIndex + i, writer);
 
-    nlohmann::json v = {
-        {table.PrimaryKey(), -1},
-    };
+        for (size_t r = 0; r < expand.size(); r++)
+        {
+            std::vector<BufferedRow> const *children = nullptr;
 
-    return v;
+            if (related[r].column < int(names.size()) && sqlite3_value_type(row[size_t(related[r].column)].get()) != SQLITE_NULL)
+            {
+                auto found = related[r].byKey.find(KeyText(row[size_t(related[r].column)].get()));
+                if (found != related[r].byKey.end())
+                {
+                    children = &found->second;
+                }
+            }
+
+            writer.Key(expand[r]->name);
+
+            if (expand[r]->many)
+            {
+                writer.BeginArray();
+                if (children != nullptr)
+                {
+                    for (size_t c = 0; c < children->size(); c++)
+                    {
+                        writer.BeginObject();
+                        WriteBufferedColumns(related[r].names, (*children)[c], c, writer);
+                        writer.EndObject();
+                    }
+                }
+                writer.EndArray();
+            }
+            else if (children != nullptr)
+            {
+                writer.BeginObject();
+                WriteBufferedColumns(related[r].names, children->front(), 0, writer);
+                writer.EndObject();
+            }
+            else
+            {
+                writer.Null();
+            }
+        }
+
+        writer.EndObject();
+    }
+}
+
+size_t DataCollection::writeRows(
+    sqlite3_stmt *stmt,
+    std::vector<Relation const *> const &expand,
+    JsonWriter &writer) const
+{
+    if (expand.empty())
+    {
+        return WriteRows(stmt, writer);
+    }
+
+    // The rows are written a page at a time, after the related rows of the page are loaded
+    auto names = ColumnNames(stmt);
+    std::vector<BufferedRow> page;
+    page.reserve(ExpandPageSize);
+
+    size_t count = 0;
+
+    writer.BeginArray();
+
+    auto done = false;
+    while (!done)
+    {
+        // One span per page, a span per row would fill the trace of a large expand and time every row
+        {
+            InstrumentationTimer span("sqlite3_step");
+
+            while (page.size() < ExpandPageSize)
+            {
+                if (sqlite3_step(stmt) != SQLITE_ROW)
+                {
+                    done = true;
+                    break;
+                }
+
+                page.push_back(BufferRow(stmt));
+                count++;
+            }
+        }
+
+        if (!page.empty())
+        {
+            writeExpandedRows(names, page, count - page.size(), expand, writer);
+            page.clear();
+        }
+    }
+
+    writer.EndArray();
+
+    Metrics::Add(Metrics::SqliteSteps, count + 1);
+
+    return count;
+}
+
+bool DataCollection::get(
+    const DataTable &table,
+    const std::string &columns,
+    const std::string &key,
+    const std::vector<Relation const *> &expand,
+    JsonWriter &writer) const
+{
+    std::stringstream ss;
+
+    ss << "select " << columns << " from " << table.RawName() << " where " << table.PrimaryKey() << " = ?";
+
+    auto sql = ss.str();
+    auto start = std::chrono::steady_clock::now();
+
+    auto stmt = _statements->Acquire(sql);
+    if (stmt == nullptr)
+    {
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, key.c_str(), int(key.length()), SQLITE_STATIC);
+
+    InstrumentationTimer span("sqlite3_step");
+
+    auto found = sqlite3_step(stmt) == SQLITE_ROW;
+
+    span.Stop();
+
+    Metrics::Add(Metrics::SqliteSteps, 1);
+
+    if (found && expand.empty())
+    {
+        WriteRow(stmt, 0, writer);
+    }
+    else if (found)
+    {
+        std::vector<BufferedRow> rows;
+        rows.push_back(BufferRow(stmt));
+
+        writeExpandedRows(ColumnNames(stmt), rows, 0, expand, writer);
+    }
+
+    SlowQueryLog::Finish(stmt, elapsedSince(start), found ? 1 : 0);
+    _statements->Release(stmt);
+
+    return found;
+}
+
+size_t DataCollection::get(
+    const DataTable &table,
+    const std::string &columns,
+    const std::vector<Relation const *> &expand,
+    JsonWriter &writer) const
+{
+    std::stringstream ss;
+
+    ss << "select " << columns << " from " << table.RawName() << ";";
+
+    auto sql = ss.str();
+    auto start = std::chrono::steady_clock::now();
+
+    auto stmt = _statements->Acquire(sql);
+    if (stmt == nullptr)
+    {
+        writer.BeginArray();
+        writer.EndArray();
+        return 0;
+    }
+
+    auto count = writeRows(stmt, expand, writer);
+
+    SlowQueryLog::Finish(stmt, elapsedSince(start), count);
+    _statements->Release(stmt);
+
+    return count;
+}
+
+bool DataCollection::search(
+    const DataTable &table,
+    const std::string &columns,
+    const std::vector<Relation const *> &expand,
+    std::string_view search,
+    long long top,
+    long long skip,
+    JsonWriter &writer,
+    size_t &count) const
+{
+    auto index = _fullTextIndexes.find(table.RawName());
+    if (index == _fullTextIndexes.end())
+    {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    count = 0;
+
+    auto stmt = _statements->Acquire(FullTextSearch::Sql(index->second, columns));
+    if (stmt == nullptr)
+    {
+        writer.BeginArray();
+        writer.EndArray();
+        return true;
+    }
+
+    auto match = FullTextSearch::MatchExpression(search);
+
+    sqlite3_bind_text(stmt, 1, match.c_str(), int(match.length()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, top);
+    sqlite3_bind_int64(stmt, 3, skip);
+
+    count = writeRows(stmt, expand, writer);
+
+    SlowQueryLog::Finish(stmt, elapsedSince(start), count);
+    _statements->Release(stmt);
+
+    return true;
+}
+
+size_t DataCollection::apply(
+    const std::string &sql,
+    JsonWriter &writer) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    auto stmt = _statements->Acquire(sql);
+    if (stmt == nullptr)
+    {
+        writer.BeginArray();
+        writer.EndArray();
+        return 0;
+    }
+
+    auto count = WriteRows(stmt, writer);
+
+    SlowQueryLog::Finish(stmt, elapsedSince(start), count);
+    _statements->Release(stmt);
+
+    return count;
+}
+
+long long DataCollection::count(
+    const DataTable &table) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    auto stmt = _statements->Acquire(ApplyQuery::Count(table));
+    if (stmt == nullptr)
+    {
+        return -1;
+    }
+
+    InstrumentationTimer span("sqlite3_step");
+
+    long long result = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : -1;
+
+    span.Stop();
+
+    Metrics::Add(Metrics::SqliteSteps, 1);
+
+    SlowQueryLog::Finish(stmt, elapsedSince(start), 1);
+    _statements->Release(stmt);
+
+    return result;
+}
+
+nlohmann::json DataCollection::post(
+    const DataTable &table,
+    const nlohmann::json &obj) const
+{
+    (void)table;
+    (void)obj;
+
+    std::vector<std::string> keys;
+    std::vector<nlohmann::json> values;
+
+    for (auto &val : obj.items())
+    {
+        if (table.Columns().find(val.key()) == table.Columns().end())
+        {
+            continue;
+        }
+
+        if (val.key() == table.PrimaryKey())
+        {
+            continue;
+        }
+
+        keys.push_back(val.key());
+        values.push_back(val.value());
+    }
+
+    if (keys.empty())
+    {
+        nlohmann::json error = {
+            {"error", "object has no known properties"},
+        };
+
+        return error;
+    }
+
+    std::stringstream ss;
+
+    ss << "insert into " << table.RawName() << " (";
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (i > 0) ss << ",  ";
+        ss << keys[i];
+    }
+    ss << ") VALUES (";
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (i > 0)
+            ss << ", ?";
+        else
+            ss << "?";
+    }
+    ss << ");";
+
+    auto sql = ss.str();
+    auto start = std::chrono::steady_clock::now();
+
+    // The workers share the connection, its last rowid and error message are those of whoever used it last, so
+    // they are read under the mutex of the connection along with the step. The mutex is recursive, sqlite takes
+    // it again in the calls below.
+    auto connection = sqlite3_db_mutex(_db);
+    sqlite3_mutex_enter(connection);
+    std::unique_ptr<sqlite3_mutex, decltype(&sqlite3_mutex_leave)> leave(connection, &sqlite3_mutex_leave);
+
+    auto stmt = _statements->Acquire(sql);
+    if (stmt == nullptr)
+    {
+        nlohmann::json error = {
+            {"error", sqlite3_errmsg(this->_db)},
+        };
+
+        return error;
+    }
+
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (values[i].is_string())
+        {
+            auto var = values[i].get<std::string>();
+            sqlite3_bind_text(stmt, 1 + int(i), var.c_str(), int(var.length()), SQLITE_TRANSIENT);
+        }
+        else if (values[i].is_number_integer())
+        {
+            auto var = values[i].get<int>();
+            sqlite3_bind_int(stmt, 1 + int(i), var);
+        }
+    }
+
+    InstrumentationTimer span("sqlite3_step");
+
+    auto stepResult = sqlite3_step(stmt);
+
+    span.Stop();
+
+    Metrics::Add(Metrics::SqliteSteps, 1);
+    SlowQueryLog::Finish(stmt, elapsedSince(start), stepResult == SQLITE_DONE ? 1 : 0);
+    _statements->Release(stmt);
+
+    if (stepResult == SQLITE_DONE)
+    {
+        nlohmann::json v = {
+            {table.PrimaryKey(), sqlite3_last_insert_rowid(this->_db)},
+        };
+
+        return v;
+    }
+    else if (stepResult == SQLITE_CONSTRAINT)
+    {
+        nlohmann::json error = {
+            {"error", "Abort due to constraint violation"},
+        };
+
+        return error;
+    }
+    else if (stepResult == SQLITE_ERROR || stepResult == SQLITE_MISUSE)
+    {
+        nlohmann::json error = {
+            {"error", sqlite3_errmsg(this->_db)},
+        };
+
+        return error;
+    }
+
+    nlohmann::json v = {
+        {table.PrimaryKey(), -1},
+    };
+
+    return v;
+}
+
+void ParseQuery(
+    System::Net::Http::HttpListenerRequest const *request,
+    const DataQuery &query)
+{
+    (void)request;
+    (void)query;
+}
+
+namespace fs = std::filesystem;
+
+void RouteStatic(
+    std::string_view content,
+    const std::string &contentType,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteHelp(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteQuit(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteMetrics(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteLatencyStats(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteLatencyStatsReset(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteSqliteStats(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteReady(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+// Finds the table of an api route, matches[1] holds the version from the url and matches[2] the table name.
+DataTable const *FindTable(
+    const Schema &schema,
+    const System::Net::Http::HttpListenerRequest &request,
+    const std::pmr::cmatch &matches);
+
+// Turns $select=a,b into the column list for a select, "*" without $select. Returns false for columns the table does not have.
+bool SelectColumns(
+    const DataTable &table,
+    const System::Net::Http::HttpListenerRequest &request,
+    std::string &columns,
+    std::string &error);
+
+// Finds the relations in $expand, and adds their columns to the selected columns when they are missing.
+bool ExpandRelations(
+    const DataTable &table,
+    const System::Net::Http::HttpListenerRequest &request,
+    std::vector<Relation const *> &expand,
+    std::string &columns,
+    std::string &error);
+
+void RouteGetAllApi(
+    const DataCollection &collection,
+    LongPoll &longPoll,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteRowsApi(
+    const DataCollection &collection,
+    const DataTable &table,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response);
+
+void RouteGetByIdApi(
+    const DataCollection &collection,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteCountApi(
+    const DataCollection &collection,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteChangesApi(
+    const DataCollection &collection,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteApplyApi(
+    const DataCollection &collection,
+    const DataTable &table,
+    std::string_view apply,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response);
+
+void RouteSearchApi(
+    const DataCollection &collection,
+    const DataTable &table,
+    std::string_view search,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response);
+
+void RoutePostApi(
+    const DataCollection &collection,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void RouteRoot(
+    const char *dbFile,
+    const DataCollection &collection,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+void BadRequest(
+    std::string const &err,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response);
+
+void InternalServerError(
+    std::string const &err,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response);
+
+void NotFoundError(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches);
+
+bool QueryStopped(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response);
+
+void HandlerFailed(
+    int statusCode,
+    std::string const &err,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response);
+
+void ServiceUnavailable(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response);
+
+void TooManyRequests(
+    std::chrono::seconds retryAfter,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response);
+
+std::string showHelp(
+    std::string const &exe,
+    bool showOptions);
+
+typedef std::function<void(const System::Net::Http::HttpListenerRequest &request, System::Net::Http::HttpListenerResponse &response, const std::pmr::cmatch &matches)> RouteHandler;
+
+struct RouteEntry
+{
+    std::regex pattern;
+    RouteHandler handler;
+    int metricsRoute;
+    LatencyHistogram *latency;
+    AdmissionControl::Priorities priority;
+};
+
+typedef std::vector<RouteEntry> RouteCollection;
+
+class Router
+{
+public:
+    // High priority routes, like point lookups, still get in when the queue has no room for full scans.
+    void Get(
+        const std::string &pattern,
+        RouteHandler handler,
+        AdmissionControl::Priorities priority = AdmissionControl::Priorities::Normal);
+
+    void Post(
+        const std::string &pattern,
+        RouteHandler handler,
+        AdmissionControl::Priorities priority = AdmissionControl::Priorities::Normal);
+
+    // Finds the first route matching the request and fills matches, or returns nullptr when nothing matched.
+    RouteEntry const *Match(
+        const System::Net::Http::HttpListenerRequest &request,
+        std::pmr::cmatch &matches) const;
+
+private:
+    RouteCollection _getRoutes;
+    RouteCollection _postRoutes;
+    RouteCollection _putRoutes;
+};
+
+void Router::Get(
+    const std::string &pattern,
+    RouteHandler handler,
+    AdmissionControl::Priorities priority)
+{
+    auto r = std::regex(pattern);
+
+    _getRoutes.push_back(RouteEntry{std::move(r), handler, Metrics::RegisterRoute("GET " + pattern), LatencyHistograms::Get("routes", "GET " + pattern), priority});
+}
+
+void Router::Post(
+    const std::string &pattern,
+    RouteHandler handler,
+    AdmissionControl::Priorities priority)
+{
+    auto r = std::regex(pattern);
+
+    _postRoutes.push_back(RouteEntry{std::move(r), handler, Metrics::RegisterRoute("POST " + pattern), LatencyHistograms::Get("routes", "POST " + pattern), priority});
+}
+
+RouteEntry const *Router::Match(
+    const System::Net::Http::HttpListenerRequest &request,
+    std::pmr::cmatch &matches) const
+{
+    InstrumentationTimer span("Router::Match");
+
+    auto url = request.Path();
+
+    if (request.HttpMethod() == "GET")
+    {
+        for (auto &route : _getRoutes)
+        {
+            if (std::regex_match(url.data(), url.data() + url.size(), matches, route.pattern))
+            {
+                return &route;
+            }
+        }
+    }
+
+    else if (request.HttpMethod() == "POST")
+    {
+        for (auto &route : _postRoutes)
+        {
+            if (std::regex_match(url.data(), url.data() + url.size(), matches, route.pattern))
+            {
+                return &route;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+// The rate limit tokens a full scan takes, a point lookup takes one.
+const double ScanCost = 10;
+
+// An accepted request waiting for a worker, it owns the context until the response is sent.
+struct PendingRequest
+{
+    std::unique_ptr<System::Net::Http::HttpListenerContext> context;
+    RouteEntry const *route;
+    std::pmr::cmatch matches;
+    std::chrono::steady_clock::time_point accepted;
+    std::chrono::steady_clock::time_point started;
+
+    explicit PendingRequest(
+        std::unique_ptr<System::Net::Http::HttpListenerContext> accepted)
+        : context(std::move(accepted)),
+          route(nullptr),
+          matches(context->Arena()),
+          accepted(std::chrono::steady_clock::now()),
+          started(this->accepted)
+    {}
+};
+
+// Cleared by /quit on a worker or by SIGTERM, read by the thread accepting connections
+std::atomic<bool> keepServerRunning(true);
+
+// The listener to stop on SIGTERM, a signal handler can only reach globals
+std::atomic<System::Net::Http::HttpListener *> runningListener(nullptr);
+
+void StopServer()
+{
+    keepServerRunning = false;
+
+    auto listener = runningListener.load();
+    if (listener != nullptr)
+    {
+        listener->Stop();
+    }
+}
+
+// Set with --query-timeout, 0 lets queries run as long as they take
+std::chrono::milliseconds queryTimeout(0);
+
+// The query timeout of a request, X-Query-Timeout (in milliseconds) can only make it shorter than --query-timeout.
+std::chrono::milliseconds QueryTimeout(
+    const System::Net::Http::HttpListenerRequest &request)
+{
+    auto header = request.Headers().find("X-Query-Timeout");
+    if (header == request.Headers().end())
+    {
+        return queryTimeout;
+    }
+
+    long long milliseconds = 0;
+    auto text = std::string_view(header->second);
+    auto result = std::from_chars(text.data(), text.data() + text.size(), milliseconds);
+    if (result.ec != std::errc() || result.ptr != text.data() + text.size() || milliseconds <= 0)
+    {
+        return queryTimeout;
+    }
+
+    if (queryTimeout.count() > 0 && milliseconds > queryTimeout.count())
+    {
+        return queryTimeout;
+    }
+
+    return std::chrono::milliseconds(milliseconds);
+}
+
+bool IsSqliteOption(
+    std::string const &arg)
+{
+    for (auto option : {"--journal-mode", "--synchronous", "--cache-size", "--mmap-size", "--temp-store", "--busy-timeout"})
+    {
+        if (arg == option)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int main(
+    int argc,
+    char *argv[])
+{
+    if (argc == 1)
+    {
+        showHelp(argv[0], false);
+    }
+
+    std::string listenUrl = "http://localhost:8888/";
+    std::string accessLogFile;
+    std::string traceFile;
+    std::string slowQueryLogFile;
+    long slowQueryMilliseconds = -1;
+    std::string sqliteProfile;
+    std::vector<std::pair<std::string, std::string>> sqliteOptions;
+    bool warmup = false;
+    std::string warmupTables;
+    std::string warmupStatsFile;
+    long warmupDeadlineSeconds = 30;
+    std::string schemaSnapshotFile;
+    long schemaPollMilliseconds = 1000;
+    long workers = 4;
+    long maxQueued = 64;
+    long maxConnections = 50;
+    long maxBodyBytes = 8 * 1024 * 1024;
+    long readTimeoutMs = 10000;
+    long shutdownTimeoutSeconds = 30;
+    long acceptThreads = 1;
+    double rateLimit = 0;
+    double rateBurst = 0;
+    std::vector<FullTextIndex> fullTextIndexes;
+    const char *dbFile = nullptr;
+
+    for (int i = 0; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--help" || std::string(argv[i]) == "-h")
+        {
+            std::cout << showHelp(argv[0], true);
+            return 0;
+        }
+        else if (std::string(argv[i]) == "--listen-url" && ++i < argc)
+        {
+            listenUrl = argv[i];
+        }
+        else if (std::string(argv[i]) == "--access-log" && ++i < argc)
+        {
+            accessLogFile = argv[i];
+        }
+        else if (std::string(argv[i]) == "--trace-file" && ++i < argc)
+        {
+            traceFile = argv[i];
+        }
+        else if (std::string(argv[i]) == "--slow-query-ms" && ++i < argc)
+        {
+            slowQueryMilliseconds = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--slow-query-log" && ++i < argc)
+        {
+            slowQueryLogFile = argv[i];
+        }
+        else if (std::string(argv[i]) == "--sqlite-profile" && ++i < argc)
+        {
+            sqliteProfile = argv[i];
+        }
+        else if (std::string(argv[i]) == "--warmup")
+        {
+            warmup = true;
+        }
+        else if (std::string(argv[i]) == "--warmup-tables" && ++i < argc)
+        {
+            warmup = true;
+            warmupTables = argv[i];
+        }
+        else if (std::string(argv[i]) == "--warmup-stats" && ++i < argc)
+        {
+            warmupStatsFile = argv[i];
+        }
+        else if (std::string(argv[i]) == "--warmup-deadline" && ++i < argc)
+        {
+            warmupDeadlineSeconds = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--schema-snapshot" && ++i < argc)
+        {
+            schemaSnapshotFile = argv[i];
+        }
+        else if (std::string(argv[i]) == "--schema-poll-ms" && ++i < argc)
+        {
+            schemaPollMilliseconds = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--query-timeout" && ++i < argc)
+        {
+            queryTimeout = std::chrono::milliseconds(std::atol(argv[i]));
+        }
+        else if (std::string(argv[i]) == "--workers" && ++i < argc)
+        {
+            workers = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--max-queued" && ++i < argc)
+        {
+            maxQueued = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--max-connections" && ++i < argc)
+        {
+            maxConnections = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--max-body" && ++i < argc)
+        {
+            maxBodyBytes = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--read-timeout" && ++i < argc)
+        {
+            readTimeoutMs = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--accept-threads" && ++i < argc)
+        {
+            acceptThreads = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--shutdown-timeout" && ++i < argc)
+        {
+            shutdownTimeoutSeconds = std::atol(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--rate-limit" && ++i < argc)
+        {
+            rateLimit = std::atof(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--rate-burst" && ++i < argc)
+        {
+            rateBurst = std::atof(argv[i]);
+        }
+        else if (std::string(argv[i]) == "--fts" && ++i < argc)
+        {
+            FullTextIndex index;
+            if (!FullTextSearch::Parse(argv[i], index))
+            {
+                std::cout << "Invalid --fts " << argv[i] << ", expected TABLE(COLUMN,...)" << std::endl;
+                return 1;
+            }
+
+            fullTextIndexes.push_back(index);
+        }
+        else if (IsSqliteOption(argv[i]) && i + 1 < argc)
+        {
+            sqliteOptions.push_back(std::make_pair(std::string(argv[i] + 2), std::string(argv[i + 1])));
+            ++i;
+        }
+        else
+        {
+            dbFile = argv[i];
+        }
+    }
+
+    // The profile goes first, so the individual options override it
+    SqliteSettings sqliteSettings;
+
+    if (!sqliteProfile.empty() && !sqliteSettings.Profile(sqliteProfile))
+    {
+        std::cout << "Unknown sqlite profile " << sqliteProfile << std::endl;
+        return 1;
+    }
+
+    for (auto &option : sqliteOptions)
+    {
+        if (!sqliteSettings.Set(option.first, option.second))
+        {
+            std::cout << "Invalid value " << option.second << " for --" << option.first << std::endl;
+            return 1;
+        }
+    }
+
+    // Map the whole file, so the pages the warm-up reads are shared with every connection. The mapping
+    // only reserves address space, so it leaves room for the file to double before pages fall outside.
+    // An explicit --mmap-size is kept as it is.
+    std::error_code ec;
+    auto dbFileSize = dbFile != nullptr ? std::filesystem::file_size(dbFile, ec) : 0;
+
+    auto mmapSizeSet = std::any_of(sqliteOptions.begin(), sqliteOptions.end(), [](std::pair<std::string, std::string> const &option) {
+        return option.first == "mmap-size";
+    });
+
+    if (warmup && !ec && !mmapSizeSet && sqliteSettings.mmapSize.value_or(0) < 2 * static_cast<long long>(dbFileSize))
+    {
+        sqliteSettings.mmapSize = 2 * static_cast<long long>(dbFileSize);
+    }
+
+    // Declared before the collection so it runs after the database closed, a windows console handler waits for it
+    struct FinishedOnExit
+    {
+        ~FinishedOnExit() { ShutdownSignal::Finished(); }
+    } finishedOnExit;
+
+    DataCollection collection(dbFile, sqliteSettings, schemaSnapshotFile, fullTextIndexes);
+
+    if (dbFile != nullptr && schemaPollMilliseconds > 0)
+    {
+        collection.WatchSchema(dbFile, sqliteSettings, std::chrono::milliseconds(schemaPollMilliseconds));
+    }
+
+    if (warmupStatsFile.empty() && dbFile != nullptr)
+    {
+        warmupStatsFile = std::string(dbFile) + ".warmup";
+    }
+
+    if (warmup)
+    {
+        std::vector<std::string> tables;
+        std::vector<std::string> candidates;
+
+        if (!warmupTables.empty())
+        {
+            std::stringstream ss(warmupTables);
+            std::string name;
+
+            while (std::getline(ss, name, ','))
+            {
+                candidates.push_back(name);
+            }
+        }
+        else
+        {
+            candidates = Warmup::LoadAccessStats(warmupStatsFile);
+        }
+
+        auto schema = collection.CurrentSchema();
+
+        for (auto &name : candidates)
+        {
+            auto found = std::find_if(
+                schema->Tables().begin(),
+                schema->Tables().end(),
+                [&name](const DataTable &table) {
+                    return table.RawName() == name || table.Name() == name;
+                });
+
+            if (found != schema->Tables().end())
+            {
+                tables.push_back(found->RawName());
+            }
+        }
+
+        std::cout << "Warming up " << tables.size() << " tables" << std::endl;
+
+        Warmup::Start(dbFile, sqliteSettings, tables, std::chrono::seconds(warmupDeadlineSeconds));
+    }
+
+    if (!accessLogFile.empty() && !AccessLog::Open(accessLogFile))
+    {
+        std::cout << "Could not open access log " << accessLogFile << std::endl;
+    }
+
+    if (slowQueryMilliseconds < 0 && !slowQueryLogFile.empty())
+    {
+        slowQueryMilliseconds = 100;
+    }
+
+    if (slowQueryMilliseconds >= 0 && !SlowQueryLog::Open(slowQueryLogFile, std::chrono::milliseconds(slowQueryMilliseconds)))
+    {
+        std::cout << "Could not open slow query log " << slowQueryLogFile << std::endl;
+    }
+
+    if (!traceFile.empty())
+    {
+        Tracing::Enable();
+        System::Net::Http::HttpListener::SetTraceCallback(
+            [](
+                char const *name,
+                std::chrono::steady_clock::time_point start,
+                std::chrono::steady_clock::time_point end) {
+                Tracing::AddSpan(name, start, end);
+            });
+    }
+
+    exe = std::string(argv[0]);
+    auto pos = exe.find_last_of('\\');
+    if (pos != std::string::npos)
+    {
+        exe = exe.substr(pos + 1);
+    }
+
+    LongPoll longPoll(collection.Changes());
+
+    System::Net::Http::HttpListener listener;
+
+    listener.Prefixes().push_back(listenUrl);
+    listener.SetMaxConnections(int(std::max(maxConnections, 1L)));
+    listener.SetMaxRequestBodySize(size_t(std::max(maxBodyBytes, 0L)));
+    listener.SetRequestReadTimeout(std::chrono::milliseconds(std::max(readTimeoutMs, 1L)));
+
+    try
+    {
+        listener.Start();
+
+        runningListener = &listener;
+        ShutdownSignal::Install(StopServer);
+
+        Router router;
+
+        // Monitoring and point lookups are high priority, they are cheap and tell whether the server is overloaded
+        router.Get(
+            "/quit",
+            [&listener](
+                const System::Net::Http::HttpListenerRequest &request,
+                System::Net::Http::HttpListenerResponse &response,
+                const std::pmr::cmatch &matches) {
+                RouteQuit(request, response, matches);
+                listener.Stop();
+            },
+            AdmissionControl::Priorities::High);
+        router.Get("/metrics", RouteMetrics, AdmissionControl::Priorities::High);
+        router.Get("/_stats/latency", RouteLatencyStats);
+        router.Post("/_stats/latency/reset", RouteLatencyStatsReset);
+        router.Get("/_stats/sqlite", RouteSqliteStats);
+        router.Get("/_ready", RouteReady, AdmissionControl::Priorities::High);
+        router.Get("/asr.exe", RouteHelp);
+        router.Get("/",
+                   [&dbFile, &collection](
+                       const System::Net::Http::HttpListenerRequest &request,
+                       System::Net::Http::HttpListenerResponse &response,
+                       const std::pmr::cmatch &matches) {
+                       RouteRoot(dbFile, collection, request, response, matches);
+                   });
+        // The version is optional, /api/v2/Posts serves Posts_v2 and /api/Posts the latest version of Posts
+        router.Get(R"(/api/(?:v([0-9]+)/)?([\w\-]+)$)",
+                   [&collection, &longPoll](
+                       const System::Net::Http::HttpListenerRequest &request,
+                       System::Net::Http::HttpListenerResponse &response,
+                       const std::pmr::cmatch &matches) {
+                       RouteGetAllApi(collection, longPoll, request, response, matches);
+                   });
+        router.Get(R"(/api/(?:v([0-9]+)/)?([\w\-]+)/\$count$)",
+                   [&collection](
+                       const System::Net::Http::HttpListenerRequest &request,
+                       System::Net::Http::HttpListenerResponse &response,
+                       const std::pmr::cmatch &matches) {
+                       RouteCountApi(collection, request, response, matches);
+                   });
+        // Server-sent events for every row changed through this server, resumable with Last-Event-ID
+        router.Get(
+            R"(/api/(?:v([0-9]+)/)?([\w\-]+)/changes$)",
+            [&collection](
+                const System::Net::Http::HttpListenerRequest &request,
+                System::Net::Http::HttpListenerResponse &response,
+                const std::pmr::cmatch &matches) {
+                RouteChangesApi(collection, request, response, matches);
+            },
+            AdmissionControl::Priorities::High);
+        router.Get(
+            R"(/api/(?:v([0-9]+)/)?([\w\-]+)/([\w\-]+)$)",
+            [&collection](
+                const System::Net::Http::HttpListenerRequest &request,
+                System::Net::Http::HttpListenerResponse &response,
+                const std::pmr::cmatch &matches) {
+                RouteGetByIdApi(collection, request, response, matches);
+            },
+            AdmissionControl::Priorities::High);
+        router.Post(R"(/api/(?:v([0-9]+)/)?([\w\-]+)$)",
+                    [&collection](
+                        const System::Net::Http::HttpListenerRequest &request,
+                        System::Net::Http::HttpListenerResponse &response,
+                        const std::pmr::cmatch &matches) {
+                        RoutePostApi(collection, request, response, matches);
+                    });
+
+        router.Get("/styles.css",
+                   [](
+                       const System::Net::Http::HttpListenerRequest &request,
+                       System::Net::Http::HttpListenerResponse &response,
+                       const std::pmr::cmatch &matches) {
+                       RouteStatic(HTDOCS_STYLES, "text/css", request, response, matches);
+                   });
+
+        router.Get("/scripts.js",
+                   [](
+                       const System::Net::Http::HttpListenerRequest &request,
+                       System::Net::Http::HttpListenerResponse &response,
+                       const std::pmr::cmatch &matches) {
+                       RouteStatic(HTDOCS_SCRIPTS, "text/javascript", request, response, matches);
+                   });
+
+        auto notFoundRoute = RouteEntry{std::regex(), RouteHandler(), Metrics::RegisterRoute("not found"), LatencyHistograms::Get("routes", "not found"), AdmissionControl::Priorities::High};
+
+        auto queueWait = LatencyHistograms::Get("admission", "queue wait");
+
+        AdmissionControl admission(size_t(std::max(workers, 1L)), size_t(std::max(maxQueued, 0L)));
+
+        std::unique_ptr<RateLimiter> rateLimiter;
+        if (rateLimit > 0)
+        {
+            rateLimiter = std::make_unique<RateLimiter>(rateLimit, rateBurst > 0 ? rateBurst : 2 * std::max(rateLimit, ScanCost));
+        }
+
+        // Runs a request on a worker, or with an answer the rest of a request that waited in the long poll
+        std::function<void(std::shared_ptr<PendingRequest> const &, LongPoll::Answer const &)> handle;
+
+        // Rate limits and queues a request for the workers, or refuses it right away with 429 or 503
+        auto dispatch = [&](std::shared_ptr<PendingRequest> const &pending, bool limit, LongPoll::Answer answer) {
+            auto &request = *(pending->context->Request());
+            auto &response = *(pending->context->Response());
+
+            // A request for nothing is a cheap 404
+            auto priority = pending->route != nullptr ? pending->route->priority : AdmissionControl::Priorities::High;
+
+            // Point lookups and full scans are limited in buckets of their own, monitoring is not limited
+            std::chrono::seconds retryAfter(0);
+            auto limited = limit &&
+                           rateLimiter != nullptr &&
+                           request.Path().substr(0, 5) == "/api/" &&
+                           !rateLimiter->Take(
+                               request.ipAddress(),
+                               priority == AdmissionControl::Priorities::High ? 0 : 1,
+                               priority == AdmissionControl::Priorities::High ? 1.0 : ScanCost,
+                               retryAfter);
+
+            auto resumed = bool(answer);
+            if (!limited && admission.Admit(priority, [&handle, pending, answer = std::move(answer)]() { handle(pending, answer); }))
+            {
+                return;
+            }
+
+            // Refusing is answered here, it is cheaper than any request that would have to wait
+            InstrumentationTimer timer(request.RawUrl(), resumed ? pending->started : std::chrono::steady_clock::now());
+            timer.SetMethod(request.HttpMethod());
+
+            if (limited)
+            {
+                TooManyRequests(retryAfter, request, response);
+                Metrics::Add(Metrics::RateLimited, 1);
+            }
+            else
+            {
+                ServiceUnavailable(request, response);
+                Metrics::Add(Metrics::AdmissionRejected, 1);
+            }
+
+            timer.SetRoute(pending->route != nullptr ? pending->route->metricsRoute : notFoundRoute.metricsRoute);
+            timer.SetStatusCode(response.StatusCode());
+            timer.SetBytes(request._payload.size(), response.OutputLength());
+        };
+
+        handle = [&longPoll, &notFoundRoute, queueWait, &dispatch](std::shared_ptr<PendingRequest> const &pending, LongPoll::Answer const &answer) {
+            auto &request = *(pending->context->Request());
+            auto &response = *(pending->context->Response());
+
+            if (!answer)
+            {
+                pending->started = std::chrono::steady_clock::now();
+                queueWait->Record(std::chrono::duration_cast<std::chrono::microseconds>(pending->started - pending->accepted));
+            }
+
+            // A request answered after a long poll is timed from its start, the wait is part of its latency
+            InstrumentationTimer timer(request.RawUrl(), pending->started);
+            timer.SetMethod(request.HttpMethod());
+
+            // Stops the queries of the request when they run out of time, or the client left
+            QueryBudget budget(QueryTimeout(request), [&response]() {
+                return response.IsClientConnected();
+            });
+
+            auto route = pending->route != nullptr ? pending->route : &notFoundRoute;
+
+            // A failing handler costs its own request only, it is answered with what it had not sent yet dropped
+            try
+            {
+                if (answer)
+                {
+                    answer();
+                }
+                else if (pending->route != nullptr)
+                {
+                    route->handler(request, response, pending->matches);
+                }
+                else
+                {
+                    NotFoundError(request, response, pending->matches);
+                }
+            }
+            catch (nlohmann::json::parse_error const &ex)
+            {
+                HandlerFailed(400, ex.what(), request, response);
+            }
+            catch (std::exception const &ex)
+            {
+                HandlerFailed(500, ex.what(), request, response);
+            }
+            catch (...)
+            {
+                HandlerFailed(500, "unknown error", request, response);
+            }
+
+            // A parked request is recorded when it is answered, the long poll owns the context from here and
+            // hands the answer back to the workers, a changed table is a new query and counts against the rate limit
+            if (longPoll.Parking())
+            {
+                timer.Stop();
+                longPoll.Adopt(pending, [&dispatch, pending](LongPoll::Results result, LongPoll::Answer answer) {
+                    dispatch(pending, result == LongPoll::Results::Changed, std::move(answer));
+                });
+                return;
+            }
+
+            timer.SetRoute(route->metricsRoute);
+            timer.SetHistogram(route->latency);
+            timer.SetStatusCode(response.StatusCode());
+            timer.SetBytes(request._payload.size(), response.OutputLength());
+            timer.Stop();
+        };
+
+        auto accept = [&]() {
+            try
+            {
+                while (keepServerRunning)
+                {
+                    auto context = std::unique_ptr<System::Net::Http::HttpListenerContext>(
+                        listener.GetContext());
+
+                    if (context == nullptr)
+                    {
+                        break;
+                    }
+
+                    auto pending = std::make_shared<PendingRequest>(std::move(context));
+
+                    pending->route = router.Match(*(pending->context->Request()), pending->matches);
+
+                    dispatch(pending, true, nullptr);
+                }
+            }
+            catch (System::Net::Http::HttpListenerException const *ex)
+            {
+                // GetContext drops the connections that fail, this is the listening socket failing
+                std::cout << "Exception in http listener: " << ex->Message() << "\n";
+                StopServer();
+            }
+        };
+
+        // The threads share the listening socket and read a request each, so one slow client does not hold up the others
+        std::vector<std::thread> acceptors;
+        for (long i = 0; i < std::max(acceptThreads, 1L); i++)
+        {
+            acceptors.push_back(std::thread(accept));
+        }
+
+        for (auto &acceptor : acceptors)
+        {
+            acceptor.join();
+        }
+
+        // Nothing new is accepted, the requests that got in are finished before the database closes
+        listener.Stop();
+        runningListener = nullptr;
+
+        if (!admission.Drain(std::chrono::steady_clock::now() + std::chrono::seconds(std::max(shutdownTimeoutSeconds, 0L))))
+        {
+            std::cout << "Requests still running after " << shutdownTimeoutSeconds << "s, stopping their queries" << std::endl;
+            QueryBudget::SetShuttingDown(true);
+        }
+
+        admission.Stop();
+        longPoll.Stop();
+    }
+    catch (System::Net::Http::HttpListenerException const *ex)
+    {
+        std::cout << "Exception in http listener: " << ex->Message() << "\n";
+    }
+
+    Warmup::Stop();
+
+    // Saved on every run, so the first run with --warmup already knows which tables are hot
+    if (!warmupStatsFile.empty())
+    {
+        Warmup::SaveAccessStats(warmupStatsFile, Warmup::AccessCounts());
+    }
+
+    AccessLog::Close();
+    SlowQueryLog::Close();
+
+    if (!traceFile.empty() && !Tracing::WriteFile(traceFile))
+    {
+        std::cout << "Could not write trace to " << traceFile << std::endl;
+    }
+
+    return 0;
+}
+
+std::string Header()
+{
+    std::stringstream ss;
+
+    ss << "<!doctype html>"
+       << "<html lang=\"en\">"
+       << "<head>"
+       << "<title>Auto Sqlite Rest</title>"
+       << "<meta charset=\"utf-8\">"
+       << "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1, shrink-to-fit=no\">"
+       << "<script type=\"text/javascript\" src=\"scripts.js\" defer></script>"
+       << "<link rel=\"stylesheet\" href=\"styles.css\" />"
+       << "<link rel=\"preconnect\" href=\"https://fonts.googleapis.com\">"
+       << "<link rel=\"preconnect\" href=\"https://fonts.gstatic.com\" crossorigin>"
+       << "<link href=\"https://fonts.googleapis.com/css2?family=Prompt:wght@300&family=Ubuntu+Mono&display=swap\" rel=\"stylesheet\">"
+       << "<link rel=\"icon\" type=\"image/svg+xml\" href=\"data:image/svg+xml;utf8,<svg xmlns=&quot;http://www.w3.org/2000/svg&quot; width=&quot;16&quot; height=&quot;16&quot; fill=&quot;currentColor&quot; class=&quot;bi bi-code-slash&quot; viewBox=&quot;0 0 16 16&quot;><path d=&quot;M10.478 1.647a.5.5 0 1 0-.956-.294l-4 13a.5.5 0 0 0 .956.294l4-13zM4.854 4.146a.5.5 0 0 1 0 .708L1.707 8l3.147 3.146a.5.5 0 0 1-.708.708l-3.5-3.5a.5.5 0 0 1 0-.708l3.5-3.5a.5.5 0 0 1 .708 0zm6.292 0a.5.5 0 0 0 0 .708L14.293 8l-3.147 3.146a.5.5 0 0 0 .708.708l3.5-3.5a.5.5 0 0 0 0-.708l-3.5-3.5a.5.5 0 0 0-.708 0z&quot;/></svg>\">"
+       << "</head>"
+       << "<body>"
+       << "<a href=\"/" << exe << "\" class=\"header-button float-end\">"
+       << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"24\" height=\"24\" fill=\"currentColor\" class=\"bi bi-question-circle-fill\" viewBox=\"0 0 16 16\"><path d=\"M16 8A8 8 0 1 1 0 8a8 8 0 0 1 16 0zM5.496 6.033h.825c.138 0 .248-.113.266-.25.09-.656.54-1.134 1.342-1.134.686 0 1.314.343 1.314 1.168 0 .635-.374.927-.965 1.371-.673.489-1.206 1.06-1.168 1.987l.003.217a.25.25 0 0 0 .25.246h.811a.25.25 0 0 0 .25-.25v-.105c0-.718.273-.927 1.01-1.486.609-.463 1.244-.977 1.244-2.056 0-1.511-1.276-2.241-2.673-2.241-1.267 0-2.655.59-2.75 2.286a.237.237 0 0 0 .241.247zm2.325 6.443c.61 0 1.029-.394 1.029-.927 0-.552-.42-.94-1.029-.94-.584 0-1.009.388-1.009.94 0 .533.425.927 1.01.927z\"/></svg>"
+       << "</a>"
+       << "<h1>"
+       << "    <a href=\"/\">Auto Sqlite Rest <small>v" << ASR_VERSION << "</small></a>"
+       << "</h1>";
+
+    return ss.str();
+}
+
+std::string Footer()
+{
+    std::stringstream ss;
+
+    ss << "</body>"
+       << "</html>";
+
+    return ss.str();
+}
+
+void Ok(
+    std::string_view content,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response)
+{
+    (void)request;
+
+    response.SetStatusCode(200);
+    response.WriteOutput(content);
+    response.CloseOutput();
+}
+
+void Ok(
+    std::pmr::string &&content,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response)
+{
+    (void)request;
+
+    response.SetStatusCode(200);
+    response.WriteOutput(std::move(content));
+    response.CloseOutput();
+}
+
+void NoContent(
+    System::Net::Http::HttpListenerResponse &response)
+{
+    response.SetStatusCode(204);
+    response.CloseOutput();
+}
+
+void ServiceUnavailable(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response)
+{
+    (void)request;
+
+    response.Headers().insert(std::make_pair("Retry-After", "1"));
+    response.SetStatusCode(503);
+    response.WriteOutput("the server is busy, try again later");
+    response.CloseOutput();
+}
+
+void TooManyRequests(
+    std::chrono::seconds retryAfter,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response)
+{
+    (void)request;
+
+    response.Headers().insert(std::make_pair("Retry-After", std::to_string(retryAfter.count())));
+    response.SetStatusCode(429);
+    response.WriteOutput("too many requests, try again later");
+    response.CloseOutput();
+}
+
+void NotModified(
+    uint64_t version,
+    System::Net::Http::HttpListenerResponse &response)
+{
+    response.Headers().insert(std::make_pair("X-Table-Version", std::to_string(version)));
+    response.SetStatusCode(304);
+    response.CloseOutput();
+}
+
+void RouteStatic(
+    std::string_view content,
+    const std::string &contentType,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches)
+{
+    (void)request;
+    (void)matches;
+
+    response.Headers().insert(std::make_pair("Content-Type", contentType));
+
+    // static content is compiled in, so it can be send without copying it into the response
+    response.SetStatusCode(200);
+    response.WriteStaticOutput(content.data(), content.size());
+    response.CloseOutput();
+}
+
+void RouteHelp(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches)
+{
+    (void)matches;
+
+    std::stringstream ss;
+
+    ss << Header()
+       << "<h2>Help page</h1>"
+       << "<div class=\"container\">"
+       << "<ul class=\"nav justify-content-end\"><li class=\"nav-item\"><a class=\"nav-link\" aria-current=\"page\" href=\"/quit\">Stop server</a></li></ul>"
+       << "<div class=\"block\"><pre>" << showHelp(exe, true) << "</pre></div>"
+       << "</div>"
+       << "</body>"
+       << "</html>";
+
+    Ok(ss.str(), request, response);
 }
 
-void ParseQuery(
-    System::Net::Http::HttpListenerRequest const *request,
-    const DataQuery &query)
+void RouteQuit(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches)
 {
-    (void)request;
-    (void)query;
-}
+    (void)matches;
 
-namespace fs = std::filesystem;
+    std::stringstream ss;
 
-void RouteStatic(
-    const std::string &content,
-    const std::string &contentType,
-    const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches);
+    ss << "<!doctype html>"
+       << "<html lang=\"en\">"
+       << "<head>"
+       << "<title>Auto Sqlite Rest</title>"
+       << "<meta charset=\"utf-8\">"
+       << "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1, shrink-to-fit=no\">"
+       << "<link rel=\"icon\" type=\"image/svg+xml\" href=\"data:image/svg+xml;utf8,<svg xmlns=&quot;http://www.w3.org/2000/svg&quot; width=&quot;16&quot; height=&quot;16&quot; fill=&quot;currentColor&quot; class=&quot;bi bi-code-slash&quot; viewBox=&quot;0 0 16 16&quot;><path d=&quot;M10.478 1.647a.5.5 0 1 0-.956-.294l-4 13a.5.5 0 0 0 .956.294l4-13zM4.854 4.146a.5.5 0 0 1 0 .708L1.707 8l3.147 3.146a.5.5 0 0 1-.708.708l-3.5-3.5a.5.5 0 0 1 0-.708l3.5-3.5a.5.5 0 0 1 .708 0zm6.292 0a.5.5 0 0 0 0 .708L14.293 8l-3.147 3.146a.5.5 0 0 0 .708.708l3.5-3.5a.5.5 0 0 0 0-.708l-3.5-3.5a.5.5 0 0 0-.708 0z&quot;/></svg>\">"
+       << "</head>"
+       << "<body>"
+       << "<h2>Ok, i quit</h2>"
+       << "</body>"
+       << "</html>";
 
-void RouteHelp(
-    const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches);
+    Ok(ss.str(), request, response);
 
-void RouteQuit(
-    const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches);
+    keepServerRunning = false;
+}
 
-void RouteGetAllApi(
-    const DataCollection &collection,
+void RouteMetrics(
     const System::Net::Http::HttpListenerRequest &request,
     System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches);
+    const std::pmr::cmatch &matches)
+{
+    (void)matches;
 
-void RouteGetByIdApi(
-    const DataCollection &collection,
-    const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches);
+    std::pmr::string data(request.Arena());
 
-void RoutePostApi(
-    const DataCollection &collection,
-    const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches);
+    Metrics::Scrape(data);
 
-void RouteRoot(
-    const char *dbFile,
-    const DataCollection &collection,
+    response.Headers().insert(std::make_pair("Content-Type", "text/plain; version=0.0.4"));
+
+    Ok(std::move(data), request, response);
+}
+
+void RouteLatencyStats(
     const System::Net::Http::HttpListenerRequest &request,
     System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches);
+    const std::pmr::cmatch &matches)
+{
+    (void)matches;
 
-void BadRequest(
-    std::string const &err,
-    const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response);
+    std::pmr::string data(request.Arena());
+    JsonWriter writer(data);
 
-void InternalServerError(
-    std::string const &err,
-    const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response);
+    LatencyHistograms::Write(writer);
 
-void NotFoundError(
+    response.Headers().insert(std::make_pair("Content-Type", "application/json"));
+
+    Ok(std::move(data), request, response);
+}
+
+void RouteLatencyStatsReset(
     const System::Net::Http::HttpListenerRequest &request,
     System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches);
+    const std::pmr::cmatch &matches)
+{
+    (void)request;
+    (void)matches;
 
-std::string showHelp(
-    std::string const &exe,
-    bool showOptions);
+    LatencyHistograms::Reset();
 
-typedef std::function<void(const System::Net::Http::HttpListenerRequest &request, System::Net::Http::HttpListenerResponse &response, const std::smatch &matches)> RouteHandler;
-typedef std::vector<std::pair<std::regex, RouteHandler>> RouteCollection;
+    NoContent(response);
+}
 
-class Router
+void RouteSqliteStats(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches)
 {
-public:
-    void Get(
-        const std::string &pattern,
-        RouteHandler handler);
-
-    void Post(
-        const std::string &pattern,
-        RouteHandler handler);
+    (void)matches;
 
-    bool Route(
-        const System::Net::Http::HttpListenerRequest &request,
-        System::Net::Http::HttpListenerResponse &response);
+    std::pmr::string data(request.Arena());
+    JsonWriter writer(data);
 
-private:
-    RouteCollection _getRoutes;
-    RouteCollection _postRoutes;
-    RouteCollection _putRoutes;
-};
+    SqliteStats::Write(writer);
 
-void Router::Get(
-    const std::string &pattern,
-    RouteHandler handler)
-{
-    auto r = std::regex(pattern);
+    response.Headers().insert(std::make_pair("Content-Type", "application/json"));
 
-    _getRoutes.push_back(std::make_pair(std::move(r), handler));
+    Ok(std::move(data), request, response);
 }
 
-void Router::Post(
-    const std::string &pattern,
-    RouteHandler handler)
+void RouteReady(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches)
 {
-    auto r = std::regex(pattern);
+    (void)matches;
+
+    std::pmr::string data(request.Arena());
+    JsonWriter writer(data);
+
+    Warmup::Write(writer);
+
+    response.Headers().insert(std::make_pair("Content-Type", "application/json"));
+
+    if (!Warmup::IsReady())
+    {
+        response.SetStatusCode(503);
+        response.SetStatusDescription("Service Unavailable");
+        response.WriteOutput(std::move(data));
+        response.CloseOutput();
+        return;
+    }
 
-    _postRoutes.push_back(std::make_pair(std::move(r), handler));
+    Ok(std::move(data), request, response);
 }
 
-bool Router::Route(
+DataTable const *FindTable(
+    const Schema &schema,
     const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response)
+    const std::pmr::cmatch &matches)
 {
-    if (request.HttpMethod() == "GET")
+    // Without a version in the url the Accept-Version header picks one, like "2" or "v2", otherwise the latest is served
+    std::string_view versionText;
+
+    if (matches[1].matched)
     {
-        for (auto &route : _getRoutes)
+        versionText = std::string_view(matches[1].first, size_t(matches[1].length()));
+    }
+    else
+    {
+        auto header = request.Headers().find("Accept-Version");
+        if (header != request.Headers().end())
         {
-            std::smatch matches;
-            if (!std::regex_match(request.RawUrl(), matches, route.first))
+            versionText = header->second;
+            if (!versionText.empty() && (versionText.front() == 'v' || versionText.front() == 'V'))
             {
-                continue;
+                versionText.remove_prefix(1);
             }
+        }
+    }
 
-            route.second(request, response, matches);
+    int version = 0;
 
-            return true;
+    if (!versionText.empty())
+    {
+        auto result = std::from_chars(versionText.data(), versionText.data() + versionText.size(), version);
+        if (result.ec != std::errc() || result.ptr != versionText.data() + versionText.size() || version <= 0)
+        {
+            return nullptr;
         }
     }
 
-    else if (request.HttpMethod() == "POST")
+    auto found = schema.Find(std::string_view(matches[2].first, size_t(matches[2].length())), version);
+
+    // Every use counts for the warm-up of the next run
+    if (found != nullptr)
     {
-        for (auto &route : _postRoutes)
-        {
-            std::smatch matches;
-            if (!std::regex_match(request.RawUrl(), matches, route.first))
-            {
-                continue;
-            }
+        found->CountAccess();
+    }
 
-            route.second(request, response, matches);
+    return found;
+}
 
-            return true;
+bool SelectColumns(
+    const DataTable &table,
+    const System::Net::Http::HttpListenerRequest &request,
+    std::string &columns,
+    std::string &error)
+{
+    auto select = request.QueryString().find("$select");
+    if (select == request.QueryString().end() || select->second.empty())
+    {
+        columns = "*";
+        return true;
+    }
+
+    columns.clear();
+
+    auto list = select->second;
+    while (!list.empty())
+    {
+        auto comma = list.find(',');
+        auto column = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+        while (!column.empty() && column.front() == ' ') column.remove_prefix(1);
+        while (!column.empty() && column.back() == ' ') column.remove_suffix(1);
+
+        // Only known columns get into the sql
+        if (table.Columns().find(std::string(column)) == table.Columns().end())
+        {
+            error = fmt::format("unknown column '{0}' in $select", column);
+            return false;
+        }
+
+        if (!columns.empty())
+        {
+            columns += ',';
         }
+        columns += SqlQuote(column);
     }
 
-    return false;
-}
+    if (columns.empty())
+    {
+        columns = "*";
+    }
 
-bool keepServerRunning = true;
+    return true;
+}
 
-int main(
-    int argc,
-    char *argv[])
+bool ExpandRelations(
+    const DataTable &table,
+    const System::Net::Http::HttpListenerRequest &request,
+    std::vector<Relation const *> &expand,
+    std::string &columns,
+    std::string &error)
 {
-    if (argc == 1)
+    auto found = request.QueryString().find("$expand");
+    if (found == request.QueryString().end())
     {
-        showHelp(argv[0], false);
+        return true;
     }
 
-    std::string listenUrl = "http://localhost:8888/";
-    const char *dbFile = nullptr;
-
-    for (int i = 0; i < argc; ++i)
+    auto list = found->second;
+    while (!list.empty())
     {
-        if (std::string(argv[i]) == "--help" || std::string(argv[i]) == "-h")
+        auto comma = list.find(',');
+        auto name = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+        while (!name.empty() && name.front() == ' ') name.remove_prefix(1);
+        while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+
+        if (name.empty())
         {
-            std::cout << showHelp(argv[0], true);
-            return 0;
+            continue;
         }
-        else if (std::string(argv[i]) == "--listen-url" && ++i < argc)
+
+        auto relation = table.FindRelation(name);
+        if (relation == nullptr)
         {
-            listenUrl = argv[i];
+            error = fmt::format("unknown relation '{0}' in $expand", name);
+            return false;
         }
-        else
+
+        if (std::find(expand.begin(), expand.end(), relation) != expand.end())
         {
-            dbFile = argv[i];
+            continue;
+        }
+
+        expand.push_back(relation);
+
+        // The related rows are matched on this column, so it has to be selected
+        auto quoted = SqlQuote(relation->column);
+        if (columns != "*" && ("," + columns + ",").find("," + quoted + ",") == std::string::npos)
+        {
+            columns += ',';
+            columns += quoted;
         }
     }
 
-    DataCollection collection(dbFile);
+    return true;
+}
 
-    exe = std::string(argv[0]);
-    auto pos = exe.find_last_of('\\');
-    if (pos != std::string::npos)
+void RouteGetAllApi(
+    const DataCollection &collection,
+    LongPoll &longPoll,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches)
+{
+    auto schema = collection.CurrentSchema();
+
+    auto found = FindTable(*schema, request, matches);
+
+    if (found == nullptr)
     {
-        exe = exe.substr(pos + 1);
+        NotFoundError(request, response, matches);
+        return;
     }
 
-    System::Net::Http::HttpListener listener;
+    // The version of a table is the id of its last change event, clients send it back as since. Only writes made
+    // through this server move it, a long poll does not see what other programs write until its wait is over
+    auto version = collection.Changes().TableVersion(found->RawName());
 
-    listener.Prefixes().push_back(listenUrl);
+    auto since = request.QueryString().find("since");
+    auto wait = request.QueryString().find("wait");
 
-    try
+    if (since == request.QueryString().end() && wait == request.QueryString().end())
     {
-        listener.Start();
+        response.Headers().insert(std::make_pair("X-Table-Version", std::to_string(version)));
+        RouteRowsApi(collection, *found, request, response);
+        return;
+    }
 
-        Router router;
+    // Without since the request waits for the next change
+    auto sinceVersion = version;
+    if (since != request.QueryString().end())
+    {
+        auto text = since->second;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), sinceVersion);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size())
+        {
+            BadRequest("since must be a table version", request, response);
+            return;
+        }
+    }
 
-        router.Get("/quit", RouteQuit);
-        router.Get("/asr.exe", RouteHelp);
-        router.Get("/",
-                   [&dbFile, &collection](
-                       const System::Net::Http::HttpListenerRequest &request,
-                       System::Net::Http::HttpListenerResponse &response,
-                       const std::smatch &matches) {
-                       RouteRoot(dbFile, collection, request, response, matches);
-                   });
-        router.Get(R"(/api/([\w\-]+)$)",
-                   [&collection](
-                       const System::Net::Http::HttpListenerRequest &request,
-                       System::Net::Http::HttpListenerResponse &response,
-                       const std::smatch &matches) {
-                       RouteGetAllApi(collection, request, response, matches);
-                   });
-        router.Get(R"(/api/([\w\-]+)/([\w\-]+)$)",
-                   [&collection](
-                       const System::Net::Http::HttpListenerRequest &request,
-                       System::Net::Http::HttpListenerResponse &response,
-                       const std::smatch &matches) {
-                       RouteGetByIdApi(collection, request, response, matches);
-                   });
-        router.Post(R"(/api/([\w\-]+)$)",
-                    [&collection](
-                        const System::Net::Http::HttpListenerRequest &request,
-                        System::Net::Http::HttpListenerResponse &response,
-                        const std::smatch &matches) {
-                        RoutePostApi(collection, request, response, matches);
-                    });
+    // Without wait a request with since is a conditional get
+    auto waitTime = std::chrono::milliseconds(0);
+    if (wait != request.QueryString().end() && !LongPoll::ParseWait(wait->second, waitTime))
+    {
+        BadRequest("wait must be a time like 30s or 500ms", request, response);
+        return;
+    }
 
-        router.Get("/styles.css",
-                   [](
-                       const System::Net::Http::HttpListenerRequest &request,
-                       System::Net::Http::HttpListenerResponse &response,
-                       const std::smatch &matches) {
-                       RouteStatic(HTDOCS_STYLES, "text/css", request, response, matches);
-                   });
+    if (version != sinceVersion)
+    {
+        response.Headers().insert(std::make_pair("X-Table-Version", std::to_string(version)));
+        RouteRowsApi(collection, *found, request, response);
+        return;
+    }
 
-        router.Get("/scripts.js",
-                   [](
-                       const System::Net::Http::HttpListenerRequest &request,
-                       System::Net::Http::HttpListenerResponse &response,
-                       const std::smatch &matches) {
-                       RouteStatic(HTDOCS_SCRIPTS, "text/javascript", request, response, matches);
-                   });
+    if (waitTime.count() == 0)
+    {
+        NotModified(version, response);
+        return;
+    }
+
+    // The schema is kept alive with the request, the table it points to could be replaced meanwhile
+    longPoll.Park(
+        found->RawName(),
+        sinceVersion,
+        waitTime,
+        [&collection, schema, found, &request, &response](LongPoll::Results result) {
+            auto current = collection.Changes().TableVersion(found->RawName());
+
+            switch (result)
+            {
+                case LongPoll::Results::Changed:
+                    response.Headers().insert(std::make_pair("X-Table-Version", std::to_string(current)));
+                    RouteRowsApi(collection, *found, request, response);
+                    break;
+                case LongPoll::Results::TimedOut:
+                    NotModified(current, response);
+                    break;
+                case LongPoll::Results::Stopped:
+                    response.SetStatusCode(503);
+                    response.CloseOutput();
+                    break;
+            }
+        });
+}
 
-        while (keepServerRunning)
-        {
-            auto context = std::unique_ptr<System::Net::Http::HttpListenerContext>(
-                listener.GetContext());
+void RouteRowsApi(
+    const DataCollection &collection,
+    const DataTable &table,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response)
+{
+    auto apply = request.QueryString().find("$apply");
+    if (apply != request.QueryString().end())
+    {
+        RouteApplyApi(collection, table, apply->second, request, response);
+        return;
+    }
 
-            InstrumentationTimer timer(context.get()->Request()->RawUrl().c_str());
+    auto search = request.QueryString().find("$search");
+    if (search != request.QueryString().end())
+    {
+        RouteSearchApi(collection, table, search->second, request, response);
+        return;
+    }
 
-            if (router.Route(*(context->Request()), *(context->Response())))
-            {
-                continue;
-            }
+    std::string columns, error;
+    std::vector<Relation const *> expand;
+    if (!SelectColumns(table, request, columns, error) || !ExpandRelations(table, request, expand, columns, error))
+    {
+        BadRequest(error, request, response);
+        return;
+    }
 
-            NotFoundError(*(context->Request()), *(context->Response()), std::smatch());
-        }
+    std::pmr::string data(request.Arena());
+    JsonWriter writer(data);
 
-        listener.Stop();
+    {
+        InstrumentationTimer timer(table.RawName(), table.Latency());
+
+        timer.AddRows(collection.get(table, columns, expand, writer));
     }
-    catch (System::Net::Http::HttpListenerException const *ex)
+
+    if (QueryStopped(request, response))
     {
-        std::cout << "Exception in http listener: " << ex->Message() << "\n";
+        return;
     }
 
-    return 0;
+    response.Headers().insert(std::make_pair("Content-Type", "application/json"));
+
+    Ok(std::move(data), request, response);
 }
 
-std::string Header()
+void RouteGetByIdApi(
+    const DataCollection &collection,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response,
+    const std::pmr::cmatch &matches)
 {
-    std::stringstream ss;
+    (void)matches;
 
-    ss << "<!doctype html>"
-       << "<html lang=\"en\">"
-       << "<head>"
-       << "<title>Auto Sqlite Rest</title>"
-       << "<meta charset=\"utf-8\">"
-       << "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1, shrink-to-fit=no\">"
-       << "<script type=\"text/javascript\" src=\"scripts.js\" defer></script>"
-       << "<link rel=\"stylesheet\" href=\"styles.css\" />"
-       << "<link rel=\"preconnect\" href=\"https://fonts.googleapis.com\">"
-       << "<link rel=\"preconnect\" href=\"https://fonts.gstatic.com\" crossorigin>"
-       << "<link href=\"https://fonts.googleapis.com/css2?family=Prompt:wght@300&family=Ubuntu+Mono&display=swap\" rel=\"stylesheet\">"
-       << "<link rel=\"icon\" type=\"image/svg+xml\" href=\"data:image/svg+xml;utf8,<svg xmlns=&quot;http://www.w3.org/2000/svg&quot; width=&quot;16&quot; height=&quot;16&quot; fill=&quot;currentColor&quot; class=&quot;bi bi-code-slash&quot; viewBox=&quot;0 0 16 16&quot;><path d=&quot;M10.478 1.647a.5.5 0 1 0-.956-.294l-4 13a.5.5 0 0 0 .956.294l4-13zM4.854 4.146a.5.5 0 0 1 0 .708L1.707 8l3.147 3.146a.5.5 0 0 1-.708.708l-3.5-3.5a.5.5 0 0 1 0-.708l3.5-3.5a.5.5 0 0 1 .708 0zm6.292 0a.5.5 0 0 0 0 .708L14.293 8l-3.147 3.146a.5.5 0 0 0 .708.708l3.5-3.5a.5.5 0 0 0 0-.708l-3.5-3.5a.5.5 0 0 0-.708 0z&quot;/></svg>\">"
-       << "</head>"
-       << "<body>"
-       << "<a href=\"/" << exe << "\" class=\"header-button float-end\">"
-       << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"24\" height=\"24\" fill=\"currentColor\" class=\"bi bi-question-circle-fill\" viewBox=\"0 0 16 16\"><path d=\"M16 8A8 8 0 1 1 0 8a8 8 0 0 1 16 0zM5.496 6.033h.825c.138 0 .248-.113.266-.25.09-.656.54-1.134 1.342-1.134.686 0 1.314.343 1.314 1.168 0 .635-.374.927-.965 1.371-.673.489-1.206 1.06-1.168 1.987l.003.217a.25.25 0 0 0 .25.246h.811a.25.25 0 0 0 .25-.25v-.105c0-.718.273-.927 1.01-1.486.609-.463 1.244-.977 1.244-2.056 0-1.511-1.276-2.241-2.673-2.241-1.267 0-2.655.59-2.75 2.286a.237.237 0 0 0 .241.247zm2.325 6.443c.61 0 1.029-.394 1.029-.927 0-.552-.42-.94-1.029-.94-.584 0-1.009.388-1.009.94 0 .533.425.927 1.01.927z\"/></svg>"
-       << "</a>"
-       << "<h1>"
-       << "    <a href=\"/\">Auto Sqlite Rest <small>v" << ASR_VERSION << "</small></a>"
-       << "</h1>";
+    auto schema = collection.CurrentSchema();
 
-    return ss.str();
-}
+    auto found = FindTable(*schema, request, matches);
 
-std::string Footer()
-{
-    std::stringstream ss;
+    if (found == nullptr)
+    {
+        NotFoundError(request, response, matches);
+        return;
+    }
 
-    ss << "</body>"
-       << "</html>";
+    std::string columns, error;
+    std::vector<Relation const *> expand;
+    if (!SelectColumns(*found, request, columns, error) || !ExpandRelations(*found, request, expand, columns, error))
+    {
+        BadRequest(error, request, response);
+        return;
+    }
 
-    return ss.str();
+    std::pmr::string data(request.Arena());
+    JsonWriter writer(data);
+
+    InstrumentationTimer timer(found->RawName(), found->Latency());
+
+    auto exists = collection.get(*found, columns, matches[3], expand, writer);
+
+    timer.AddRows(exists ? 1 : 0);
+    timer.Stop();
+
+    if (QueryStopped(request, response))
+    {
+        return;
+    }
+
+    if (!exists)
+    {
+        NotFoundError(request, response, matches);
+        return;
+    }
+
+    response.Headers().insert(std::make_pair("Content-Type", "application/json"));
+
+    Ok(std::move(data), request, response);
 }
 
-void Ok(
-    std::string const &content,
+void RouteApplyApi(
+    const DataCollection &collection,
+    const DataTable &table,
+    std::string_view apply,
     const System::Net::Http::HttpListenerRequest &request,
     System::Net::Http::HttpListenerResponse &response)
 {
-    (void)request;
+    // The result has its own columns, so selecting or expanding them means nothing
+    if (request.QueryString().find("$select") != request.QueryString().end() ||
+        request.QueryString().find("$expand") != request.QueryString().end())
+    {
+        BadRequest("$select and $expand can not be combined with $apply", request, response);
+        return;
+    }
 
-    response.SetStatusCode(200);
-    response.WriteOutput(content);
-    response.CloseOutput();
-}
+    std::string sql, error;
+    if (!ApplyQuery::Compile(table, apply, sql, error))
+    {
+        BadRequest(error, request, response);
+        return;
+    }
 
-void NoContent(
-    System::Net::Http::HttpListenerResponse &response)
-{
-    response.SetStatusCode(204);
-    response.CloseOutput();
+    std::pmr::string data(request.Arena());
+    JsonWriter writer(data);
+
+    {
+        InstrumentationTimer timer(table.RawName(), table.Latency());
+
+        timer.AddRows(collection.apply(sql, writer));
+    }
+
+    if (QueryStopped(request, response))
+    {
+        return;
+    }
+
+    response.Headers().insert(std::make_pair("Content-Type", "application/json"));
+
+    Ok(std::move(data), request, response);
 }
 
-void RouteStatic(
-    const std::string &content,
-    const std::string &contentType,
+// Reads a whole non-negative number, like $top=20.
+bool QueryNumber(
     const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches)
+    std::string_view name,
+    long long &value,
+    std::string &error)
 {
-    (void)request;
-    (void)matches;
+    auto found = request.QueryString().find(name);
+    if (found == request.QueryString().end())
+    {
+        return true;
+    }
 
-    response.Headers().insert(std::make_pair("Content-Type", contentType));
+    auto text = found->second;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec != std::errc() || result.ptr != text.data() + text.size() || value < 0)
+    {
+        error = fmt::format("{0} must be a whole number of 0 or more", name);
+        return false;
+    }
 
-    Ok(content, request, response);
+    return true;
 }
 
-void RouteHelp(
+void RouteSearchApi(
+    const DataCollection &collection,
+    const DataTable &table,
+    std::string_view search,
     const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches)
+    System::Net::Http::HttpListenerResponse &response)
 {
-    (void)matches;
+    long long top = -1, skip = 0;
+
+    std::string columns, error;
+    std::vector<Relation const *> expand;
+    if (!SelectColumns(table, request, columns, error) ||
+        !ExpandRelations(table, request, expand, columns, error) ||
+        !QueryNumber(request, "$top", top, error) ||
+        !QueryNumber(request, "$skip", skip, error))
+    {
+        BadRequest(error, request, response);
+        return;
+    }
 
-    std::stringstream ss;
+    if (FullTextSearch::MatchExpression(search).empty())
+    {
+        BadRequest("$search needs at least one word", request, response);
+        return;
+    }
 
-    ss << Header()
-       << "<h2>Help page</h1>"
-       << "<div class=\"container\">"
-       << "<ul class=\"nav justify-content-end\"><li class=\"nav-item\"><a class=\"nav-link\" aria-current=\"page\" href=\"/quit\">Stop server</a></li></ul>"
-       << "<div class=\"block\"><pre>" << showHelp(exe, true) << "</pre></div>"
-       << "</div>"
-       << "</body>"
-       << "</html>";
+    std::pmr::string data(request.Arena());
+    JsonWriter writer(data);
 
-    Ok(ss.str(), request, response);
-}
+    InstrumentationTimer timer(table.RawName(), table.Latency());
 
-void RouteQuit(
-    const System::Net::Http::HttpListenerRequest &request,
-    System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches)
-{
-    (void)matches;
+    size_t count = 0;
+    auto searchable = collection.search(table, columns, expand, search, top, skip, writer, count);
 
-    std::stringstream ss;
+    timer.AddRows(count);
+    timer.Stop();
 
-    ss << "<!doctype html>"
-       << "<html lang=\"en\">"
-       << "<head>"
-       << "<title>Auto Sqlite Rest</title>"
-       << "<meta charset=\"utf-8\">"
-       << "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1, shrink-to-fit=no\">"
-       << "<link rel=\"icon\" type=\"image/svg+xml\" href=\"data:image/svg+xml;utf8,<svg xmlns=&quot;http://www.w3.org/2000/svg&quot; width=&quot;16&quot; height=&quot;16&quot; fill=&quot;currentColor&quot; class=&quot;bi bi-code-slash&quot; viewBox=&quot;0 0 16 16&quot;><path d=&quot;M10.478 1.647a.5.5 0 1 0-.956-.294l-4 13a.5.5 0 0 0 .956.294l4-13zM4.854 4.146a.5.5 0 0 1 0 .708L1.707 8l3.147 3.146a.5.5 0 0 1-.708.708l-3.5-3.5a.5.5 0 0 1 0-.708l3.5-3.5a.5.5 0 0 1 .708 0zm6.292 0a.5.5 0 0 0 0 .708L14.293 8l-3.147 3.146a.5.5 0 0 0 .708.708l3.5-3.5a.5.5 0 0 0 0-.708l-3.5-3.5a.5.5 0 0 0-.708 0z&quot;/></svg>\">"
-       << "</head>"
-       << "<body>"
-       << "<h2>Ok, i quit</h2>"
-       << "</body>"
-       << "</html>";
+    if (QueryStopped(request, response))
+    {
+        return;
+    }
 
-    Ok(ss.str(), request, response);
+    if (!searchable)
+    {
+        BadRequest(fmt::format("{0} has no full-text index, start asr with --fts {0}(COLUMN,...)", table.RawName()), request, response);
+        return;
+    }
 
-    keepServerRunning = false;
+    response.Headers().insert(std::make_pair("Content-Type", "application/json"));
+
+    Ok(std::move(data), request, response);
 }
 
-void RouteGetAllApi(
+// Sends change events over a detached response.
+class StreamChangeSink : public ChangeSink
+{
+    std::unique_ptr<System::Net::Http::HttpListenerStream> _stream;
+
+public:
+    explicit StreamChangeSink(
+        std::unique_ptr<System::Net::Http::HttpListenerStream> stream)
+        : _stream(std::move(stream))
+    {}
+
+    bool Ready() override
+    {
+        return _stream->IsWritable();
+    }
+
+    bool Write(
+        std::string_view events) override
+    {
+        return _stream->Write(events);
+    }
+};
+
+void RouteChangesApi(
     const DataCollection &collection,
     const System::Net::Http::HttpListenerRequest &request,
     System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches)
+    const std::pmr::cmatch &matches)
 {
-    (void)collection;
-    (void)matches;
+    auto schema = collection.CurrentSchema();
 
-    auto found = std::find_if(
-        collection.Tables().begin(),
-        collection.Tables().end(),
-        [&matches](const DataTable &table) {
-            return table.Name() == matches[1];
-        });
+    auto found = FindTable(*schema, request, matches);
 
-    if (found == collection.Tables().end())
+    if (found == nullptr)
     {
         NotFoundError(request, response, matches);
         return;
     }
 
-    auto data = collection.get(*found);
+    // EventSource sends the header when it reconnects, lastEventId is for clients that can not set headers
+    std::string_view resume;
 
-    response.Headers().insert(std::make_pair("Content-Type", "application/json"));
+    auto header = request.Headers().find("Last-Event-ID");
+    if (header != request.Headers().end())
+    {
+        resume = header->second;
+    }
+    else if (request.QueryString().find("lastEventId") != request.QueryString().end())
+    {
+        resume = request.QueryString().find("lastEventId")->second;
+    }
+
+    uint64_t lastEventId = 0;
+
+    if (!resume.empty())
+    {
+        auto result = std::from_chars(resume.data(), resume.data() + resume.size(), lastEventId);
+        if (result.ec != std::errc() || result.ptr != resume.data() + resume.size())
+        {
+            BadRequest("Last-Event-ID must be an event id", request, response);
+            return;
+        }
+    }
+
+    response.SetStatusCode(200);
+    response.Headers().insert(std::make_pair("Content-Type", "text/event-stream"));
+    response.Headers().insert(std::make_pair("Cache-Control", "no-cache"));
+    response.WriteOutput("retry: 2000\n\n");
 
-    Ok(data.dump(4), request, response);
+    collection.Changes().Subscribe(found->RawName(), std::make_unique<StreamChangeSink>(response.Detach()), lastEventId);
 }
 
-void RouteGetByIdApi(
+void RouteCountApi(
     const DataCollection &collection,
     const System::Net::Http::HttpListenerRequest &request,
     System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches)
+    const std::pmr::cmatch &matches)
 {
-    (void)matches;
+    auto schema = collection.CurrentSchema();
 
-    auto found = std::find_if(
-        collection.Tables().begin(),
-        collection.Tables().end(),
-        [&matches](const DataTable &table) {
-            return table.Name() == matches[1];
-        });
+    auto found = FindTable(*schema, request, matches);
 
-    if (found == collection.Tables().end())
+    if (found == nullptr)
     {
         NotFoundError(request, response, matches);
         return;
     }
 
-    auto data = collection.get(*found, matches[2]);
+    InstrumentationTimer timer(found->RawName(), found->Latency());
+
+    auto count = collection.count(*found);
+
+    timer.AddRows(1);
+    timer.Stop();
 
-    if (data.empty())
+    if (QueryStopped(request, response))
     {
-        NotFoundError(request, response, matches);
         return;
     }
 
-    response.Headers().insert(std::make_pair("Content-Type", "application/json"));
+    if (count < 0)
+    {
+        InternalServerError(fmt::format("could not count {0}", found->Name()), request, response);
+        return;
+    }
+
+    response.Headers().insert(std::make_pair("Content-Type", "text/plain"));
 
-    Ok(data.dump(4), request, response);
+    Ok(std::pmr::string(std::to_string(count), request.Arena()), request, response);
 }
 
 void RoutePostApi(
     const DataCollection &collection,
     const System::Net::Http::HttpListenerRequest &request,
     System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches)
+    const std::pmr::cmatch &matches)
 {
-    auto found = std::find_if(
-        collection.Tables().begin(),
-        collection.Tables().end(),
-        [&matches](const DataTable &table) {
-            return table.Name() == matches[1];
-        });
+    auto schema = collection.CurrentSchema();
+
+    auto found = FindTable(*schema, request, matches);
 
-    if (found == collection.Tables().end())
+    if (found == nullptr)
     {
         NotFoundError(request, response, matches);
         return;
     }
 
+    InstrumentationTimer parseSpan("json::parse");
+
     auto jsonData = nlohmann::json::parse(request._payload.begin(), request._payload.end());
 
+    parseSpan.Stop();
+
+    InstrumentationTimer timer(found->RawName(), found->Latency());
+
     auto result = collection.post(*found, jsonData);
+    auto failed = result.count("error") > 0;
+
+    timer.AddRows(failed ? 0 : 1);
+    timer.Stop();
 
-    std::cout << result.dump(4) << std::endl;
-    if (result.count("error") > 0)
+    if (failed)
     {
         BadRequest(result["error"].get<std::string>(), request, response);
+        return;
     }
 
     NoContent(response);
@@ -945,7 +2783,7 @@ void RouteRoot(
     const DataCollection &collection,
     const System::Net::Http::HttpListenerRequest &request,
     System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches)
+    const std::pmr::cmatch &matches)
 {
     (void)matches;
 
@@ -959,7 +2797,9 @@ void RouteRoot(
     ss << "<div class=\"container\">"
        << "<ul class=\"nav justify-content-end\"><li class=\"nav-item\"><button type=\"button\" class=\"nav-link\" data-open-modal=\"AddContenModal\">Add content</buttons></li></ul>";
 
-    for (auto &table : collection.Tables())
+    auto schema = collection.CurrentSchema();
+
+    for (auto &table : schema->Tables())
     {
         if (table.PrimaryKey().empty())
         {
@@ -991,6 +2831,68 @@ void BadRequest(
     response.CloseOutput();
 }
 
+// Answers instead of a handler that threw, unless it already sent its response.
+void HandlerFailed(
+    int statusCode,
+    std::string const &err,
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response)
+{
+    Metrics::Add(Metrics::HandlerErrors, 1);
+
+    if (response.IsOutputClosed())
+    {
+        return;
+    }
+
+    response.ClearOutput();
+    response.Headers().clear();
+
+    if (statusCode == 400)
+    {
+        BadRequest(err, request, response);
+    }
+    else
+    {
+        InternalServerError(err, request, response);
+    }
+}
+
+// Answers instead of the handler when the budget of the request stopped its queries, what they wrote is incomplete.
+bool QueryStopped(
+    const System::Net::Http::HttpListenerRequest &request,
+    System::Net::Http::HttpListenerResponse &response)
+{
+    (void)request;
+
+    auto budget = QueryBudget::Current();
+    if (budget == nullptr || budget->Reason() == QueryBudget::Reasons::None)
+    {
+        return false;
+    }
+
+    if (budget->Reason() == QueryBudget::Reasons::TimedOut)
+    {
+        response.SetStatusCode(503);
+        response.WriteOutput(fmt::format("the query took longer than {0}ms", budget->Timeout().count()));
+        response.CloseOutput();
+        return true;
+    }
+
+    if (budget->Reason() == QueryBudget::Reasons::ShuttingDown)
+    {
+        response.SetStatusCode(503);
+        response.WriteOutput("the server is shutting down");
+        response.CloseOutput();
+        return true;
+    }
+
+    // Nobody reads the answer, 499 is what proxies log for a client that closed the request
+    response.SetStatusCode(499);
+    response.CloseOutput();
+    return true;
+}
+
 void InternalServerError(
     std::string const &err,
     const System::Net::Http::HttpListenerRequest &request,
@@ -1021,7 +2923,7 @@ void InternalServerError(
 void NotFoundError(
     const System::Net::Http::HttpListenerRequest &request,
     System::Net::Http::HttpListenerResponse &response,
-    const std::smatch &matches)
+    const std::pmr::cmatch &matches)
 {
     (void)request;
     (void)matches;
@@ -1047,7 +2949,71 @@ void NotFoundError(
 
 static const char zOptions[] =
     "   --listen-url URL     set the url for the http server to listen to\n"
-    "                        (default http://localhost:8888/)\n";
+    "                        (default http://localhost:8888/)\n"
+    "   --access-log FILE    append a json line per request to FILE, written\n"
+    "                        by a background thread\n"
+    "   --trace-file FILE    write spans of all requests to FILE on exit, in\n"
+    "                        the chrome trace event format (for Perfetto)\n"
+    "   --slow-query-ms MS   log statements that run at least MS milliseconds,\n"
+    "                        with their sql, parameters and query plan\n"
+    "   --slow-query-log FILE  append slow statements to FILE as json lines\n"
+    "                        (default stderr, threshold 100ms when only this\n"
+    "                        option is given)\n"
+    "   --sqlite-profile P   tune sqlite for read-heavy, write-heavy or custom\n"
+    "                        use (default leaves the sqlite defaults)\n"
+    "   --journal-mode M     PRAGMA journal_mode, like WAL (overrides the profile)\n"
+    "   --synchronous S      PRAGMA synchronous, like NORMAL\n"
+    "   --cache-size N       PRAGMA cache_size, pages or -KiB\n"
+    "   --mmap-size BYTES    PRAGMA mmap_size\n"
+    "   --temp-store S       PRAGMA temp_store, like MEMORY\n"
+    "   --busy-timeout MS    wait up to MS milliseconds on a locked database\n"
+    "   --warmup             map the whole database and read the tables used most\n"
+    "                        in the previous run in the background, /_ready\n"
+    "                        answers 503 until this finished. The mapping has\n"
+    "                        room for twice the file size unless --mmap-size\n"
+    "                        is given\n"
+    "   --warmup-tables T,T  warm up these tables instead of the most used ones\n"
+    "   --warmup-stats FILE  where table usage is kept between runs, it is updated\n"
+    "                        on every run\n"
+    "                        (default FILENAME.warmup)\n"
+    "   --warmup-deadline S  report ready after S seconds even when the warm-up\n"
+    "                        did not finish (default 30)\n"
+    "   --schema-snapshot FILE  load the tables from FILE when the schema did not\n"
+    "                        change since it was written, and write it otherwise\n"
+    "   --schema-poll-ms MS  check for schema changes every MS milliseconds and\n"
+    "                        reload the tables without a restart (default 1000,\n"
+    "                        0 turns it off)\n"
+    "   --query-timeout MS   stop the queries of a request after MS milliseconds\n"
+    "                        and answer 503, a request can ask for less with\n"
+    "                        X-Query-Timeout: MS (default no limit)\n"
+    "   --workers N          handle N requests at the same time (default 4)\n"
+    "   --max-queued N       let at most N requests wait for a worker, more are\n"
+    "                        refused with 503 and Retry-After (default 64). The\n"
+    "                        last quarter is kept for point lookups\n"
+    "   --max-connections N  connections waiting to be accepted (default 50)\n"
+    "   --max-body BYTES     refuse request bodies larger than BYTES with 413,\n"
+    "                        request heads over 16KiB are refused with 431\n"
+    "                        (default 8MiB)\n"
+    "   --read-timeout MS    close connections that take longer than MS\n"
+    "                        milliseconds to send their request, requests are\n"
+    "                        read before they queue for a worker (default 10000)\n"
+    "   --accept-threads N   accept connections and read their requests on N\n"
+    "                        threads, all on the one listening socket (default 1)\n"
+    "   --shutdown-timeout S  on SIGTERM, /quit or ctrl-c let the requests that\n"
+    "                        were accepted finish for up to S seconds, then stop\n"
+    "                        their queries with 503 (default 30). Windows ends\n"
+    "                        the process 5 to 20 seconds after the console is\n"
+    "                        closed, or on logoff and system shutdown\n"
+    "   --rate-limit N       let every client ip do N point lookups a second,\n"
+    "                        a full scan counts as 10, more are refused with 429\n"
+    "                        and Retry-After (default no limit)\n"
+    "   --rate-burst N       how many a client can do at once before the rate\n"
+    "                        limit applies (default twice the limit, at least 20)\n"
+    "   --fts T(C,...)       keep an fts5 index over columns C of table T, so\n"
+    "                        /api/T?$search=words finds rows ranked by bm25,\n"
+    "                        a page at a time with $top and $skip. Triggers\n"
+    "                        keep it in sync, so other programs that write to\n"
+    "                        T need sqlite with fts5 too\n";
 
 std::string showHelp(
     std::string const &exe,
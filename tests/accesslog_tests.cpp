@@ -0,0 +1,118 @@
+#include "../src/common/accesslog.h"
+#include "../src/common/metrics.h"
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    std::string ReadFile(
+        std::filesystem::path const &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream ss;
+
+        ss << file.rdbuf();
+
+        return ss.str();
+    }
+
+    // The value of a counter without labels in the scraped metrics
+    long long ScrapeCounter(
+        std::string const &name)
+    {
+        std::pmr::string output;
+        Metrics::Scrape(output);
+
+        auto found = output.find("\n" + name + " ");
+        REQUIRE(found != std::pmr::string::npos);
+
+        return std::stoll(std::string(output.substr(found + name.size() + 2, 20)));
+    }
+
+    AccessLogRecord MakeRecord(
+        std::string_view method,
+        std::string_view path,
+        int statusCode)
+    {
+        AccessLogRecord record{};
+
+        record.timestampMicros = 1700000000123456;
+        record.SetMethod(method);
+        record.SetPath(path);
+        record.statusCode = statusCode;
+        record.latencyMicros = 1500;
+        record.bytesIn = 12;
+        record.bytesOut = 345;
+        record.rows = 6;
+
+        return record;
+    }
+} // namespace
+
+TEST_CASE("AccessLog writes records as json lines", "[accesslog]")
+{
+    auto path = std::filesystem::temp_directory_path() / "asr_accesslog_tests.log";
+    std::filesystem::remove(path);
+
+    REQUIRE_FALSE(AccessLog::IsOpen());
+    REQUIRE(AccessLog::Open(path.string()));
+    REQUIRE(AccessLog::IsOpen());
+
+    AccessLog::Write(MakeRecord("GET", "/odata/Posts?$top=10", 200));
+    AccessLog::Write(MakeRecord("POST", std::string(200, 'p'), 400));
+
+    AccessLog::Close();
+    REQUIRE_FALSE(AccessLog::IsOpen());
+
+    auto text = ReadFile(path);
+    std::filesystem::remove(path);
+
+    REQUIRE(std::count(text.begin(), text.end(), '\n') == 2);
+
+    auto first = text.substr(0, text.find('\n'));
+    REQUIRE(first == R"({"ts":"2023-11-14T22:13:20.123456Z","method":"GET","path":"/odata/Posts?$top=10","status":200,)"
+                     R"("bytes_in":12,"bytes_out":345,"latency_us":1500,"rows":6})");
+
+    // Paths longer than the record are cut off
+    auto second = text.substr(first.size() + 1);
+    REQUIRE(second.find(R"("method":"POST","path":")" + std::string(111, 'p') + R"(","status":400,)") != std::string::npos);
+}
+
+TEST_CASE("AccessLog counts the records it drops when the ring is full", "[accesslog]")
+{
+    auto path = std::filesystem::temp_directory_path() / "asr_accesslog_drop_tests.log";
+    std::filesystem::remove(path);
+
+    auto droppedBefore = AccessLog::Dropped();
+    auto metricBefore = ScrapeCounter("asr_access_log_dropped_total");
+
+    REQUIRE(AccessLog::Open(path.string(), 2));
+
+    // The writer drains the ring every 20ms at most, so most of these find it full
+    const uint64_t count = 10000;
+    auto record = MakeRecord("GET", "/odata/Posts", 200);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        AccessLog::Write(record);
+    }
+
+    AccessLog::Close();
+
+    auto text = ReadFile(path);
+    std::filesystem::remove(path);
+
+    auto dropped = AccessLog::Dropped() - droppedBefore;
+    auto written = uint64_t(std::count(text.begin(), text.end(), '\n'));
+
+    REQUIRE(dropped > 0);
+    REQUIRE(written > 0);
+    REQUIRE(dropped + written == count);
+    REQUIRE(ScrapeCounter("asr_access_log_dropped_total") - metricBefore == (long long)dropped);
+
+    // Writing to a closed log is a no-op, not a drop
+    AccessLog::Write(record);
+    REQUIRE(AccessLog::Dropped() - droppedBefore == dropped);
+}
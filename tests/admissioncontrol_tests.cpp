@@ -0,0 +1,157 @@
+#include "../src/common/admissioncontrol.h"
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // Keeps the workers busy until it is opened
+    struct Gate
+    {
+        std::mutex mutex;
+        std::condition_variable opened;
+        bool open = false;
+        std::atomic<int> waiting{0};
+
+        void Wait()
+        {
+            waiting++;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            opened.wait(lock, [this]() { return open; });
+        }
+
+        void Open()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                open = true;
+            }
+
+            opened.notify_all();
+        }
+    };
+
+    void WaitForWorkers(
+        Gate &gate,
+        int count)
+    {
+        for (int i = 0; i < 500 && gate.waiting < count; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        REQUIRE(gate.waiting == count);
+    }
+} // namespace
+
+TEST_CASE("AdmissionControl refuses work when the workers are busy and the queue is full", "[admissioncontrol]")
+{
+    Gate gate;
+    std::atomic<int> done{0};
+
+    AdmissionControl admission(2, 4);
+
+    for (int i = 0; i < 2; i++)
+    {
+        REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, [&]() { gate.Wait(); done++; }));
+    }
+
+    WaitForWorkers(gate, 2);
+    REQUIRE(admission.InFlight() == 2);
+
+    // Three normal requests fit, the fourth place is kept for high priority work
+    for (int i = 0; i < 3; i++)
+    {
+        REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, [&]() { done++; }));
+    }
+
+    REQUIRE(!admission.Admit(AdmissionControl::Priorities::Normal, [&]() { done++; }));
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::High, [&]() { done++; }));
+    REQUIRE(!admission.Admit(AdmissionControl::Priorities::High, [&]() { done++; }));
+    REQUIRE(admission.Queued() == 4);
+
+    gate.Open();
+    admission.Stop();
+
+    REQUIRE(done == 6);
+    REQUIRE(admission.Queued() == 0);
+    REQUIRE(!admission.Admit(AdmissionControl::Priorities::High, [&]() { done++; }));
+}
+
+TEST_CASE("AdmissionControl runs high priority work first", "[admissioncontrol]")
+{
+    Gate gate;
+    std::mutex mutex;
+    std::string order;
+
+    AdmissionControl admission(1, 8);
+
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, [&]() { gate.Wait(); }));
+    WaitForWorkers(gate, 1);
+
+    auto append = [&](char c) {
+        return [&, c]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            order += c;
+        };
+    };
+
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, append('a')));
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::High, append('B')));
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, append('c')));
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::High, append('D')));
+
+    gate.Open();
+    admission.Stop();
+
+    REQUIRE(order == "BDac");
+}
+
+TEST_CASE("AdmissionControl without a queue only takes work for an idle worker", "[admissioncontrol]")
+{
+    Gate gate;
+
+    AdmissionControl admission(1, 0);
+
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, [&]() { gate.Wait(); }));
+    WaitForWorkers(gate, 1);
+
+    REQUIRE(!admission.Admit(AdmissionControl::Priorities::High, []() {}));
+
+    gate.Open();
+}
+
+TEST_CASE("AdmissionControl drains the queued work up to a deadline", "[admissioncontrol]")
+{
+    Gate gate;
+    std::atomic<int> done{0};
+
+    AdmissionControl admission(1, 4);
+
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, [&]() { gate.Wait(); done++; }));
+    WaitForWorkers(gate, 1);
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, [&]() { done++; }));
+
+    REQUIRE(!admission.Drain(std::chrono::steady_clock::now() + std::chrono::milliseconds(20)));
+    REQUIRE(!admission.Admit(AdmissionControl::Priorities::High, [&]() { done++; }));
+
+    gate.Open();
+
+    REQUIRE(admission.Drain(std::chrono::steady_clock::now() + std::chrono::seconds(5)));
+    REQUIRE(done == 2);
+}
+
+TEST_CASE("AdmissionControl keeps its worker when work throws", "[admissioncontrol]")
+{
+    AdmissionControl admission(1, 4);
+
+    std::atomic<int> done{0};
+
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, []() { throw std::runtime_error("handler failed"); }));
+    REQUIRE(admission.Admit(AdmissionControl::Priorities::Normal, [&done]() { done++; }));
+
+    REQUIRE(admission.Drain(std::chrono::steady_clock::now() + std::chrono::seconds(5)));
+    REQUIRE(done == 1);
+}
@@ -0,0 +1,72 @@
+#include "../src/common/applyquery.h"
+#include <catch2/catch.hpp>
+
+namespace
+{
+    DataTable ExampleTable()
+    {
+        DataTable orders("Orders_v1");
+        orders.AddColumn("Id", ColumnTypes::Integer);
+        orders.AddColumn("Category", ColumnTypes::Text);
+        orders.AddColumn("Region", ColumnTypes::Text);
+        orders.AddColumn("Price", ColumnTypes::Real);
+
+        return orders;
+    }
+} // namespace
+
+TEST_CASE("ApplyQuery compiles both groupby forms to the same select", "[applyquery]")
+{
+    std::string nested, sequence, error;
+
+    REQUIRE(ApplyQuery::Compile(ExampleTable(), "groupby((Category,Region),aggregate(Price with sum as Total,$count as Count))", nested, error));
+    REQUIRE(ApplyQuery::Compile(ExampleTable(), "groupby(Category, Region)/aggregate(Price with sum as Total, $count as Count)", sequence, error));
+
+    REQUIRE(nested == "select \"Category\",\"Region\",sum(\"Price\") as \"Total\",count(*) as \"Count\" from \"Orders_v1\" group by \"Category\",\"Region\";");
+    REQUIRE(sequence == nested);
+}
+
+TEST_CASE("ApplyQuery compiles aggregates without groupby and names them without an alias", "[applyquery]")
+{
+    std::string sql, error;
+
+    REQUIRE(ApplyQuery::Compile(ExampleTable(), "aggregate(Price with average,Price with min as Lowest,Category with countdistinct)", sql, error));
+    REQUIRE(sql == "select avg(\"Price\") as \"Price_average\",min(\"Price\") as \"Lowest\",count(distinct \"Category\") as \"Category_countdistinct\" from \"Orders_v1\";");
+
+    REQUIRE(ApplyQuery::Compile(ExampleTable(), "groupby(Region)", sql, error));
+    REQUIRE(sql == "select \"Region\" from \"Orders_v1\" group by \"Region\";");
+}
+
+TEST_CASE("ApplyQuery rejects unknown columns, methods and aliases that are not plain names", "[applyquery]")
+{
+    std::string sql, error;
+
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "groupby(Nope)", sql, error));
+    REQUIRE(error == "unknown column 'Nope' in $apply");
+
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "aggregate(Price with median)", sql, error));
+    REQUIRE(error == "unknown aggregate method 'median' in $apply");
+
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "aggregate(Price with sum as \"x\";drop)", sql, error));
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "aggregate($count as Category)/groupby(Category)", sql, error));
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "groupby(Category)/groupby(Region)", sql, error));
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "groupby(Category) trailing", sql, error));
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "filter(Price gt 1)", sql, error));
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "", sql, error));
+}
+
+TEST_CASE("ApplyQuery rejects groupby after aggregate", "[applyquery]")
+{
+    std::string sql, error;
+
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "aggregate(Price with sum as Total)/groupby(Category)", sql, error));
+    REQUIRE(error == "groupby can not follow aggregate in $apply");
+
+    REQUIRE_FALSE(ApplyQuery::Compile(ExampleTable(), "aggregate($count as Count)/groupby((Region),aggregate(Price with max as Highest))", sql, error));
+    REQUIRE(error == "groupby can not follow aggregate in $apply");
+}
+
+TEST_CASE("ApplyQuery counts the rows of the raw table", "[applyquery]")
+{
+    REQUIRE(ApplyQuery::Count(ExampleTable()) == "select count(*) from \"Orders_v1\";");
+}
@@ -0,0 +1,196 @@
+#include "../src/common/changefeed.h"
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <sqlite3/sqlite3.h>
+
+namespace
+{
+    // Collects the events, and only takes them when the test lets it
+    struct Received
+    {
+        std::mutex mutex;
+        std::string events;
+        std::atomic<bool> ready{true};
+    };
+
+    class TestSink : public ChangeSink
+    {
+        std::shared_ptr<Received> _received;
+
+    public:
+        explicit TestSink(
+            std::shared_ptr<Received> received)
+            : _received(received)
+        {}
+
+        bool Ready() override
+        {
+            return _received->ready;
+        }
+
+        bool Write(
+            std::string_view events) override
+        {
+            std::lock_guard<std::mutex> lock(_received->mutex);
+            _received->events += events;
+            return true;
+        }
+    };
+
+    // Waits for the delivery thread until the events hold the text
+    bool WaitFor(
+        Received &received,
+        std::string const &text)
+    {
+        for (int i = 0; i < 200; i++)
+        {
+            {
+                std::lock_guard<std::mutex> lock(received.mutex);
+                if (received.events.find(text) != std::string::npos)
+                {
+                    return true;
+                }
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        return false;
+    }
+
+    size_t Count(
+        Received &received,
+        std::string const &text)
+    {
+        std::lock_guard<std::mutex> lock(received.mutex);
+
+        size_t count = 0;
+        for (auto position = received.events.find(text); position != std::string::npos; position = received.events.find(text, position + 1))
+        {
+            count++;
+        }
+
+        return count;
+    }
+
+    sqlite3 *OpenExample()
+    {
+        sqlite3 *db = nullptr;
+        REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+        REQUIRE(sqlite3_exec(db, "CREATE TABLE Posts_v1 (Id INTEGER PRIMARY KEY, Title TEXT); CREATE TABLE Tags (Name TEXT);", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+        return db;
+    }
+} // namespace
+
+TEST_CASE("ChangeFeed sends committed changes of the subscribed table", "[changefeed]")
+{
+    auto db = OpenExample();
+
+    ChangeFeed feed;
+    feed.Attach(db);
+
+    auto received = std::make_shared<Received>();
+    feed.Subscribe("posts_v1", std::make_unique<TestSink>(received), 0);
+
+    REQUIRE(sqlite3_exec(db, "BEGIN; INSERT INTO Posts_v1 VALUES (7, 'gone'); ROLLBACK;", nullptr, nullptr, nullptr) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(db, "INSERT INTO Tags VALUES ('other table');", nullptr, nullptr, nullptr) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(db, "INSERT INTO Posts_v1 VALUES (1, 'first');", nullptr, nullptr, nullptr) == SQLITE_OK);
+    REQUIRE(WaitFor(*received, "\"insert\""));
+
+    REQUIRE(sqlite3_exec(db, "DELETE FROM Posts_v1 WHERE Id = 1;", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    REQUIRE(WaitFor(*received, "\"delete\""));
+    REQUIRE(Count(*received, "event: change") == 2);
+    REQUIRE(Count(*received, "\"rowid\":7") == 0);
+
+    feed.Stop();
+    sqlite3_close(db);
+}
+
+TEST_CASE("ChangeFeed folds changes to one row while the client is not ready", "[changefeed]")
+{
+    auto db = OpenExample();
+
+    ChangeFeed feed;
+    feed.Attach(db);
+
+    auto received = std::make_shared<Received>();
+    received->ready = false;
+    feed.Subscribe("Posts_v1", std::make_unique<TestSink>(received), 0);
+
+    REQUIRE(sqlite3_exec(db,
+                         "INSERT INTO Posts_v1 VALUES (1, 'a');"
+                         "UPDATE Posts_v1 SET Title = 'b' WHERE Id = 1;"
+                         "UPDATE Posts_v1 SET Title = 'c' WHERE Id = 1;"
+                         "INSERT INTO Posts_v1 VALUES (2, 'd');",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    received->ready = true;
+
+    REQUIRE(WaitFor(*received, "\"rowid\":2"));
+    REQUIRE(Count(*received, "event: change") == 2);
+    REQUIRE(Count(*received, "{\"operation\":\"insert\",\"rowid\":1}") == 1);
+
+    // The events are in id order, the folded row comes before the row changed after it
+    REQUIRE(received->events.find("\"rowid\":1") < received->events.find("\"rowid\":2"));
+
+    feed.Stop();
+    sqlite3_close(db);
+}
+
+TEST_CASE("ChangeFeed resets a client that fell too far behind", "[changefeed]")
+{
+    auto db = OpenExample();
+
+    ChangeFeed feed;
+    feed.Attach(db);
+
+    auto received = std::make_shared<Received>();
+    received->ready = false;
+    feed.Subscribe("Posts_v1", std::make_unique<TestSink>(received), 0);
+
+    REQUIRE(sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK);
+    for (size_t i = 0; i <= ChangeFeed::MaxQueuedRows + 5; i++)
+    {
+        REQUIRE(sqlite3_exec(db, "INSERT INTO Posts_v1 (Title) VALUES ('row');", nullptr, nullptr, nullptr) == SQLITE_OK);
+    }
+    REQUIRE(sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    received->ready = true;
+
+    REQUIRE(WaitFor(*received, "event: reset"));
+    REQUIRE(Count(*received, "event: change") == 5);
+
+    feed.Stop();
+    sqlite3_close(db);
+}
+
+TEST_CASE("ChangeFeed resumes after the last event id", "[changefeed]")
+{
+    auto db = OpenExample();
+
+    ChangeFeed feed;
+    feed.Attach(db);
+
+    REQUIRE(sqlite3_exec(db, "INSERT INTO Posts_v1 VALUES (1, 'seen');", nullptr, nullptr, nullptr) == SQLITE_OK);
+    auto lastSeen = feed.LastEventId();
+    REQUIRE(sqlite3_exec(db, "INSERT INTO Posts_v1 VALUES (2, 'missed'); INSERT INTO Tags VALUES ('x');", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    auto resumed = std::make_shared<Received>();
+    feed.Subscribe("Posts_v1", std::make_unique<TestSink>(resumed), lastSeen);
+
+    REQUIRE(WaitFor(*resumed, "\"rowid\":2"));
+    REQUIRE(Count(*resumed, "event: change") == 1);
+
+    // An id the feed does not know, like one from long ago, gets a reset
+    auto unknown = std::make_shared<Received>();
+    feed.Subscribe("Posts_v1", std::make_unique<TestSink>(unknown), 12345);
+
+    REQUIRE(WaitFor(*unknown, "event: reset"));
+
+    REQUIRE(feed.SubscriberCount() == 2);
+
+    feed.Stop();
+    sqlite3_close(db);
+}
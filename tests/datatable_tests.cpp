@@ -0,0 +1,160 @@
+#include "../src/common/datatable.h"
+#include <catch2/catch.hpp>
+#include <sqlite3/sqlite3.h>
+
+TEST_CASE("DataTable splits the version from the raw name", "[datatable]")
+{
+    DataTable posts("Posts_v2");
+    REQUIRE(posts.RawName() == "Posts_v2");
+    REQUIRE(posts.Name() == "Posts");
+    REQUIRE(posts.Version() == 2);
+
+    DataTable underscores("blog_posts_v10");
+    REQUIRE(underscores.Name() == "blog_posts");
+    REQUIRE(underscores.Version() == 10);
+}
+
+TEST_CASE("DataTable keeps the raw name when there is no version suffix", "[datatable]")
+{
+    for (auto name : {"Posts", "Posts_v", "Posts_vx", "Posts_v1_old", "_v1"})
+    {
+        DataTable table(name);
+
+        REQUIRE(table.Name() == name);
+        REQUIRE(table.Version() == 1);
+    }
+}
+
+TEST_CASE("LoadTables loads all tables with their columns in one query", "[datatable]")
+{
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+
+    REQUIRE(sqlite3_exec(db,
+                         "CREATE TABLE Posts_v1 (Id INTEGER PRIMARY KEY, Title TEXT, Score REAL, Image Blob);"
+                         "CREATE TABLE Tags (Name NVARCHAR(50) PRIMARY KEY, Count NUMERIC);"
+                         "CREATE TABLE Comments_v3 (Id INTEGER PRIMARY KEY, Body TEXT);",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    auto tables = LoadTables(db);
+
+    sqlite3_close(db);
+
+    REQUIRE(tables.size() == 3);
+
+    REQUIRE(tables[0].Name() == "Posts");
+    REQUIRE(tables[0].PrimaryKey() == "Id");
+    REQUIRE(tables[0].Columns().size() == 4);
+    REQUIRE(tables[0].Columns().at("Title") == ColumnTypes::Text);
+    REQUIRE(tables[0].Columns().at("Score") == ColumnTypes::Real);
+    REQUIRE(tables[0].Columns().at("Image") == ColumnTypes::Blob);
+
+    REQUIRE(tables[1].Name() == "Tags");
+    REQUIRE(tables[1].PrimaryKey() == "Name");
+    REQUIRE(tables[1].Columns().at("Name") == ColumnTypes::Text);
+    REQUIRE(tables[1].Columns().at("Count") == ColumnTypes::Integer);
+
+    REQUIRE(tables[2].Name() == "Comments");
+    REQUIRE(tables[2].Version() == 3);
+    REQUIRE(tables[2].Columns().size() == 2);
+}
+
+TEST_CASE("LoadTables adds both sides of single column foreign keys as relations", "[datatable]")
+{
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+
+    REQUIRE(sqlite3_exec(db,
+                         "CREATE TABLE Authors_v1 (Id INTEGER PRIMARY KEY, Name TEXT);"
+                         "CREATE TABLE Posts_v1 (Id INTEGER PRIMARY KEY, AuthorId INTEGER REFERENCES authors_v1, Title TEXT);"
+                         "CREATE TABLE Posts_v2 (Id INTEGER PRIMARY KEY, AuthorId INTEGER REFERENCES Authors_v1(Id), Body TEXT);"
+                         "CREATE TABLE Tags (Post INTEGER, Version INTEGER, Name TEXT,"
+                         " FOREIGN KEY (Post, Version) REFERENCES Posts_v2 (Id, AuthorId));",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    auto tables = LoadTables(db);
+
+    sqlite3_close(db);
+
+    REQUIRE(tables.size() == 4);
+
+    auto authors = tables[0];
+    REQUIRE(authors.Relations().size() == 1);
+    auto posts = authors.FindRelation("Posts");
+    REQUIRE(posts != nullptr);
+    REQUIRE(posts->table == "Posts_v2");
+    REQUIRE(posts->column == "Id");
+    REQUIRE(posts->relatedColumn == "AuthorId");
+    REQUIRE(posts->many);
+
+    auto author = tables[1].FindRelation("Authors");
+    REQUIRE(author != nullptr);
+    REQUIRE(author->table == "Authors_v1");
+    REQUIRE(author->column == "AuthorId");
+    REQUIRE(author->relatedColumn == "Id");
+    REQUIRE_FALSE(author->many);
+
+    REQUIRE(tables[2].Relations().size() == 1);
+    REQUIRE(tables[3].Relations().empty());
+    REQUIRE(tables[3].FindRelation("Posts") == nullptr);
+}
+
+TEST_CASE("LoadTables names relations by their column when a table has more keys to the same table", "[datatable]")
+{
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+
+    REQUIRE(sqlite3_exec(db,
+                         "CREATE TABLE Users (Id INTEGER PRIMARY KEY, Name TEXT);"
+                         "CREATE TABLE Posts (Id INTEGER PRIMARY KEY, AuthorId INTEGER REFERENCES Users, EditorId INTEGER REFERENCES Users(Id));"
+                         "CREATE TABLE Categories (Id INTEGER PRIMARY KEY, ParentId INTEGER REFERENCES Categories);",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    auto tables = LoadTables(db);
+
+    sqlite3_close(db);
+
+    REQUIRE(tables.size() == 3);
+
+    auto &users = tables[0];
+    REQUIRE(users.Relations().size() == 2);
+    REQUIRE(users.FindRelation("Posts") == nullptr);
+
+    auto authored = users.FindRelation("Posts_AuthorId");
+    REQUIRE(authored != nullptr);
+    REQUIRE(authored->relatedColumn == "AuthorId");
+    REQUIRE(authored->many);
+
+    auto edited = users.FindRelation("Posts_EditorId");
+    REQUIRE(edited != nullptr);
+    REQUIRE(edited->relatedColumn == "EditorId");
+
+    auto &posts = tables[1];
+    REQUIRE(posts.Relations().size() == 2);
+
+    auto author = posts.FindRelation("AuthorId");
+    REQUIRE(author != nullptr);
+    REQUIRE(author->table == "Users");
+    REQUIRE(author->column == "AuthorId");
+    REQUIRE_FALSE(author->many);
+
+    auto editor = posts.FindRelation("EditorId");
+    REQUIRE(editor != nullptr);
+    REQUIRE(editor->column == "EditorId");
+
+    // A key to its own table gives the table both sides, the parent and the children
+    auto &categories = tables[2];
+    REQUIRE(categories.Relations().size() == 2);
+
+    auto parent = categories.FindRelation("ParentId");
+    REQUIRE(parent != nullptr);
+    REQUIRE(parent->column == "ParentId");
+    REQUIRE(parent->relatedColumn == "Id");
+    REQUIRE_FALSE(parent->many);
+
+    auto children = categories.FindRelation("Categories_ParentId");
+    REQUIRE(children != nullptr);
+    REQUIRE(children->column == "Id");
+    REQUIRE(children->relatedColumn == "ParentId");
+    REQUIRE(children->many);
+}
@@ -0,0 +1,104 @@
+#include "../src/common/datatable.h"
+#include "../src/common/fulltextsearch.h"
+#include <catch2/catch.hpp>
+#include <sqlite3/sqlite3.h>
+
+namespace
+{
+    // Returns the ids of the matching posts, best match first
+    std::vector<int> Search(
+        sqlite3 *db,
+        FullTextIndex const &index,
+        std::string const &search)
+    {
+        std::vector<int> ids;
+
+        sqlite3_stmt *stmt = nullptr;
+        REQUIRE(sqlite3_prepare_v2(db, FullTextSearch::Sql(index, "\"Id\"").c_str(), -1, &stmt, nullptr) == SQLITE_OK);
+
+        auto match = FullTextSearch::MatchExpression(search);
+        sqlite3_bind_text(stmt, 1, match.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, -1);
+        sqlite3_bind_int64(stmt, 3, 0);
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            ids.push_back(sqlite3_column_int(stmt, 0));
+        }
+
+        REQUIRE(sqlite3_finalize(stmt) == SQLITE_OK);
+
+        return ids;
+    }
+} // namespace
+
+TEST_CASE("FullTextSearch parses the table and its columns", "[fulltextsearch]")
+{
+    FullTextIndex index;
+
+    REQUIRE(FullTextSearch::Parse("Posts_v1(Title, Body)", index));
+    REQUIRE(index.table == "Posts_v1");
+    REQUIRE(index.columns == std::vector<std::string>{"Title", "Body"});
+    REQUIRE(index.Name() == "Posts_v1_fts");
+
+    REQUIRE_FALSE(FullTextSearch::Parse("Posts_v1", index));
+    REQUIRE_FALSE(FullTextSearch::Parse("Posts_v1()", index));
+    REQUIRE_FALSE(FullTextSearch::Parse("(Title)", index));
+    REQUIRE_FALSE(FullTextSearch::Parse("Posts_v1(Title,)", index));
+}
+
+TEST_CASE("FullTextSearch quotes every word of a search", "[fulltextsearch]")
+{
+    REQUIRE(FullTextSearch::MatchExpression("sqlite  rest") == "\"sqlite\" \"rest\"");
+    REQUIRE(FullTextSearch::MatchExpression("que* OR") == "\"que\"* \"OR\"");
+    REQUIRE(FullTextSearch::MatchExpression("say \"hi") == "\"say\" \"\"\"hi\"");
+    REQUIRE(FullTextSearch::MatchExpression(" * ").empty());
+}
+
+TEST_CASE("FullTextSearch keeps the index in sync with the table and ranks the matches", "[fulltextsearch]")
+{
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+
+    REQUIRE(sqlite3_exec(db,
+                         "CREATE TABLE Posts_v1 (Id INTEGER PRIMARY KEY, Title TEXT, Body TEXT);"
+                         "INSERT INTO Posts_v1 VALUES (1, 'Hello', 'sqlite is small');"
+                         "INSERT INTO Posts_v1 VALUES (2, 'sqlite', 'sqlite sqlite and more sqlite');",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    FullTextIndex index;
+    REQUIRE(FullTextSearch::Parse("posts_v1(title,body)", index));
+
+    std::string error;
+    REQUIRE(FullTextSearch::Install(db, index, error));
+    REQUIRE(index.table == "Posts_v1");
+    REQUIRE(index.columns == std::vector<std::string>{"Title", "Body"});
+
+    // The rows that were there before are in the index, the most mentions first
+    REQUIRE(Search(db, index, "sqlite") == std::vector<int>{2, 1});
+    REQUIRE(Search(db, index, "hel*") == std::vector<int>{1});
+
+    REQUIRE(sqlite3_exec(db,
+                         "INSERT INTO Posts_v1 VALUES (3, 'New', 'words');"
+                         "UPDATE Posts_v1 SET Body = 'nothing' WHERE Id = 1;"
+                         "DELETE FROM Posts_v1 WHERE Id = 2;",
+                         nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    REQUIRE(Search(db, index, "words") == std::vector<int>{3});
+    REQUIRE(Search(db, index, "sqlite").empty());
+    REQUIRE(Search(db, index, "nothing") == std::vector<int>{1});
+
+    // Installing again keeps the index, and the schema still only shows the table
+    REQUIRE(FullTextSearch::Install(db, index, error));
+    REQUIRE(Search(db, index, "words") == std::vector<int>{3});
+
+    auto tables = LoadTables(db);
+    REQUIRE(tables.size() == 1);
+    REQUIRE(tables[0].RawName() == "Posts_v1");
+
+    FullTextIndex missing{"Posts_v1", {"Nope"}};
+    REQUIRE_FALSE(FullTextSearch::Install(db, missing, error));
+    REQUIRE(error == "there is no column Nope in Posts_v1");
+
+    sqlite3_close(db);
+}
@@ -0,0 +1,53 @@
+#include "../src/common/jsonwriter.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("JsonWriter writes nested arrays and objects", "[jsonwriter]")
+{
+    std::pmr::string output;
+    JsonWriter writer(output);
+
+    writer.BeginArray();
+    writer.BeginObject();
+    writer.Key("id");
+    writer.Integer(1);
+    writer.Key("tags");
+    writer.BeginArray();
+    writer.String("a");
+    writer.String("b");
+    writer.EndArray();
+    writer.EndObject();
+    writer.BeginObject();
+    writer.Key("id");
+    writer.Integer(-2);
+    writer.Key("value");
+    writer.Null();
+    writer.EndObject();
+    writer.EndArray();
+
+    REQUIRE(output == R"([{"id":1,"tags":["a","b"]},{"id":-2,"value":null}])");
+}
+
+TEST_CASE("JsonWriter escapes strings", "[jsonwriter]")
+{
+    std::pmr::string output;
+    JsonWriter writer(output);
+
+    writer.String("quote \" backslash \\ newline \n control \x01");
+
+    REQUIRE(output == R"("quote \" backslash \\ newline \n control \u0001")");
+}
+
+TEST_CASE("JsonWriter writes numbers and booleans", "[jsonwriter]")
+{
+    std::pmr::string output;
+    JsonWriter writer(output);
+
+    writer.BeginArray();
+    writer.Integer(9007199254740993LL);
+    writer.Real(1.5);
+    writer.Boolean(true);
+    writer.Boolean(false);
+    writer.EndArray();
+
+    REQUIRE(output == "[9007199254740993,1.5,true,false]");
+}
@@ -0,0 +1,45 @@
+#include "../src/common/latencyhistogram.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("LatencyHistogram buckets are continuous", "[latencyhistogram]")
+{
+    for (uint64_t value = 0; value < 5000; value++)
+    {
+        auto bucket = LatencyHistogram::BucketIndex(value);
+
+        REQUIRE(LatencyHistogram::BucketLowestValue(bucket) <= value);
+        REQUIRE(LatencyHistogram::BucketLowestValue(bucket + 1) > value);
+    }
+
+    REQUIRE(LatencyHistogram::BucketIndex(uint64_t(1) << 40) == LatencyHistogram::BucketCount - 1);
+}
+
+TEST_CASE("LatencyHistogram percentiles stay within the bucket precision", "[latencyhistogram]")
+{
+    LatencyHistogram histogram;
+
+    for (int i = 1; i <= 10000; i++)
+    {
+        histogram.Record(std::chrono::microseconds(i));
+    }
+
+    REQUIRE(histogram.Count() == 10000);
+    REQUIRE(histogram.Max() == 10000);
+    REQUIRE(histogram.Mean() == Approx(5000.5));
+    REQUIRE(histogram.Percentile(0.5) == Approx(5000).epsilon(0.04));
+    REQUIRE(histogram.Percentile(0.99) == Approx(9900).epsilon(0.04));
+    REQUIRE(histogram.Percentile(0.999) == Approx(9990).epsilon(0.04));
+    REQUIRE(histogram.Percentile(1.0) == 10000);
+}
+
+TEST_CASE("LatencyHistogram can be reset", "[latencyhistogram]")
+{
+    LatencyHistogram histogram;
+
+    histogram.Record(std::chrono::microseconds(250));
+    histogram.Reset();
+
+    REQUIRE(histogram.Count() == 0);
+    REQUIRE(histogram.Max() == 0);
+    REQUIRE(histogram.Percentile(0.5) == 0);
+}
@@ -0,0 +1,223 @@
+#include "../src/common/changefeed.h"
+#include "../src/common/longpoll.h"
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <mutex>
+#include <sqlite3/sqlite3.h>
+
+namespace
+{
+    // Records how the parked request was answered, and whether its owner is still alive
+    struct Answer
+    {
+        std::atomic<int> result{-1};
+        std::atomic<bool> ownerAlive{false};
+    };
+
+    struct Owner
+    {
+        Answer &answer;
+
+        explicit Owner(
+            Answer &answer)
+            : answer(answer)
+        {
+            answer.ownerAlive = true;
+        }
+
+        ~Owner()
+        {
+            answer.ownerAlive = false;
+        }
+    };
+
+    void Park(
+        LongPoll &longPoll,
+        std::string const &table,
+        uint64_t since,
+        std::chrono::milliseconds wait,
+        Answer &answer)
+    {
+        longPoll.Park(table, since, wait, [&answer](LongPoll::Results result) {
+            answer.result = int(result);
+        });
+
+        REQUIRE(longPoll.Parking());
+        REQUIRE(longPoll.Adopt(std::make_shared<Owner>(answer)));
+    }
+
+    bool WaitFor(
+        Answer &answer)
+    {
+        for (int i = 0; i < 300; i++)
+        {
+            if (answer.result != -1 && !answer.ownerAlive)
+            {
+                return true;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        return false;
+    }
+
+    sqlite3 *OpenExample()
+    {
+        sqlite3 *db = nullptr;
+        REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+        REQUIRE(sqlite3_exec(db, "CREATE TABLE Posts_v1 (Id INTEGER PRIMARY KEY, Title TEXT); CREATE TABLE Tags (Name TEXT);", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+        return db;
+    }
+} // namespace
+
+TEST_CASE("ChangeFeed keeps a version per table", "[longpoll]")
+{
+    auto db = OpenExample();
+
+    ChangeFeed feed;
+    feed.Attach(db);
+
+    auto start = feed.TableVersion("Posts_v1");
+    REQUIRE(start == feed.LastEventId());
+
+    REQUIRE(sqlite3_exec(db, "INSERT INTO Posts_v1 VALUES (1, 'first');", nullptr, nullptr, nullptr) == SQLITE_OK);
+    auto posts = feed.TableVersion("posts_v1");
+    REQUIRE(posts > start);
+    REQUIRE(posts == feed.LastEventId());
+
+    REQUIRE(sqlite3_exec(db, "INSERT INTO Tags VALUES ('other');", nullptr, nullptr, nullptr) == SQLITE_OK);
+    REQUIRE(feed.TableVersion("Posts_v1") == posts);
+    REQUIRE(feed.TableVersion("Tags") > posts);
+
+    feed.Stop();
+    sqlite3_close(db);
+}
+
+TEST_CASE("LongPoll answers a parked request when its table changes", "[longpoll]")
+{
+    auto db = OpenExample();
+
+    ChangeFeed feed;
+    feed.Attach(db);
+
+    LongPoll longPoll(feed);
+
+    Answer posts, tags;
+    Park(longPoll, "Posts_v1", feed.TableVersion("Posts_v1"), std::chrono::seconds(30), posts);
+    Park(longPoll, "Tags", feed.TableVersion("Tags"), std::chrono::seconds(30), tags);
+
+    REQUIRE(sqlite3_exec(db, "INSERT INTO Posts_v1 VALUES (1, 'first');", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    REQUIRE(WaitFor(posts));
+    REQUIRE(posts.result == int(LongPoll::Results::Changed));
+    REQUIRE(tags.result == -1);
+    REQUIRE(longPoll.Count() == 1);
+
+    longPoll.Stop();
+
+    REQUIRE(tags.result == int(LongPoll::Results::Stopped));
+    REQUIRE(!tags.ownerAlive);
+
+    feed.Stop();
+    sqlite3_close(db);
+}
+
+TEST_CASE("LongPoll answers right away when the table changed before the request was adopted", "[longpoll]")
+{
+    auto db = OpenExample();
+
+    ChangeFeed feed;
+    feed.Attach(db);
+
+    LongPoll longPoll(feed);
+
+    auto since = feed.TableVersion("Posts_v1");
+
+    REQUIRE(sqlite3_exec(db, "INSERT INTO Posts_v1 VALUES (1, 'first');", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    Answer answer;
+    Park(longPoll, "Posts_v1", since, std::chrono::seconds(30), answer);
+
+    REQUIRE(WaitFor(answer));
+    REQUIRE(answer.result == int(LongPoll::Results::Changed));
+
+    feed.Stop();
+    sqlite3_close(db);
+}
+
+TEST_CASE("LongPoll times out a request when nothing changes", "[longpoll]")
+{
+    ChangeFeed feed;
+    LongPoll longPoll(feed);
+
+    REQUIRE(!longPoll.Parking());
+    REQUIRE(!longPoll.Adopt(std::make_shared<int>(0)));
+
+    Answer answer;
+    Park(longPoll, "Posts_v1", feed.TableVersion("Posts_v1"), std::chrono::milliseconds(50), answer);
+
+    REQUIRE(WaitFor(answer));
+    REQUIRE(answer.result == int(LongPoll::Results::TimedOut));
+    REQUIRE(longPoll.Count() == 0);
+}
+
+TEST_CASE("LongPoll hands the answer to the dispatch instead of running it", "[longpoll]")
+{
+    ChangeFeed feed;
+    LongPoll longPoll(feed);
+
+    std::mutex mutex;
+    std::vector<std::pair<LongPoll::Results, LongPoll::Answer>> dispatched;
+
+    Answer answer;
+    longPoll.Park("Posts_v1", feed.TableVersion("Posts_v1"), std::chrono::milliseconds(20), [&answer](LongPoll::Results result) {
+        answer.result = int(result);
+    });
+    REQUIRE(longPoll.Adopt(std::make_shared<Owner>(answer), [&mutex, &dispatched](LongPoll::Results result, LongPoll::Answer run) {
+        std::lock_guard<std::mutex> lock(mutex);
+        dispatched.push_back(std::make_pair(result, std::move(run)));
+    }));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (int i = 0; i < 300 && dispatched.empty(); i++)
+    {
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        lock.lock();
+    }
+
+    REQUIRE(dispatched.size() == 1);
+    REQUIRE(dispatched[0].first == LongPoll::Results::TimedOut);
+    REQUIRE(answer.result == -1);
+    REQUIRE(answer.ownerAlive);
+
+    dispatched[0].second();
+    REQUIRE(answer.result == int(LongPoll::Results::TimedOut));
+
+    dispatched.clear();
+    REQUIRE(!answer.ownerAlive);
+}
+
+TEST_CASE("LongPoll parses wait times", "[longpoll]")
+{
+    std::chrono::milliseconds wait(0);
+
+    REQUIRE(LongPoll::ParseWait("30s", wait));
+    REQUIRE(wait == std::chrono::seconds(30));
+
+    REQUIRE(LongPoll::ParseWait("45", wait));
+    REQUIRE(wait == std::chrono::seconds(45));
+
+    REQUIRE(LongPoll::ParseWait("500ms", wait));
+    REQUIRE(wait == std::chrono::milliseconds(500));
+
+    REQUIRE(LongPoll::ParseWait("3600s", wait));
+    REQUIRE(wait == LongPoll::MaxWait);
+
+    REQUIRE(!LongPoll::ParseWait("", wait));
+    REQUIRE(!LongPoll::ParseWait("s", wait));
+    REQUIRE(!LongPoll::ParseWait("-1s", wait));
+    REQUIRE(!LongPoll::ParseWait("30m", wait));
+}
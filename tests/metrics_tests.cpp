@@ -0,0 +1,39 @@
+#include "../src/common/metrics.h"
+#include <catch2/catch.hpp>
+#include <thread>
+
+TEST_CASE("Metrics merges requests recorded on different threads", "[metrics]")
+{
+    auto route = Metrics::RegisterRoute("GET /metrics-test");
+
+    Metrics::RecordRequest(route, 200, std::chrono::microseconds(300), 10, 100);
+
+    std::thread other([route]() {
+        Metrics::RecordRequest(route, 200, std::chrono::microseconds(2000), 0, 50);
+        Metrics::RecordRequest(route, 404, std::chrono::microseconds(100), 0, 5);
+    });
+    other.join();
+
+    std::pmr::string output;
+    Metrics::Scrape(output);
+
+    REQUIRE(output.find("asr_http_requests_total{route=\"GET /metrics-test\",code=\"200\"} 2\n") != std::string::npos);
+    REQUIRE(output.find("asr_http_requests_total{route=\"GET /metrics-test\",code=\"404\"} 1\n") != std::string::npos);
+    REQUIRE(output.find("asr_http_request_duration_seconds_bucket{route=\"GET /metrics-test\",le=\"0.0005\"} 2\n") != std::string::npos);
+    REQUIRE(output.find("asr_http_request_duration_seconds_bucket{route=\"GET /metrics-test\",le=\"+Inf\"} 3\n") != std::string::npos);
+    REQUIRE(output.find("asr_http_response_bytes_total{route=\"GET /metrics-test\"} 155\n") != std::string::npos);
+}
+
+TEST_CASE("Metrics escapes route labels", "[metrics]")
+{
+    auto route = Metrics::RegisterRoute(R"(GET /api/([\w\-]+)$)");
+
+    REQUIRE(Metrics::RegisterRoute(R"(GET /api/([\w\-]+)$)") == route);
+
+    Metrics::RecordRequest(route, 200, std::chrono::microseconds(1), 0, 0);
+
+    std::pmr::string output;
+    Metrics::Scrape(output);
+
+    REQUIRE(output.find(R"(asr_http_requests_total{route="GET /api/([\\w\\-]+)$",code="200"} 1)") != std::string::npos);
+}
@@ -0,0 +1,129 @@
+#include "../src/common/querybudget.h"
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <sqlite3/sqlite3.h>
+#include <thread>
+
+namespace
+{
+    // Counts forever, only a stopped statement ends it
+    const char *EndlessQuery = "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) SELECT count(*) FROM c;";
+
+    sqlite3 *OpenMemory()
+    {
+        sqlite3 *db = nullptr;
+        REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+
+        QueryBudget::Install(db);
+
+        return db;
+    }
+
+    int Step(
+        sqlite3 *db,
+        const char *sql)
+    {
+        sqlite3_stmt *stmt = nullptr;
+        REQUIRE(sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK);
+
+        auto result = sqlite3_step(stmt);
+
+        sqlite3_finalize(stmt);
+
+        return result;
+    }
+} // namespace
+
+TEST_CASE("QueryBudget stops a query at its timeout", "[querybudget]")
+{
+    auto db = OpenMemory();
+
+    {
+        QueryBudget budget(std::chrono::milliseconds(50), nullptr);
+
+        REQUIRE(QueryBudget::Current() == &budget);
+
+        auto start = std::chrono::steady_clock::now();
+
+        REQUIRE(Step(db, EndlessQuery) == SQLITE_INTERRUPT);
+        REQUIRE(budget.Reason() == QueryBudget::Reasons::TimedOut);
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+        // Once stopped, every next query of the request stops too
+        REQUIRE(Step(db, EndlessQuery) == SQLITE_INTERRUPT);
+    }
+
+    REQUIRE(QueryBudget::Current() == nullptr);
+    REQUIRE(Step(db, "SELECT 1;") == SQLITE_ROW);
+
+    sqlite3_close(db);
+}
+
+TEST_CASE("QueryBudget stops a query when the client is gone", "[querybudget]")
+{
+    auto db = OpenMemory();
+
+    std::atomic<int> checks{0};
+
+    QueryBudget budget(std::chrono::milliseconds(0), [&checks]() {
+        return ++checks < 3;
+    });
+
+    REQUIRE(Step(db, EndlessQuery) == SQLITE_INTERRUPT);
+    REQUIRE(budget.Reason() == QueryBudget::Reasons::Disconnected);
+    REQUIRE(checks == 3);
+
+    sqlite3_close(db);
+}
+
+TEST_CASE("QueryBudget only stops the queries of its own thread", "[querybudget]")
+{
+    auto db = OpenMemory();
+
+    std::atomic<int> other{-1};
+
+    QueryBudget budget(std::chrono::milliseconds(1), nullptr);
+
+    std::thread thread([db, &other]() {
+        other = Step(db, "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < 200000) SELECT count(*) FROM c;");
+    });
+
+    thread.join();
+
+    REQUIRE(other == SQLITE_ROW);
+    REQUIRE(Step(db, EndlessQuery) == SQLITE_INTERRUPT);
+
+    sqlite3_close(db);
+}
+
+TEST_CASE("QueryBudget stops every query when the server shuts down", "[querybudget]")
+{
+    auto db = OpenMemory();
+
+    std::atomic<int> other{-1};
+
+    std::thread thread([db, &other]() {
+        QueryBudget budget(std::chrono::milliseconds(0), nullptr);
+
+        other = Step(db, EndlessQuery);
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    QueryBudget::SetShuttingDown(true);
+
+    thread.join();
+
+    REQUIRE(other == SQLITE_INTERRUPT);
+
+    {
+        QueryBudget budget(std::chrono::milliseconds(0), nullptr);
+
+        // Requests that were still queued stop at their first query
+        REQUIRE(Step(db, EndlessQuery) == SQLITE_INTERRUPT);
+        REQUIRE(budget.Reason() == QueryBudget::Reasons::ShuttingDown);
+    }
+
+    QueryBudget::SetShuttingDown(false);
+
+    sqlite3_close(db);
+}
@@ -0,0 +1,103 @@
+#include "../src/common/ratelimiter.h"
+#include <catch2/catch.hpp>
+#include <string>
+
+TEST_CASE("RateLimiter lets a client use its burst and then the rate", "[ratelimiter]")
+{
+    RateLimiter limiter(10, 5);
+
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::seconds retryAfter(0);
+
+    for (int i = 0; i < 5; i++)
+    {
+        REQUIRE(limiter.Take("10.0.0.1", 0, 1, retryAfter, now));
+    }
+
+    REQUIRE(!limiter.Take("10.0.0.1", 0, 1, retryAfter, now));
+    REQUIRE(retryAfter == std::chrono::seconds(1));
+
+    // Other clients have buckets of their own
+    REQUIRE(limiter.Take("10.0.0.2", 0, 1, retryAfter, now));
+
+    // 10 tokens a second is one every 100ms
+    REQUIRE(limiter.Take("10.0.0.1", 0, 1, retryAfter, now + std::chrono::milliseconds(100)));
+    REQUIRE(!limiter.Take("10.0.0.1", 0, 1, retryAfter, now + std::chrono::milliseconds(100)));
+}
+
+TEST_CASE("RateLimiter weighs requests by cost in a bucket per route class", "[ratelimiter]")
+{
+    RateLimiter limiter(1, 20);
+
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::seconds retryAfter(0);
+
+    REQUIRE(limiter.Take("10.0.0.1", 1, 10, retryAfter, now));
+    REQUIRE(limiter.Take("10.0.0.1", 1, 10, retryAfter, now));
+    REQUIRE(!limiter.Take("10.0.0.1", 1, 10, retryAfter, now));
+    REQUIRE(retryAfter == std::chrono::seconds(10));
+
+    // The scans did not use the tokens of the point lookups
+    REQUIRE(limiter.Take("10.0.0.1", 0, 1, retryAfter, now));
+
+    // A refused request takes nothing
+    REQUIRE(limiter.Take("10.0.0.1", 1, 10, retryAfter, now + std::chrono::seconds(10)));
+
+    // More than a bucket holds costs a full bucket
+    REQUIRE(limiter.Take("10.0.0.3", 1, 100, retryAfter, now));
+    REQUIRE(!limiter.Take("10.0.0.3", 1, 1, retryAfter, now));
+}
+
+TEST_CASE("RateLimiter forgets clients whose buckets filled up again", "[ratelimiter]")
+{
+    RateLimiter limiter(100, 1);
+
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::seconds retryAfter(0);
+
+    size_t refused = 0;
+
+    auto clients = RateLimiter::ShardCount * RateLimiter::MaxClientsPerShard * 2;
+    for (size_t i = 0; i < clients; i++)
+    {
+        if (!limiter.Take(std::to_string(i), 0, 1, retryAfter, now + std::chrono::milliseconds(i / 1000 * 100)))
+        {
+            refused++;
+        }
+    }
+
+    REQUIRE(refused == 0);
+
+    REQUIRE(limiter.ClientCount() < clients);
+    REQUIRE(limiter.ClientCount() <= RateLimiter::ShardCount * (RateLimiter::MaxClientsPerShard + 1));
+}
+
+TEST_CASE("RateLimiter forgets the clients seen longest ago when none of them is full", "[ratelimiter]")
+{
+    RateLimiter limiter(1, 5);
+
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::seconds retryAfter(0);
+
+    size_t refused = 0;
+
+    // Every client empties its bucket, nothing refills in the microseconds between them
+    auto clients = RateLimiter::ShardCount * RateLimiter::MaxClientsPerShard * 2;
+    for (size_t i = 0; i < clients; i++)
+    {
+        if (!limiter.Take(std::to_string(i), 0, 5, retryAfter, now + std::chrono::microseconds(i)))
+        {
+            refused++;
+        }
+    }
+
+    REQUIRE(refused == 0);
+
+    REQUIRE(limiter.ClientCount() <= RateLimiter::ShardCount * RateLimiter::MaxClientsPerShard);
+
+    auto later = now + std::chrono::microseconds(clients);
+
+    // The last client is still known and has to wait, the first one starts over with a full bucket
+    REQUIRE(!limiter.Take(std::to_string(clients - 1), 0, 5, retryAfter, later));
+    REQUIRE(limiter.Take("0", 0, 5, retryAfter, later));
+}
@@ -0,0 +1,63 @@
+#include "../src/common/ringbuffer.h"
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("RingBuffer rejects items when full", "[ringbuffer]")
+{
+    RingBuffer<int> buffer(4);
+
+    REQUIRE(buffer.Capacity() == 4);
+
+    for (int i = 0; i < 4; i++)
+    {
+        REQUIRE(buffer.TryPush(i));
+    }
+    REQUIRE_FALSE(buffer.TryPush(4));
+
+    int item = -1;
+    REQUIRE(buffer.TryPop(item));
+    REQUIRE(item == 0);
+    REQUIRE(buffer.TryPush(4));
+}
+
+TEST_CASE("RingBuffer keeps every item pushed by concurrent producers", "[ringbuffer]")
+{
+    RingBuffer<int> buffer(1024);
+    const int producers = 4;
+    const int itemsPerProducer = 10000;
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&buffer, p]() {
+            for (int i = 0; i < itemsPerProducer; i++)
+            {
+                while (!buffer.TryPush(p * itemsPerProducer + i))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<int> seen(producers * itemsPerProducer, 0);
+    int received = 0;
+    while (received < producers * itemsPerProducer)
+    {
+        int item;
+        if (buffer.TryPop(item))
+        {
+            seen[item]++;
+            received++;
+        }
+    }
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    REQUIRE(std::all_of(seen.begin(), seen.end(), [](int count) { return count == 1; }));
+}
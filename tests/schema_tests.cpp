@@ -0,0 +1,24 @@
+#include "../src/common/schema.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("Schema finds tables by name and version", "[schema]")
+{
+    Schema schema({DataTable("Posts_v2"), DataTable("Posts_v10"), DataTable("Posts_v1"), DataTable("Tags")}, 7);
+
+    REQUIRE(schema.Version() == 7);
+
+    REQUIRE(schema.Find("Posts", 1)->RawName() == "Posts_v1");
+    REQUIRE(schema.Find("Posts", 2)->RawName() == "Posts_v2");
+    REQUIRE(schema.Find("Posts", 10)->RawName() == "Posts_v10");
+    REQUIRE(schema.Find("Posts", 3) == nullptr);
+    REQUIRE(schema.Find("Tags", 1)->RawName() == "Tags");
+    REQUIRE(schema.Find("Comments") == nullptr);
+}
+
+TEST_CASE("Schema finds the latest version without a version", "[schema]")
+{
+    Schema schema({DataTable("Posts_v2"), DataTable("Posts_v10"), DataTable("Posts_v1"), DataTable("Tags")}, 7);
+
+    REQUIRE(schema.Find("Posts")->RawName() == "Posts_v10");
+    REQUIRE(schema.Find("Tags")->RawName() == "Tags");
+}
@@ -0,0 +1,114 @@
+#include "../src/common/schemasnapshot.h"
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sqlite3/sqlite3.h>
+
+namespace
+{
+    std::vector<DataTable> ExampleTables()
+    {
+        DataTable posts("Posts_v2");
+        posts.PrimaryKey("Id");
+        posts.AddColumn("Id", ColumnTypes::Integer);
+        posts.AddColumn("Title", ColumnTypes::Text);
+        posts.AddColumn("Score", ColumnTypes::Real);
+        posts.AddRelation(Relation{"Comments", "Comments_v1", "Id", "PostId", true}, 1);
+
+        DataTable tags("Tags");
+        tags.AddColumn("Image", ColumnTypes::Blob);
+
+        return {posts, tags};
+    }
+} // namespace
+
+TEST_CASE("SchemaSnapshot loads what it saved for the same schema version", "[schemasnapshot]")
+{
+    auto path = (std::filesystem::temp_directory_path() / "asr_schemasnapshot_tests.bin").string();
+
+    REQUIRE(SchemaSnapshot::Save(path, 42, 7, ExampleTables()));
+
+    std::vector<DataTable> tables;
+    REQUIRE(SchemaSnapshot::Load(path, 42, 7, tables));
+
+    std::filesystem::remove(path);
+
+    REQUIRE(tables.size() == 2);
+    REQUIRE(tables[0].RawName() == "Posts_v2");
+    REQUIRE(tables[0].Name() == "Posts");
+    REQUIRE(tables[0].Version() == 2);
+    REQUIRE(tables[0].PrimaryKey() == "Id");
+    REQUIRE(tables[0].Columns() == ExampleTables()[0].Columns());
+    REQUIRE(tables[0].Relations().size() == 1);
+    REQUIRE(tables[0].Relations()[0].table == "Comments_v1");
+    REQUIRE(tables[0].Relations()[0].relatedColumn == "PostId");
+    REQUIRE(tables[0].Relations()[0].many);
+    REQUIRE(tables[1].Name() == "Tags");
+    REQUIRE(tables[1].PrimaryKey().empty());
+    REQUIRE(tables[1].Columns().at("Image") == ColumnTypes::Blob);
+}
+
+TEST_CASE("SchemaSnapshot rejects another schema version", "[schemasnapshot]")
+{
+    auto path = (std::filesystem::temp_directory_path() / "asr_schemasnapshot_tests_version.bin").string();
+
+    REQUIRE(SchemaSnapshot::Save(path, 42, 7, ExampleTables()));
+
+    std::vector<DataTable> tables;
+    REQUIRE_FALSE(SchemaSnapshot::Load(path, 43, 7, tables));
+    REQUIRE(tables.empty());
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SchemaSnapshot rejects the schema of another database with the same version", "[schemasnapshot]")
+{
+    auto path = (std::filesystem::temp_directory_path() / "asr_schemasnapshot_tests_hash.bin").string();
+
+    sqlite3 *first = nullptr;
+    sqlite3 *second = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &first) == SQLITE_OK);
+    REQUIRE(sqlite3_open(":memory:", &second) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(first, "CREATE TABLE Posts(Id INTEGER PRIMARY KEY, Title TEXT);", nullptr, nullptr, nullptr) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(second, "CREATE TABLE Users(Id INTEGER PRIMARY KEY, Name TEXT);", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    REQUIRE(SchemaSnapshot::SchemaVersion(first) == SchemaSnapshot::SchemaVersion(second));
+    REQUIRE(SchemaSnapshot::SchemaHash(first) != SchemaSnapshot::SchemaHash(second));
+    REQUIRE(SchemaSnapshot::SchemaHash(first) == SchemaSnapshot::SchemaHash(first));
+
+    REQUIRE(SchemaSnapshot::Save(path, SchemaSnapshot::SchemaVersion(first), SchemaSnapshot::SchemaHash(first), ExampleTables()));
+
+    std::vector<DataTable> tables;
+    REQUIRE_FALSE(SchemaSnapshot::Load(path, SchemaSnapshot::SchemaVersion(second), SchemaSnapshot::SchemaHash(second), tables));
+    REQUIRE(SchemaSnapshot::Load(path, SchemaSnapshot::SchemaVersion(first), SchemaSnapshot::SchemaHash(first), tables));
+
+    std::filesystem::remove(path);
+    sqlite3_close(first);
+    sqlite3_close(second);
+}
+
+TEST_CASE("SchemaSnapshot rejects missing and damaged files", "[schemasnapshot]")
+{
+    auto path = (std::filesystem::temp_directory_path() / "asr_schemasnapshot_tests_damaged.bin").string();
+    std::filesystem::remove(path);
+
+    std::vector<DataTable> tables;
+    REQUIRE_FALSE(SchemaSnapshot::Load(path, 42, 7, tables));
+
+    REQUIRE(SchemaSnapshot::Save(path, 42, 7, ExampleTables()));
+
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(40);
+        file.put('X');
+    }
+
+    REQUIRE_FALSE(SchemaSnapshot::Load(path, 42, 7, tables));
+
+    std::filesystem::resize_file(path, 20);
+
+    REQUIRE_FALSE(SchemaSnapshot::Load(path, 42, 7, tables));
+    REQUIRE(tables.empty());
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,39 @@
+#include "../src/common/schemawatcher.h"
+#include "../src/common/sqliteconnection.h"
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <sqlite3/sqlite3.h>
+
+TEST_CASE("SchemaWatcher calls the handler when the schema version changes", "[schemawatcher]")
+{
+    auto path = (std::filesystem::temp_directory_path() / "asr_schemawatcher_tests.sqlite3").string();
+    std::filesystem::remove(path);
+
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(db, "CREATE TABLE Posts_v1 (Id INTEGER PRIMARY KEY);", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    std::atomic<int> seenVersion = {0};
+    std::atomic<int> calls = {0};
+
+    SchemaWatcher watcher;
+    REQUIRE(watcher.Start(path, SqliteSettings(), 1, std::chrono::milliseconds(10), [&](sqlite3 *, int schemaVersion) {
+        seenVersion = schemaVersion;
+        calls++;
+    }));
+
+    REQUIRE(sqlite3_exec(db, "CREATE TABLE Tags_v1 (Id INTEGER PRIMARY KEY);", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    for (int i = 0; i < 200 && seenVersion != 2; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    watcher.Stop();
+    sqlite3_close(db);
+    std::filesystem::remove(path);
+
+    REQUIRE(seenVersion == 2);
+    REQUIRE(calls == 1);
+}
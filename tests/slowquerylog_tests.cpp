@@ -0,0 +1,100 @@
+#include "../src/common/metrics.h"
+#include "../src/common/slowquerylog.h"
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sqlite3/sqlite3.h>
+#include <sstream>
+
+namespace
+{
+    std::string ReadFile(
+        std::filesystem::path const &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream ss;
+
+        ss << file.rdbuf();
+
+        return ss.str();
+    }
+
+    // Steps the statement to the end and returns the row count
+    size_t StepAll(
+        sqlite3_stmt *stmt)
+    {
+        size_t rows = 0;
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            rows++;
+        }
+
+        return rows;
+    }
+
+    // The value of a counter without labels in the scraped metrics
+    long long ScrapeCounter(
+        std::string const &name)
+    {
+        std::pmr::string output;
+        Metrics::Scrape(output);
+
+        auto found = output.find("\n" + name + " ");
+        REQUIRE(found != std::pmr::string::npos);
+
+        return std::stoll(std::string(output.substr(found + name.size() + 2, 20)));
+    }
+} // namespace
+
+TEST_CASE("SlowQueryLog logs statements over the threshold with their plan", "[slowquerylog]")
+{
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(db, "CREATE TABLE t(a, b); INSERT INTO t VALUES (1, 'x'), (2, 'y'), (3, 'x');", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    auto path = std::filesystem::temp_directory_path() / "asr_slowquerylog_tests.log";
+    std::filesystem::remove(path);
+
+    REQUIRE(SlowQueryLog::Open(path.string(), std::chrono::milliseconds(10)));
+    REQUIRE(SlowQueryLog::IsOpen());
+
+    sqlite3_stmt *stmt = nullptr;
+    REQUIRE(sqlite3_prepare_v2(db, "SELECT a FROM t WHERE b = ?1;", -1, &stmt, nullptr) == SQLITE_OK);
+    sqlite3_bind_text(stmt, 1, "x", -1, SQLITE_STATIC);
+
+    auto before = ScrapeCounter("asr_sqlite_fullscan_steps_total");
+
+    auto rows = StepAll(stmt);
+    REQUIRE(rows == 2);
+
+    // Under the threshold nothing is written
+    SlowQueryLog::Finish(stmt, std::chrono::milliseconds(1), rows);
+
+    // A second run of the same statement counts its own steps, not those of both runs
+    sqlite3_reset(stmt);
+    REQUIRE(StepAll(stmt) == rows);
+    SlowQueryLog::Finish(stmt, std::chrono::milliseconds(25), rows);
+
+    REQUIRE(ScrapeCounter("asr_sqlite_fullscan_steps_total") - before == 4);
+
+    sqlite3_finalize(stmt);
+
+    SlowQueryLog::Close();
+    REQUIRE(!SlowQueryLog::IsOpen());
+
+    auto log = ReadFile(path);
+
+    REQUIRE(std::count(log.begin(), log.end(), '\n') == 1);
+    REQUIRE(log.find("\"duration_us\":25000") != std::string::npos);
+    REQUIRE(log.find("\"rows\":2") != std::string::npos);
+    REQUIRE(log.find("\"sql\":\"SELECT a FROM t WHERE b = ?1;\"") != std::string::npos);
+    REQUIRE(log.find("\"expanded_sql\":\"SELECT a FROM t WHERE b = 'x';\"") != std::string::npos);
+    REQUIRE(log.find("\"fullscan_steps\":2") != std::string::npos);
+    REQUIRE(log.find("\"plan\":[\"SCAN t\"]") != std::string::npos);
+
+    std::filesystem::remove(path);
+    sqlite3_close(db);
+}
@@ -0,0 +1,85 @@
+#include "../src/common/sqliteconnection.h"
+#include <catch2/catch.hpp>
+#include <sqlite3/sqlite3.h>
+
+TEST_CASE("SqliteSettings applies the named profiles", "[sqliteconnection]")
+{
+    SqliteSettings settings;
+
+    REQUIRE(settings.Profile("read-heavy"));
+    REQUIRE(settings.journalMode == "WAL");
+    REQUIRE(settings.synchronous == "NORMAL");
+    REQUIRE(settings.cacheSize == -64 * 1024);
+    REQUIRE(settings.mmapSize == 1024LL * 1024 * 1024);
+    REQUIRE(settings.tempStore == "MEMORY");
+    REQUIRE(settings.busyTimeout == 5000);
+
+    REQUIRE(settings.Profile("write-heavy"));
+    REQUIRE(settings.mmapSize == 0);
+    REQUIRE(settings.busyTimeout == 10000);
+
+    SqliteSettings custom;
+
+    REQUIRE(custom.Profile("custom"));
+    REQUIRE(!custom.journalMode.has_value());
+    REQUIRE(!custom.cacheSize.has_value());
+
+    REQUIRE(!custom.Profile("fast"));
+}
+
+TEST_CASE("SqliteSettings sets values by their command line name", "[sqliteconnection]")
+{
+    SqliteSettings settings;
+
+    REQUIRE(settings.Set("journal-mode", "wal"));
+    REQUIRE(settings.journalMode == "WAL");
+    REQUIRE(settings.Set("synchronous", "1"));
+    REQUIRE(settings.synchronous == "1");
+    REQUIRE(settings.Set("cache-size", "-2000"));
+    REQUIRE(settings.cacheSize == -2000);
+    REQUIRE(settings.Set("mmap-size", "268435456"));
+    REQUIRE(settings.mmapSize == 268435456);
+    REQUIRE(settings.Set("temp-store", "memory"));
+    REQUIRE(settings.tempStore == "MEMORY");
+    REQUIRE(settings.Set("busy-timeout", "250"));
+    REQUIRE(settings.busyTimeout == 250);
+}
+
+TEST_CASE("SqliteSettings rejects unknown names and invalid values", "[sqliteconnection]")
+{
+    SqliteSettings settings;
+
+    REQUIRE(!settings.Set("page-size", "4096"));
+
+    // The values end up in PRAGMA statements, so only the known ones get through
+    REQUIRE(!settings.Set("journal-mode", "WAL; DROP TABLE t"));
+    REQUIRE(!settings.journalMode.has_value());
+    REQUIRE(!settings.Set("synchronous", "sometimes"));
+    REQUIRE(!settings.Set("temp-store", "disk"));
+
+    REQUIRE(!settings.Set("cache-size", "64MB"));
+    REQUIRE(!settings.Set("cache-size", ""));
+    REQUIRE(!settings.cacheSize.has_value());
+    REQUIRE(!settings.Set("mmap-size", "1e9"));
+    REQUIRE(!settings.Set("busy-timeout", "99999999999"));
+}
+
+TEST_CASE("OpenConnection applies the settings to the connection", "[sqliteconnection]")
+{
+    SqliteSettings settings;
+
+    REQUIRE(settings.Set("cache-size", "-4096"));
+    REQUIRE(settings.Set("temp-store", "memory"));
+    REQUIRE(settings.Set("busy-timeout", "1234"));
+
+    auto db = OpenConnection(":memory:", settings);
+    REQUIRE(db != nullptr);
+
+    auto description = DescribeConnection(db);
+
+    REQUIRE(description.find("cache_size=-4096") != std::string::npos);
+    REQUIRE(description.find("temp_store=2") != std::string::npos);
+    REQUIRE(description.find("busy_timeout=1234") != std::string::npos);
+
+    sqlite3_close(db);
+}
@@ -0,0 +1,68 @@
+#include "../src/common/jsonwriter.h"
+#include "../src/common/sqlitestats.h"
+#include <catch2/catch.hpp>
+#include <regex>
+#include <sqlite3/sqlite3.h>
+#include <string>
+
+namespace
+{
+    std::string WriteStats()
+    {
+        std::pmr::string output;
+        JsonWriter writer(output);
+
+        SqliteStats::Write(writer);
+
+        return std::string(output);
+    }
+
+    // The current value and the delta of a connection value in the output
+    std::pair<long long, long long> ConnectionValue(
+        std::string const &output,
+        std::string const &connection,
+        std::string const &name)
+    {
+        std::regex value("\"name\":\"" + connection + "\"[^\\]]*\"" + name + "\":\\{\"current\":([0-9]+),\"highwater\":[0-9]+,\"delta\":(-?[0-9]+)\\}");
+        std::smatch match;
+
+        REQUIRE(std::regex_search(output, match, value));
+
+        return std::make_pair(std::stoll(match[1].str()), std::stoll(match[2].str()));
+    }
+} // namespace
+
+TEST_CASE("SqliteStats reports registered connections with the change since the last report", "[sqlitestats]")
+{
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(db, "CREATE TABLE t(a); INSERT INTO t VALUES (1), (2), (3);", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    SqliteStats::Register("sqlitestats-test", db);
+
+    auto first = WriteStats();
+
+    REQUIRE(first.find("\"interval_seconds\":") != std::string::npos);
+    REQUIRE(first.find("\"global\":{\"memory_used_bytes\":{\"current\":") != std::string::npos);
+
+    auto before = ConnectionValue(first, "sqlitestats-test", "cache_hit");
+
+    for (int i = 0; i < 5; i++)
+    {
+        REQUIRE(sqlite3_exec(db, "SELECT count(*) FROM t;", nullptr, nullptr, nullptr) == SQLITE_OK);
+    }
+
+    auto after = ConnectionValue(WriteStats(), "sqlitestats-test", "cache_hit");
+
+    REQUIRE(after.first > before.first);
+    REQUIRE(after.second == after.first - before.first);
+
+    // Nothing ran since, so nothing changed
+    REQUIRE(ConnectionValue(WriteStats(), "sqlitestats-test", "cache_hit").second == 0);
+
+    SqliteStats::Unregister(db);
+
+    REQUIRE(WriteStats().find("sqlitestats-test") == std::string::npos);
+
+    sqlite3_close(db);
+}
@@ -0,0 +1,10 @@
+#include "../src/common/sqlquote.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("SqlQuote doubles the quote marks inside", "[sqlquote]")
+{
+    REQUIRE(SqlQuote("Title") == "\"Title\"");
+    REQUIRE(SqlQuote("a\"b") == "\"a\"\"b\"");
+    REQUIRE(SqlQuote("") == "\"\"");
+    REQUIRE(SqlQuote("it's", '\'') == "'it''s'");
+}
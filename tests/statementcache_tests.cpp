@@ -0,0 +1,91 @@
+#include "../src/common/statementcache.h"
+#include <catch2/catch.hpp>
+#include <sqlite3/sqlite3.h>
+
+TEST_CASE("StatementCache reuses released statements for the same sql", "[statementcache]")
+{
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(db, "CREATE TABLE Posts_v1 (Id INTEGER PRIMARY KEY, Title TEXT);", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    {
+        StatementCache cache(db);
+
+        auto first = cache.Acquire("select Title from Posts_v1 where Id = ?");
+        REQUIRE(first != nullptr);
+        sqlite3_bind_int(first, 1, 5);
+
+        // A statement in use is never handed out twice
+        auto second = cache.Acquire("select Title from Posts_v1 where Id = ?");
+        REQUIRE(second != nullptr);
+        REQUIRE(second != first);
+
+        cache.Release(first);
+
+        auto third = cache.Acquire("select Title from Posts_v1 where Id = ?");
+        REQUIRE(third == first);
+        REQUIRE(sqlite3_bind_parameter_count(third) == 1);
+
+        // Released statements come back without their bindings
+        auto sql = sqlite3_expanded_sql(third);
+        REQUIRE(std::string(sql) == "select Title from Posts_v1 where Id = NULL");
+        sqlite3_free(sql);
+
+        auto other = cache.Acquire("select Id from Posts_v1");
+        REQUIRE(other != first);
+        REQUIRE(other != second);
+
+        cache.Release(second);
+        cache.Release(third);
+        cache.Release(other);
+    }
+
+    // All statements are finalized, so the connection closes
+    REQUIRE(sqlite3_close(db) == SQLITE_OK);
+}
+
+TEST_CASE("StatementCache hands out reused statements with their counters at zero", "[statementcache]")
+{
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(db, "CREATE TABLE Tags (Name TEXT); INSERT INTO Tags VALUES ('a'), ('b'), ('c');", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    {
+        StatementCache cache(db);
+
+        auto stmt = cache.Acquire("select Name from Tags order by Name desc");
+        REQUIRE(stmt != nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+        }
+
+        REQUIRE(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0) > 0);
+        REQUIRE(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 0) > 0);
+
+        cache.Release(stmt);
+
+        auto reused = cache.Acquire("select Name from Tags order by Name desc");
+        REQUIRE(reused == stmt);
+        REQUIRE(sqlite3_stmt_status(reused, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0) == 0);
+        REQUIRE(sqlite3_stmt_status(reused, SQLITE_STMTSTATUS_SORT, 0) == 0);
+        REQUIRE(sqlite3_stmt_status(reused, SQLITE_STMTSTATUS_AUTOINDEX, 0) == 0);
+
+        cache.Release(reused);
+    }
+
+    sqlite3_close(db);
+}
+
+TEST_CASE("StatementCache returns nullptr for sql that does not prepare", "[statementcache]")
+{
+    sqlite3 *db = nullptr;
+    REQUIRE(sqlite3_open(":memory:", &db) == SQLITE_OK);
+
+    {
+        StatementCache cache(db);
+
+        REQUIRE(cache.Acquire("select * from Missing") == nullptr);
+    }
+
+    REQUIRE(sqlite3_close(db) == SQLITE_OK);
+}
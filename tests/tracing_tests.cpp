@@ -0,0 +1,72 @@
+#include "../src/common/tracing.h"
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    std::string ReadFile(
+        std::filesystem::path const &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream ss;
+
+        ss << file.rdbuf();
+
+        return ss.str();
+    }
+} // namespace
+
+TEST_CASE("Tracing writes spans as complete chrome trace events", "[tracing]")
+{
+    Tracing::Enable();
+
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::microseconds(250);
+
+    Tracing::AddSpan("tracing-test-span", start, end);
+
+    std::thread([start, end]() {
+        Tracing::AddSpan("tracing-test-other-thread", start, end);
+    }).join();
+
+    auto path = std::filesystem::temp_directory_path() / "asr_tracing_tests.json";
+
+    REQUIRE(Tracing::WriteFile(path.string()));
+
+    auto trace = ReadFile(path);
+    std::filesystem::remove(path);
+
+    REQUIRE(trace.front() == '{');
+    REQUIRE(trace.back() == '}');
+    REQUIRE(trace.find("\"traceEvents\":[") != std::string::npos);
+    REQUIRE(trace.find("{\"name\":\"tracing-test-span\",\"cat\":\"asr\",\"ph\":\"X\"") != std::string::npos);
+    REQUIRE(trace.find("\"dur\":250,") != std::string::npos);
+
+    auto first = trace.find("tracing-test-span");
+    auto second = trace.find("tracing-test-other-thread");
+    REQUIRE(second != std::string::npos);
+    REQUIRE(trace.substr(trace.find("\"tid\":", first), 8) != trace.substr(trace.find("\"tid\":", second), 8));
+}
+
+TEST_CASE("Tracing truncates long span names", "[tracing]")
+{
+    Tracing::Enable();
+
+    auto now = std::chrono::steady_clock::now();
+
+    Tracing::AddSpan(std::string(200, 'x'), now, now);
+
+    auto path = std::filesystem::temp_directory_path() / "asr_tracing_tests_names.json";
+
+    REQUIRE(Tracing::WriteFile(path.string()));
+
+    auto trace = ReadFile(path);
+    std::filesystem::remove(path);
+
+    REQUIRE(trace.find(std::string(47, 'x') + "\"") != std::string::npos);
+    REQUIRE(trace.find(std::string(48, 'x')) == std::string::npos);
+}
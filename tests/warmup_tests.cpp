@@ -0,0 +1,46 @@
+#include "../src/common/warmup.h"
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+
+TEST_CASE("Warmup saves access stats and loads them most used first", "[warmup]")
+{
+    auto path = std::filesystem::temp_directory_path() / "asr_warmup_tests.warmup";
+    std::filesystem::remove(path);
+
+    // Without a file there is nothing to warm up
+    REQUIRE(Warmup::LoadAccessStats(path.string()).empty());
+
+    REQUIRE(Warmup::SaveAccessStats(path.string(), {{"Authors", 10}, {"Posts", 40}, {"Comments", 0}}));
+
+    auto tables = Warmup::LoadAccessStats(path.string());
+
+    REQUIRE(tables == std::vector<std::string>{"Posts", "Authors"});
+
+    // The previous run counts for half, so Authors (5 + 30) passes Posts (20 + 0)
+    REQUIRE(Warmup::SaveAccessStats(path.string(), {{"Authors", 30}, {"Comments", 3}}));
+
+    tables = Warmup::LoadAccessStats(path.string());
+
+    REQUIRE(tables == std::vector<std::string>{"Authors", "Posts", "Comments"});
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Warmup counts table accesses apart from the latency stats", "[warmup]")
+{
+    auto counter = Warmup::AccessCounter("warmup-test-table");
+
+    REQUIRE(Warmup::AccessCounter("warmup-test-table") == counter);
+
+    counter->fetch_add(3);
+
+    auto counts = Warmup::AccessCounts();
+    auto found = std::find_if(counts.begin(), counts.end(), [](std::pair<std::string, uint64_t> const &count) {
+        return count.first == "warmup-test-table";
+    });
+
+    REQUIRE(found != counts.end());
+    REQUIRE(found->second == 3);
+}
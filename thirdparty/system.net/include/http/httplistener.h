@@ -2,6 +2,8 @@
 #define HTTPLISTENER_H
 
 #include "httplistenercontext.h"
+#include <chrono>
+#include <cstddef>
 #include <vector>
 #include <string>
 
@@ -16,6 +18,12 @@ namespace Http
 
 typedef std::vector<std::string> HttpListenerPrefixCollection;
 
+// Receives the name, start and end of the steps the listener takes while handling a request.
+typedef void (*HttpListenerTraceCallback)(
+    char const *name,
+    std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end);
+
 class HttpListener
 {
     class InternalHttpListener *_internal;
@@ -33,6 +41,23 @@ public:
     // Gets the Uniform Resource Identifier (URI) prefixes handled by this HttpListener object.
     HttpListenerPrefixCollection &Prefixes();
 
+    // Gets or sets how many connections wait to be accepted before new ones are refused, set it before Start.
+    int MaxConnections() const;
+    void SetMaxConnections(int maxConnections);
+
+    // Gets or sets how large the request line and headers may be, larger requests are answered with 431.
+    size_t MaxRequestHeadSize() const;
+    void SetMaxRequestHeadSize(size_t maxRequestHeadSize);
+
+    // Gets or sets how large the body of a request may be, a larger Content-Length is answered with 413.
+    size_t MaxRequestBodySize() const;
+    void SetMaxRequestBodySize(size_t maxRequestBodySize);
+
+    // Gets or sets how long a connection may take to send its request, a slower one is closed without an answer.
+    // Requests are read on the thread that calls GetContext, so this bounds how long one client can hold it.
+    std::chrono::milliseconds RequestReadTimeout() const;
+    void SetRequestReadTimeout(std::chrono::milliseconds requestReadTimeout);
+
 public:
     // Shuts down the HttpListener object immediately, discarding all currently queued requests.
     void Abort();
@@ -40,14 +65,19 @@ public:
     // Shuts down the HttpListener.
     void Close();
 
-    // Waits for an incoming request and returns when one is received.
+    // Waits for an incoming request and returns when one is received, or returns nullptr when Stop was called meanwhile.
+    // Several threads can wait at once, each gets a connection of its own. A connection that fails is dropped and
+    // the next one is waited for, an exception means the listening socket itself failed.
     HttpListenerContext *GetContext();
 
     // Allows this instance to receive incoming requests.
     void Start();
 
-    // Causes this instance to stop receiving incoming requests.
+    // Causes this instance to stop receiving incoming requests, a GetContext waiting on another thread returns.
     void Stop();
+
+    // Sets the callback that receives reading and sending steps for tracing, nullptr turns it off.
+    static void SetTraceCallback(HttpListenerTraceCallback callback);
 };
 
 }
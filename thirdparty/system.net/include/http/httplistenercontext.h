@@ -3,6 +3,7 @@
 
 #include "httplistenerresponse.h"
 #include "httplistenerrequest.h"
+#include <memory_resource>
 
 namespace System
 {
@@ -16,6 +17,9 @@ namespace Http
 class HttpListenerContext
 {
 protected:
+    // Everything allocated while handling the request comes from this arena, it is released at once with the context.
+    char _arenaBuffer[16 * 1024];
+    std::pmr::monotonic_buffer_resource _arena;
     HttpListenerRequest *_request;
     HttpListenerResponse *_response;
 
@@ -29,6 +33,9 @@ public:
     // Gets the HttpListenerResponse object that will be sent to the client in response to the client's request.
     HttpListenerResponse *Response();
 
+    // Gets the memory resource backing the request and response, it is released when the context is deleted.
+    std::pmr::memory_resource *Arena();
+
     // Gets an object used to obtain identity, authentication information, and security roles for the client whose request is represented by this HttpListenerContext object.
     // IPrincipal &User();
 };
@@ -3,8 +3,10 @@
 
 #include <winsock2.h>
 #include <functional>
-#include <string>
 #include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
 
 #define BUFFER_SIZE 1024*5 // 5KB
 
@@ -17,41 +19,66 @@ namespace Net
 namespace Http
 {
 
+// Compares header names without looking at case, like HTTP does.
+struct HttpHeaderNameLess
+{
+    typedef void is_transparent;
+
+    bool operator()(std::string_view a, std::string_view b) const;
+};
+
+// Header and query string values point into the raw request data, so they live as long as the request.
+typedef std::pmr::map<std::string_view, std::string_view, HttpHeaderNameLess> HttpHeaderCollection;
+typedef std::pmr::map<std::string_view, std::string_view, std::less<>> HttpQueryStringCollection;
+
 class HttpListenerRequest
 {
 protected:
+    std::pmr::memory_resource *_arena;
+    std::pmr::string _rawData;
     long _contentLength64;
-    std::string _contentType;
-    std::map<std::string, std::string> _headers;
-    std::string _httpMethod;
-    std::map<std::string, std::string> _queryString;
-    std::string _rawUrl;
+    std::string_view _contentType;
+    HttpHeaderCollection _headers;
+    std::string_view _httpMethod;
+    HttpQueryStringCollection _queryString;
+    std::string_view _rawUrl;
+    std::string_view _path;
+
+    // Parses the request line, the headers and the payload from the raw request data.
+    void Parse();
 
 public:
-    HttpListenerRequest();
+    explicit HttpListenerRequest(std::pmr::memory_resource *arena);
 
 public:
     // Gets the length of the body data included in the request.
     long ContentLength64() const;
 
     // Gets the MIME type of the body data included in the request.
-    std::string const &ContentType() const;
+    std::string_view ContentType() const;
 
     // Gets the collection of header name/value pairs sent in the request.
-    std::map<std::string, std::string> const &Headers() const;
+    HttpHeaderCollection const &Headers() const;
 
     // Gets the HTTP method specified by the client.
-    std::string const &HttpMethod() const;
+    std::string_view HttpMethod() const;
 
     // Gets the query string included in the request.
-    std::map<std::string, std::string> const &QueryString() const;
+    HttpQueryStringCollection const &QueryString() const;
 
     // Gets the URL information (without the host and port) requested by the client.
-    std::string const &RawUrl() const;
+    std::string_view RawUrl() const;
+
+    // Gets the path of the URL, without the query string.
+    std::string_view Path() const;
+
+    // Gets the memory resource that lives as long as this request.
+    std::pmr::memory_resource *Arena() const;
 
-    std::string _payload;
+    std::string_view _payload;
 
-    std::string ipAddress() const;
+    // Gets the IP address of the client, like 127.0.0.1.
+    virtual std::string ipAddress() const = 0;
 };
 
 }
@@ -2,8 +2,12 @@
 #define HTTPRESPONSE_H
 
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <vector>
 
 #include "httplistenerrequest.h"
 
@@ -16,17 +20,41 @@ namespace Net
 namespace Http
 {
 
+// The body of a detached response, sent as it is written for as long as the client stays connected.
+class HttpListenerStream
+{
+public:
+    // Closes the connection.
+    virtual ~HttpListenerStream();
+
+    // Sends the data right away, returns false when the client is gone.
+    virtual bool Write(std::string_view data) = 0;
+
+    // Gets whether the client takes more data without Write having to wait.
+    virtual bool IsWritable() = 0;
+};
+
 class HttpListenerResponse
 {
 protected:
+    // A part of the body, either owned by the response or pointing to memory that outlives it.
+    struct OutputSegment
+    {
+        std::pmr::string owned;
+        const char *data;
+        size_t length;
+    };
+
+    std::pmr::memory_resource *_arena;
     std::string _contentType;
     std::map<std::string, std::string> _headers;
     int _statusCode;
     std::string _statusDescription;
-    std::string _output;
+    std::pmr::vector<OutputSegment> _output;
+    size_t _outputLength;
 
 protected:
-    HttpListenerResponse();
+    explicit HttpListenerResponse(std::pmr::memory_resource *arena);
 
 public:
     HttpListenerResponse(HttpListenerResponse &copy);
@@ -55,9 +83,39 @@ public:
     // Configures the response to redirect the client to the specified URL.
     void Redirect(std::string const &url);
 
-    void WriteOutput(std::string const &data);
+    // Copies data into the body, the body buffers come from the arena of the request.
+    void WriteOutput(const char *data);
+    void WriteOutput(std::string_view data);
+
+    // Adds data to the body without copying it when it was allocated from Arena().
+    void WriteOutput(std::pmr::string &&data);
 
+    // Adds data to the body without copying it, the data must outlive the response (like static assets).
+    void WriteStaticOutput(const char *data, size_t length);
+
+    // Gets the number of bytes written to the body so far.
+    size_t OutputLength() const;
+
+    // Drops the body written so far, to answer with an error instead of what was started.
+    void ClearOutput();
+
+    // Gets the memory resource that lives as long as this response.
+    std::pmr::memory_resource *Arena() const;
+
+    // Sends the response and closes the connection, only the first call does anything.
     virtual void CloseOutput() = 0;
+
+    // Gets whether the response was sent, by CloseOutput or Detach.
+    virtual bool IsOutputClosed() const = 0;
+
+    // Gets whether the client still has the connection open, without waiting. A client that gave up
+    // on the request closed it, and will not read the response.
+    virtual bool IsClientConnected() = 0;
+
+    // Sends the status, the headers and what is written so far without a content length, and hands the
+    // connection to a stream that outlives the request, for bodies that never end like server-sent events.
+    // CloseOutput does nothing after this.
+    virtual std::unique_ptr<HttpListenerStream> Detach() = 0;
 };
 
 }
@@ -4,9 +4,12 @@
 #include <ws2tcpip.h>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <sstream>
 #include <regex>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 using namespace System::Net::Http;
 
@@ -18,25 +21,6 @@ std::string  ToString(int data)
     return buffer.str();
 }
 
-// trim from start
-static inline std::string &ltrim(std::string &s) {
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(),
-                                    std::not1(std::ptr_fun<int, int>(std::isspace))));
-    return s;
-}
-
-// trim from end
-static inline std::string &rtrim(std::string &s) {
-    s.erase(std::find_if(s.rbegin(), s.rend(),
-                         std::not1(std::ptr_fun<int, int>(std::isspace))).base(), s.end());
-    return s;
-}
-
-// trim from both ends
-static inline std::string &trim(std::string &s) {
-    return ltrim(rtrim(s));
-}
-
 namespace System
 {
 
@@ -48,91 +32,217 @@ namespace Http
 
 #define BUFFER_SIZE 1024*5 // 5KB
 
+static HttpListenerTraceCallback traceCallback = nullptr;
+
+// Reports the time between construction and destruction to the trace callback, when one is set.
+class TraceScope
+{
+    char const *_name;
+    std::chrono::steady_clock::time_point _start;
+public:
+    explicit TraceScope(char const *name)
+        : _name(name)
+    {
+        if (traceCallback != nullptr)
+        {
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (traceCallback != nullptr)
+        {
+            traceCallback(_name, _start, std::chrono::steady_clock::now());
+        }
+    }
+};
+
 class InternalHttpListenerRequest : public HttpListenerRequest
 {
     SOCKET _socket;
     sockaddr_in _clientInfo;
-    char buffer[BUFFER_SIZE+1];
-    int bytes;
-
-    std::string readAllData()
+    size_t _maxHeadSize;
+    size_t _maxBodySize;
+    int _refusedStatusCode;
+    std::chrono::steady_clock::time_point _deadline;
+    bool _failed;
+
+    // Receives into the end of the raw data, returns the number of bytes received. Returns 0 when the client
+    // closed the connection, and also when it failed or the request did not arrive before the deadline, which
+    // marks the request as failed.
+    int receive()
     {
-        ZeroMemory(&buffer, sizeof(buffer));
-
-        bytes = recv(_socket, buffer, BUFFER_SIZE, 0);
-        if (bytes < 0)
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(_deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0)
         {
-            throw new HttpListenerException("Could not recieve any data");
+            _failed = true;
+            return 0;
         }
-        buffer[bytes] = '\0';
-        std::string browserData = buffer;
 
-        while (BUFFER_SIZE == bytes)
+        // The timeout is what is left until the deadline, a client sending a byte at a time can not hold the
+        // accepting thread longer than one that sends nothing
+        DWORD timeout = DWORD(remaining.count());
+        setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, (char const *)&timeout, sizeof(timeout));
+
+        auto offset = _rawData.size();
+        _rawData.resize(offset + BUFFER_SIZE);
+
+        auto bytes = recv(_socket, &_rawData[offset], BUFFER_SIZE, 0);
+        if (bytes < 0)
         {
-            bytes = recv(_socket, buffer, BUFFER_SIZE, 0);
-            buffer[bytes] = '\0';
-            browserData += buffer;
+            _rawData.resize(offset);
+            _failed = true;
+            return 0;
         }
 
-        return browserData;
+        _rawData.resize(offset + bytes);
+
+        return bytes;
     }
-public:
-    InternalHttpListenerRequest(SOCKET socket, sockaddr_in clientInfo)
-        : _socket(socket), _clientInfo(clientInfo)
+
+    void readAllData()
     {
-        std::string allData = readAllData();
+        TraceScope trace("readAllData");
+
+        _rawData.reserve(BUFFER_SIZE);
+
+        // Read until the complete head is in
+        while (_rawData.find("\r\n\r\n") == std::string::npos)
+        {
+            if (_rawData.size() > _maxHeadSize)
+            {
+                _refusedStatusCode = 431;
+                return;
+            }
 
-        auto pos = allData.find("\r\n\r\n");
-        if (pos == std::string::npos)
+            if (receive() == 0)
+            {
+                return;
+            }
+        }
+
+        if (_rawData.find("\r\n\r\n") > _maxHeadSize)
         {
+            _refusedStatusCode = 431;
             return;
         }
 
-        std::stringstream ss;
-        ss.str(allData.substr(0, pos));
-        std::string line;
+        Parse();
 
-        // Determine methode, uri and HTTP version
-        if (std::getline(ss, line))
+        // The length is checked before anything is read for it, the client says how much it will send
+        if (_contentLength64 > 0 && size_t(_contentLength64) > _maxBodySize)
         {
-            trim(line);
-            auto first = line.find_first_of(' ');
-            auto last = line.find_last_of(' ');
-            if (first != std::string::npos && last != std::string::npos)
-            {
-                auto version = line.substr(last);
-                if (trim(version) != "HTTP/1.1")
-                {
-                    throw new HttpListenerException("invalid HTTP version");
-                }
-
-                auto method = line.substr(0, first);
-                this->_httpMethod = trim(method);
+            _refusedStatusCode = 413;
+            return;
+        }
 
-                auto uri = line.substr(first, last-first);
-                this->_rawUrl = trim(uri);
-            }
+        // When the payload did not fit in what was read so far, read the rest and parse again
+        auto expectedSize = (_rawData.size() - _payload.size()) + size_t(_contentLength64);
+        if (_contentLength64 <= 0 || _rawData.size() >= expectedSize)
+        {
+            return;
         }
 
-        // Determine headers
-        while (std::getline(ss, line))
+        while (_rawData.size() < expectedSize)
         {
-            auto pos = line.find_first_of(':');
-            if (pos != std::string::npos)
+            if (receive() == 0)
             {
-                auto key = line.substr(0, pos);
-                auto value = line.substr(pos + 1);
-                this->_headers.insert(std::make_pair(trim(key), trim(value)));
+                break;
             }
         }
 
-        // And finally determine payload(if any)
-        this->_payload = allData.substr(pos + 4);
+        Parse();
+    }
+public:
+    InternalHttpListenerRequest(SOCKET socket, sockaddr_in clientInfo, size_t maxHeadSize, size_t maxBodySize, std::chrono::milliseconds readTimeout, std::pmr::memory_resource *arena)
+        : HttpListenerRequest(arena), _socket(socket), _clientInfo(clientInfo), _maxHeadSize(maxHeadSize), _maxBodySize(maxBodySize), _refusedStatusCode(0),
+          _deadline(std::chrono::steady_clock::now() + readTimeout), _failed(false)
+    {
+        readAllData();
+    }
+
+    // Whether the connection failed or timed out before the request was read.
+    bool Failed() const
+    {
+        return _failed;
+    }
+
+    // The status the request is refused with because it is too large, or 0 when it was read.
+    int RefusedStatusCode() const
+    {
+        return _refusedStatusCode;
     }
 
     std::string ipAddress() const
     {
-        return std::string(inet_ntoa(this->_clientInfo.sin_addr));
+        // inet_ntoa shares one buffer between all threads
+        char address[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, &_clientInfo.sin_addr, address, sizeof(address));
+
+        return std::string(address);
+    }
+};
+
+// Sends all buffers with as few calls as possible, picking up where a partial send stopped.
+static bool sendAllBuffers(SOCKET socket, WSABUF *buffers, size_t count)
+{
+    size_t first = 0;
+
+    while (first < count)
+    {
+        DWORD sent = 0;
+
+        auto resultCode = WSASend(socket, &buffers[first], DWORD(count - first), &sent, 0, NULL, NULL);
+        if (SOCKET_ERROR == resultCode || 0 == sent)
+        {
+            return false;
+        }
+
+        while (first < count && sent >= buffers[first].len)
+        {
+            sent -= buffers[first].len;
+            first++;
+        }
+
+        if (first < count)
+        {
+            buffers[first].buf += sent;
+            buffers[first].len -= sent;
+        }
+    }
+
+    return true;
+}
+
+class InternalHttpListenerStream : public HttpListenerStream
+{
+    SOCKET _socket;
+public:
+    explicit InternalHttpListenerStream(SOCKET socket)
+        : _socket(socket)
+    { }
+
+    virtual ~InternalHttpListenerStream()
+    {
+        shutdown(_socket, SD_BOTH);
+        closesocket(_socket);
+    }
+
+    bool Write(std::string_view data)
+    {
+        WSABUF buffer{ULONG(data.size()), const_cast<CHAR *>(data.data())};
+
+        return data.empty() || sendAllBuffers(_socket, &buffer, 1);
+    }
+
+    bool IsWritable()
+    {
+        WSAPOLLFD fd{};
+        fd.fd = _socket;
+        fd.events = POLLOUT;
+
+        return WSAPoll(&fd, 1, 0) == 1 && (fd.revents & POLLOUT) != 0;
     }
 };
 
@@ -140,57 +250,186 @@ class InternalHttpListenerResponse : public HttpListenerResponse
 {
     SOCKET _socket;
     sockaddr_in _clientInfo;
+    bool _detached;
+    bool _closed;
+
+    // The status line and headers, a detached response has no length and ends when the connection closes
+    std::pmr::string head(bool withLength)
+    {
+        std::pmr::string headers(_arena);
+        headers.reserve(256);
+
+        headers += "HTTP/1.1 ";
+        headers += std::to_string(_statusCode);
+        headers += " ";
+        headers += _statusDescription;
+        headers += "\r\n";
+
+        for (auto &pair : _headers)
+        {
+            headers += pair.first;
+            headers += ": ";
+            headers += pair.second;
+            headers += "\r\n";
+        }
+
+        if (withLength)
+        {
+            headers += "Content-Length: ";
+            headers += std::to_string(_outputLength);
+            headers += "\r\n\r\n";
+        }
+        else
+        {
+            headers += "Connection: close\r\n\r\n";
+        }
+
+        return headers;
+    }
+
+    bool sendOutput(std::pmr::string &headers)
+    {
+        std::pmr::vector<WSABUF> buffers(_arena);
+        buffers.reserve(_output.size() + 1);
+
+        buffers.push_back(WSABUF{ULONG(headers.size()), &headers[0]});
+
+        for (auto &segment : _output)
+        {
+            if (segment.data != nullptr)
+            {
+                buffers.push_back(WSABUF{ULONG(segment.length), const_cast<CHAR *>(segment.data)});
+            }
+            else if (!segment.owned.empty())
+            {
+                buffers.push_back(WSABUF{ULONG(segment.owned.size()), &segment.owned[0]});
+            }
+        }
+
+        return sendAllBuffers(_socket, buffers.data(), buffers.size());
+    }
 public:
-    InternalHttpListenerResponse(SOCKET socket, sockaddr_in clientInfo)
-        : _socket(socket), _clientInfo(clientInfo)
+    InternalHttpListenerResponse(SOCKET socket, sockaddr_in clientInfo, std::pmr::memory_resource *arena)
+        : HttpListenerResponse(arena), _socket(socket), _clientInfo(clientInfo), _detached(false), _closed(false)
     { }
 
     void CloseOutput()
     {
-        std::stringstream headers;
-
-        headers << "HTTP/1.1 " << _statusCode << " " << _statusDescription << "\r\n";
-
-        for (auto pair : _headers)
+        if (_detached || _closed)
         {
-            headers << pair.first << ": " << pair.second << "\r\n";
+            return;
         }
 
-        headers << "Content-Length: " << _output.size() << "\r\n"
-                << "\r\n";
+        _closed = true;
+
+        TraceScope trace("CloseOutput");
 
-        send(_socket, headers.str().c_str(), headers.str().size(), 0);
-        send(_socket, _output.c_str(), _output.size(), 0);
+        auto headers = head(true);
+
+        sendOutput(headers);
 
         shutdown(_socket, SD_BOTH);
         closesocket(_socket);
     }
+
+    bool IsOutputClosed() const
+    {
+        return _closed || _detached;
+    }
+
+    bool IsClientConnected()
+    {
+        WSAPOLLFD fd{};
+        fd.fd = _socket;
+        fd.events = POLLIN;
+
+        if (WSAPoll(&fd, 1, 0) != 1)
+        {
+            return true;
+        }
+
+        if ((fd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+        {
+            return false;
+        }
+
+        // The request was read already, so a readable connection without data is one the client closed
+        char next;
+        return recv(_socket, &next, 1, MSG_PEEK) > 0;
+    }
+
+    std::unique_ptr<HttpListenerStream> Detach()
+    {
+        _detached = true;
+
+        auto headers = head(false);
+
+        sendOutput(headers);
+
+        return std::make_unique<InternalHttpListenerStream>(_socket);
+    }
 };
 
 class InternalHttpListenerContext : public HttpListenerContext
 {
+    SOCKET _socket;
     InternalHttpListenerRequest _internalRequest;
     InternalHttpListenerResponse _internalResponse;
 public:
-    InternalHttpListenerContext(SOCKET socket, sockaddr_in clientInfo)
-        : HttpListenerContext(), _internalRequest(socket, clientInfo), _internalResponse(socket, clientInfo)
+    InternalHttpListenerContext(SOCKET socket, sockaddr_in clientInfo, size_t maxHeadSize, size_t maxBodySize, std::chrono::milliseconds readTimeout)
+        : HttpListenerContext(), _socket(socket), _internalRequest(socket, clientInfo, maxHeadSize, maxBodySize, readTimeout, &_arena), _internalResponse(socket, clientInfo, &_arena)
     {
         _request = &_internalRequest;
         _response = &_internalResponse;
     }
     virtual ~InternalHttpListenerContext()
     { }
+
+    // Closes the connection without an answer when its request could not be read, returns false when it was read.
+    bool Drop()
+    {
+        if (!_internalRequest.Failed())
+        {
+            return false;
+        }
+
+        shutdown(_socket, SD_BOTH);
+        closesocket(_socket);
+
+        return true;
+    }
+
+    // Answers a request that was too large to read, returns false when it was read and still needs an answer.
+    bool Refuse()
+    {
+        auto statusCode = _internalRequest.RefusedStatusCode();
+        if (statusCode == 0)
+        {
+            return false;
+        }
+
+        _internalResponse.SetStatusCode(statusCode);
+        _internalResponse.SetStatusDescription(statusCode == 413 ? "Payload Too Large" : "Request Header Fields Too Large");
+        _internalResponse.AddHeader("Connection", "close");
+        _internalResponse.CloseOutput();
+
+        return true;
+    }
 };
 
 class InternalHttpListener
 {
 public:
-    SOCKET _listeningSocket;
+    // Stop runs on another thread than the ones waiting in GetContext
+    std::atomic<SOCKET> _listeningSocket;
     HttpListenerPrefixCollection _prefixes;
     int _maxConnections;
+    size_t _maxRequestHeadSize;
+    size_t _maxRequestBodySize;
+    std::chrono::milliseconds _requestReadTimeout;
 
     InternalHttpListener()
-        : _listeningSocket(0), _maxConnections(50)
+        : _listeningSocket(0), _maxConnections(50), _maxRequestHeadSize(16 * 1024), _maxRequestBodySize(8 * 1024 * 1024), _requestReadTimeout(10000)
     { }
 };
 
@@ -232,13 +471,62 @@ HttpListenerPrefixCollection &HttpListener::Prefixes()
     return _internal->_prefixes;
 }
 
+// Gets or sets how many connections wait to be accepted before new ones are refused, set it before Start.
+int HttpListener::MaxConnections() const
+{
+    return _internal->_maxConnections;
+}
+
+void HttpListener::SetMaxConnections(int maxConnections)
+{
+    _internal->_maxConnections = maxConnections;
+}
+
+// Gets or sets how large the request line and headers may be, larger requests are answered with 431.
+size_t HttpListener::MaxRequestHeadSize() const
+{
+    return _internal->_maxRequestHeadSize;
+}
+
+void HttpListener::SetMaxRequestHeadSize(size_t maxRequestHeadSize)
+{
+    _internal->_maxRequestHeadSize = maxRequestHeadSize;
+}
+
+// Gets or sets how large the body of a request may be, a larger Content-Length is answered with 413.
+size_t HttpListener::MaxRequestBodySize() const
+{
+    return _internal->_maxRequestBodySize;
+}
+
+void HttpListener::SetMaxRequestBodySize(size_t maxRequestBodySize)
+{
+    _internal->_maxRequestBodySize = maxRequestBodySize;
+}
+
+// Gets or sets how long a connection may take to send its request, a slower one is closed without an answer.
+std::chrono::milliseconds HttpListener::RequestReadTimeout() const
+{
+    return _internal->_requestReadTimeout;
+}
+
+void HttpListener::SetRequestReadTimeout(std::chrono::milliseconds requestReadTimeout)
+{
+    _internal->_requestReadTimeout = requestReadTimeout;
+}
+
 // Shuts down the HttpListener object immediately, discarding all currently queued requests.
 void HttpListener::Abort()
-{ }
+{
+    // Closing the listening socket resets the connections that were not accepted yet
+    Stop();
+}
 
 // Shuts down the HttpListener.
 void HttpListener::Close()
-{ }
+{
+    Stop();
+}
 
 // Allows this instance to receive incoming requests.
 void HttpListener::Start()
@@ -248,7 +536,7 @@ void HttpListener::Start()
         throw new HttpListenerException("Already started");
     }
 
-    std::regex rgx("^([^:]*):\\/\\/([^:\\/]*):?([0-9]*)(\\/?[\\w-_\\/]*)$");
+    std::regex rgx("^([^:]*):\\/\\/([^:\\/]*):?([0-9]*)(\\/?[\\w\\-\\/]*)$");
 
     std::string port;
     std::string schema;
@@ -309,48 +597,102 @@ void HttpListener::Start()
     }
 
     // Create Socket
-    _internal->_listeningSocket = socket(hints.ai_family, hints.ai_socktype, hints.ai_protocol);
-    if (INVALID_SOCKET == _internal->_listeningSocket)
+    SOCKET listeningSocket = socket(hints.ai_family, hints.ai_socktype, hints.ai_protocol);
+    if (INVALID_SOCKET == listeningSocket)
     {
+        freeaddrinfo(result);
         throw new HttpListenerException("Could't Create Socket");
     }
 
+    _internal->_listeningSocket = listeningSocket;
+
     // Bind
-    resultCode = bind(_internal->_listeningSocket, result->ai_addr, (int)(result->ai_addrlen));
+    resultCode = bind(listeningSocket, result->ai_addr, (int)(result->ai_addrlen));
     if (SOCKET_ERROR == resultCode)
     {
+        freeaddrinfo(result);
         throw new HttpListenerException("Bind Socket Failed");
     }
 
     // Listen
-    resultCode = listen(_internal->_listeningSocket, _internal->_maxConnections);
+    resultCode = listen(listeningSocket, _internal->_maxConnections);
     if (SOCKET_ERROR == resultCode)
     {
+        freeaddrinfo(result);
         throw new HttpListenerException(std::string("Listening On Port ") + port + " Failed");
     }
+
+    freeaddrinfo(result);
 }
 
 // Waits for an incoming request and returns when one is received.
 HttpListenerContext *HttpListener::GetContext()
 {
-    sockaddr_in clientInfo;
-    int clientInfoSize = sizeof(clientInfo);
+    while (true)
+    {
+        sockaddr_in clientInfo;
+        int clientInfoSize = sizeof(clientInfo);
 
-    auto socket = accept(_internal->_listeningSocket, (sockaddr*)&clientInfo, &clientInfoSize);
+        auto socket = accept(_internal->_listeningSocket, (sockaddr*)&clientInfo, &clientInfoSize);
 
-    if (INVALID_SOCKET == socket)
-    {
-        throw HttpListenerException("Invalid socket");
-    }
+        if (INVALID_SOCKET == socket)
+        {
+            if (!IsListening())
+            {
+                return nullptr;
+            }
+
+            // A connection the client reset before it was accepted only loses that connection, anything else is
+            // wrong with the listening socket
+            auto error = WSAGetLastError();
+            if (error == WSAECONNRESET || error == WSAECONNABORTED)
+            {
+                continue;
+            }
+
+            throw new HttpListenerException(std::string("Accept Failed \nError Code: ") + ToString(error));
+        }
+
+        // The request is read on this thread, the read timeout and the size limits bound how long that takes
+        InternalHttpListenerContext *context = nullptr;
+        try
+        {
+            context = new InternalHttpListenerContext(socket, clientInfo, _internal->_maxRequestHeadSize, _internal->_maxRequestBodySize, _internal->_requestReadTimeout);
+        }
+        catch (HttpListenerException const *ex)
+        {
+            // A request that does not parse only loses its own connection
+            delete ex;
+            shutdown(socket, SD_BOTH);
+            closesocket(socket);
+            continue;
+        }
+
+        // A request that did not arrive is dropped and one that is too large is answered here, neither is handed
+        // out and the next connection is accepted instead
+        if (!context->Drop() && !context->Refuse())
+        {
+            return context;
+        }
 
-    return new InternalHttpListenerContext(socket, clientInfo);
+        delete context;
+    }
 }
 
 // Causes this instance to stop receiving incoming requests.
 void HttpListener::Stop()
 {
-    if (IsListening())
+    auto listeningSocket = _internal->_listeningSocket.exchange(0);
+
+    if (listeningSocket != 0)
     {
-        closesocket(_internal->_listeningSocket);
+        // Closing alone does not wake an accept waiting on every platform, the shutdown does
+        shutdown(listeningSocket, SD_BOTH);
+        closesocket(listeningSocket);
     }
 }
+
+void HttpListener::SetTraceCallback(HttpListenerTraceCallback callback)
+{
+    traceCallback = callback;
+}
@@ -3,6 +3,7 @@
 using namespace System::Net::Http;
 
 HttpListenerContext::HttpListenerContext()
+    : _arena(_arenaBuffer, sizeof(_arenaBuffer))
 { }
 
 HttpListenerContext::~HttpListenerContext()
@@ -19,3 +20,9 @@ HttpListenerResponse *HttpListenerContext::Response()
 {
     return _response;
 }
+
+// Gets the memory resource backing the request and response, it is released when the context is deleted.
+std::pmr::memory_resource *HttpListenerContext::Arena()
+{
+    return &_arena;
+}
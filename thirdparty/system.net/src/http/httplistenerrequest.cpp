@@ -1,16 +1,177 @@
 #include "http/httplistenerrequest.h"
+#include "http/httplistenerexception.h"
 #include "http/httplistenerresponse.h"
 #include <algorithm>
 #include <sstream>
 #include <iostream>
 #include <fstream>
 #include <cctype>
+#include <charconv>
 
 using namespace System::Net::Http;
 
-HttpListenerRequest::HttpListenerRequest()
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+    {
+        s.remove_prefix(1);
+    }
+
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+    {
+        s.remove_suffix(1);
+    }
+
+    return s;
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decodes %XX escapes and '+' into the arena, returns the input itself when there is nothing to decode
+static std::string_view urlDecode(std::string_view s, std::pmr::memory_resource *arena)
+{
+    if (s.find_first_of("%+") == std::string_view::npos)
+    {
+        return s;
+    }
+
+    auto decoded = static_cast<char *>(arena->allocate(s.size(), 1));
+    size_t length = 0;
+
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '+')
+        {
+            decoded[length++] = ' ';
+        }
+        else if (s[i] == '%' && i + 2 < s.size() && hexValue(s[i + 1]) >= 0 && hexValue(s[i + 2]) >= 0)
+        {
+            decoded[length++] = char(hexValue(s[i + 1]) * 16 + hexValue(s[i + 2]));
+            i += 2;
+        }
+        else
+        {
+            decoded[length++] = s[i];
+        }
+    }
+
+    return std::string_view(decoded, length);
+}
+
+bool HttpHeaderNameLess::operator()(std::string_view a, std::string_view b) const
+{
+    auto length = std::min(a.size(), b.size());
+
+    for (size_t i = 0; i < length; i++)
+    {
+        auto ca = std::tolower(static_cast<unsigned char>(a[i]));
+        auto cb = std::tolower(static_cast<unsigned char>(b[i]));
+        if (ca != cb)
+        {
+            return ca < cb;
+        }
+    }
+
+    return a.size() < b.size();
+}
+
+HttpListenerRequest::HttpListenerRequest(std::pmr::memory_resource *arena)
+    : _arena(arena), _rawData(arena), _contentLength64(0), _headers(arena), _queryString(arena)
 { }
 
+// Parses the request line, the headers and the payload from the raw request data.
+void HttpListenerRequest::Parse()
+{
+    std::string_view allData(_rawData);
+
+    _headers.clear();
+    _queryString.clear();
+
+    auto pos = allData.find("\r\n\r\n");
+    if (pos == std::string_view::npos)
+    {
+        return;
+    }
+
+    auto head = allData.substr(0, pos);
+
+    // Determine methode, uri and HTTP version
+    auto lineEnd = head.find("\r\n");
+    auto line = trim(head.substr(0, lineEnd));
+    auto first = line.find_first_of(' ');
+    auto last = line.find_last_of(' ');
+    if (first != std::string_view::npos && last != std::string_view::npos)
+    {
+        auto version = trim(line.substr(last));
+        if (version != "HTTP/1.1")
+        {
+            throw new HttpListenerException("invalid HTTP version");
+        }
+
+        this->_httpMethod = trim(line.substr(0, first));
+        this->_rawUrl = trim(line.substr(first, last - first));
+
+        auto question = _rawUrl.find('?');
+        this->_path = _rawUrl.substr(0, question);
+
+        // Determine the query string, names and values are url decoded
+        auto query = question == std::string_view::npos ? std::string_view() : _rawUrl.substr(question + 1);
+        while (!query.empty())
+        {
+            auto ampersand = query.find('&');
+            auto pair = query.substr(0, ampersand);
+            query = ampersand == std::string_view::npos ? std::string_view() : query.substr(ampersand + 1);
+
+            if (pair.empty())
+            {
+                continue;
+            }
+
+            auto equals = pair.find('=');
+            auto name = urlDecode(pair.substr(0, equals), _arena);
+            auto value = equals == std::string_view::npos ? std::string_view() : urlDecode(pair.substr(equals + 1), _arena);
+
+            this->_queryString.insert(std::make_pair(name, value));
+        }
+    }
+
+    // Determine headers
+    while (lineEnd != std::string_view::npos)
+    {
+        auto lineStart = lineEnd + 2;
+        lineEnd = head.find("\r\n", lineStart);
+        line = head.substr(lineStart, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - lineStart);
+
+        auto colon = line.find_first_of(':');
+        if (colon != std::string_view::npos)
+        {
+            this->_headers.insert(std::make_pair(trim(line.substr(0, colon)), trim(line.substr(colon + 1))));
+        }
+    }
+
+    auto contentLength = _headers.find("Content-Length");
+    if (contentLength != _headers.end())
+    {
+        auto value = contentLength->second;
+        std::from_chars(value.data(), value.data() + value.size(), this->_contentLength64);
+    }
+
+    auto contentType = _headers.find("Content-Type");
+    if (contentType != _headers.end())
+    {
+        this->_contentType = contentType->second;
+    }
+
+    // And finally determine payload(if any)
+    this->_payload = allData.substr(pos + 4);
+}
+
 // Gets the length of the body data included in the request.
 long HttpListenerRequest::ContentLength64() const
 {
@@ -18,31 +179,43 @@ long HttpListenerRequest::ContentLength64() const
 }
 
 // Gets the MIME type of the body data included in the request.
-std::string const &HttpListenerRequest::ContentType() const
+std::string_view HttpListenerRequest::ContentType() const
 {
     return _contentType;
 }
 
 // Gets the collection of header name/value pairs sent in the request.
-std::map<std::string, std::string> const &HttpListenerRequest::Headers() const
+HttpHeaderCollection const &HttpListenerRequest::Headers() const
 {
     return _headers;
 }
 
 // Gets the HTTP method specified by the client.
-std::string const &HttpListenerRequest::HttpMethod() const
+std::string_view HttpListenerRequest::HttpMethod() const
 {
     return _httpMethod;
 }
 
 // Gets the query string included in the request.
-std::map<std::string, std::string> const &HttpListenerRequest::QueryString() const
+HttpQueryStringCollection const &HttpListenerRequest::QueryString() const
 {
     return _queryString;
 }
 
 // Gets the URL information (without the host and port) requested by the client.
-std::string const &HttpListenerRequest::RawUrl() const
+std::string_view HttpListenerRequest::RawUrl() const
 {
     return _rawUrl;
 }
+
+// Gets the path of the URL, without the query string.
+std::string_view HttpListenerRequest::Path() const
+{
+    return _path;
+}
+
+// Gets the memory resource that lives as long as this request.
+std::pmr::memory_resource *HttpListenerRequest::Arena() const
+{
+    return _arena;
+}
@@ -2,8 +2,10 @@
 
 using namespace System::Net::Http;
 
-HttpListenerResponse::HttpListenerResponse()
-    : _statusCode(200), _statusDescription("OK")
+HttpListenerStream::~HttpListenerStream() { }
+
+HttpListenerResponse::HttpListenerResponse(std::pmr::memory_resource *arena)
+    : _arena(arena), _statusCode(200), _statusDescription("OK"), _output(arena), _outputLength(0)
 { }
 
 HttpListenerResponse::~HttpListenerResponse() { }
@@ -62,7 +64,74 @@ void HttpListenerResponse::Redirect(std::string const &url)
     CloseOutput();
 }
 
-void HttpListenerResponse::WriteOutput(std::string const &data)
+// Copies data into the body, the body buffers come from the arena of the request.
+void HttpListenerResponse::WriteOutput(const char *data)
+{
+    WriteOutput(std::string_view(data));
+}
+
+void HttpListenerResponse::WriteOutput(std::string_view data)
+{
+    if (data.empty())
+    {
+        return;
+    }
+
+    if (_output.empty() || _output.back().data != nullptr)
+    {
+        _output.push_back(OutputSegment{std::pmr::string(_arena), nullptr, 0});
+    }
+
+    _output.back().owned += data;
+    _outputLength += data.size();
+}
+
+// Adds data to the body without copying it when it was allocated from Arena().
+void HttpListenerResponse::WriteOutput(std::pmr::string &&data)
+{
+    if (data.empty())
+    {
+        return;
+    }
+
+    _outputLength += data.size();
+
+    if (!_output.empty() && _output.back().data == nullptr)
+    {
+        _output.back().owned += data;
+        return;
+    }
+
+    _output.push_back(OutputSegment{std::move(data), nullptr, 0});
+}
+
+// Adds data to the body without copying it, the data must outlive the response (like static assets).
+void HttpListenerResponse::WriteStaticOutput(const char *data, size_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+    _output.push_back(OutputSegment{std::pmr::string(_arena), data, length});
+    _outputLength += length;
+}
+
+// Gets the number of bytes written to the body so far.
+size_t HttpListenerResponse::OutputLength() const
+{
+    return _outputLength;
+}
+
+// Drops the body written so far, to answer with an error instead of what was started.
+void HttpListenerResponse::ClearOutput()
+{
+    _output.clear();
+    _outputLength = 0;
+}
+
+// Gets the memory resource that lives as long as this response.
+std::pmr::memory_resource *HttpListenerResponse::Arena() const
 {
-    _output += data;
+    return _arena;
 }